@@ -120,6 +120,59 @@ struct att_data_list *att_data_list_alloc(uint16_t num, uint16_t len)
 	return list;
 }
 
+gboolean att_iter_next(struct att_iter *iter, const uint8_t **entry)
+{
+	if (iter->elen == 0 || iter->len < iter->elen)
+		return FALSE;
+
+	*entry = iter->ptr;
+
+	iter->ptr += iter->elen;
+	iter->len -= iter->elen;
+
+	return TRUE;
+}
+
+static gboolean iter_init(struct att_iter *iter, const uint8_t *pdu,
+						size_t len, uint16_t elen)
+{
+	if (elen == 0)
+		return FALSE;
+
+	iter->ptr = pdu;
+	iter->len = len;
+	iter->elen = elen;
+
+	return TRUE;
+}
+
+uint8_t *att_writer_next(struct att_writer *writer)
+{
+	uint8_t *entry;
+
+	if (writer->offset + writer->elen > writer->len)
+		return NULL;
+
+	entry = &writer->pdu[writer->offset];
+	writer->offset += writer->elen;
+
+	return entry;
+}
+
+static gboolean writer_init(struct att_writer *writer, uint8_t *pdu,
+					size_t len, size_t offset, uint16_t elen)
+{
+	if (pdu == NULL || elen == 0 || len < offset + elen)
+		return FALSE;
+
+	writer->pdu = pdu;
+	writer->len = len;
+	writer->offset = offset;
+	writer->elen = elen;
+
+	return TRUE;
+}
+
 uint16_t enc_read_by_grp_req(uint16_t start, uint16_t end, bt_uuid_t *uuid,
 						uint8_t *pdu, size_t len)
 {
@@ -175,31 +228,19 @@ uint16_t dec_read_by_grp_req(const uint8_t *pdu, size_t len, uint16_t *start,
 	return len;
 }
 
-uint16_t enc_read_by_grp_resp(struct att_data_list *list, uint8_t *pdu,
-								size_t len)
+gboolean enc_read_by_grp_resp_init(struct att_writer *writer, uint16_t elen,
+						uint8_t *pdu, size_t len)
 {
-	int i;
-	uint16_t w;
-	uint8_t *ptr;
-
-	if (list == NULL)
-		return 0;
+	if (elen > UINT8_MAX)
+		return FALSE;
 
-	if (len < list->len + sizeof(uint8_t) * 2)
-		return 0;
+	if (!writer_init(writer, pdu, len, 2, elen))
+		return FALSE;
 
 	pdu[0] = ATT_OP_READ_BY_GROUP_RESP;
-	pdu[1] = list->len;
-
-	ptr = &pdu[2];
-
-	for (i = 0, w = 2; i < list->num && w + list->len <= len; i++) {
-		memcpy(ptr, list->data[i], list->len);
-		ptr += list->len;
-		w += list->len;
-	}
+	pdu[1] = elen;
 
-	return w;
+	return TRUE;
 }
 
 struct att_data_list *dec_read_by_grp_resp(const uint8_t *pdu, size_t len)
@@ -228,6 +269,18 @@ struct att_data_list *dec_read_by_grp_resp(const uint8_t *pdu, size_t len)
 	return list;
 }
 
+gboolean dec_read_by_grp_resp_iter(const uint8_t *pdu, size_t len,
+							struct att_iter *iter)
+{
+	if (pdu == NULL || len < 2)
+		return FALSE;
+
+	if (pdu[0] != ATT_OP_READ_BY_GROUP_RESP)
+		return FALSE;
+
+	return iter_init(iter, &pdu[2], len - 2, pdu[1]);
+}
+
 uint16_t enc_find_by_type_req(uint16_t start, uint16_t end, bt_uuid_t *uuid,
 					const uint8_t *value, size_t vlen,
 					uint8_t *pdu, size_t len)
@@ -304,26 +357,15 @@ uint16_t dec_find_by_type_req(const uint8_t *pdu, size_t len, uint16_t *start,
 	return len;
 }
 
-uint16_t enc_find_by_type_resp(GSList *matches, uint8_t *pdu, size_t len)
+gboolean enc_find_by_type_resp_init(struct att_writer *writer, uint8_t *pdu,
+								size_t len)
 {
-	GSList *l;
-	uint16_t offset;
-
-	if (pdu == NULL || len < 5)
-		return 0;
+	if (!writer_init(writer, pdu, len, 1, sizeof(uint16_t) * 2))
+		return FALSE;
 
 	pdu[0] = ATT_OP_FIND_BY_TYPE_RESP;
 
-	for (l = matches, offset = 1;
-				l && len >= (offset + sizeof(uint16_t) * 2);
-				l = l->next, offset += sizeof(uint16_t) * 2) {
-		struct att_range *range = l->data;
-
-		att_put_u16(range->start, &pdu[offset]);
-		att_put_u16(range->end, &pdu[offset + 2]);
-	}
-
-	return offset;
+	return TRUE;
 }
 
 GSList *dec_find_by_type_resp(const uint8_t *pdu, size_t len)
@@ -351,6 +393,18 @@ GSList *dec_find_by_type_resp(const uint8_t *pdu, size_t len)
 	return matches;
 }
 
+gboolean dec_find_by_type_resp_iter(const uint8_t *pdu, size_t len,
+							struct att_iter *iter)
+{
+	if (pdu == NULL || len < 5)
+		return FALSE;
+
+	if (pdu[0] != ATT_OP_FIND_BY_TYPE_RESP)
+		return FALSE;
+
+	return iter_init(iter, &pdu[1], len - 1, sizeof(uint16_t) * 2);
+}
+
 uint16_t enc_read_by_type_req(uint16_t start, uint16_t end, bt_uuid_t *uuid,
 						uint8_t *pdu, size_t len)
 {
@@ -407,31 +461,22 @@ uint16_t dec_read_by_type_req(const uint8_t *pdu, size_t len, uint16_t *start,
 	return len;
 }
 
-uint16_t enc_read_by_type_resp(struct att_data_list *list, uint8_t *pdu,
-								size_t len)
+gboolean enc_read_by_type_resp_init(struct att_writer *writer, uint16_t elen,
+						uint8_t *pdu, size_t len)
 {
-	uint8_t *ptr;
-	size_t i, w, l;
-
-	if (list == NULL)
-		return 0;
+	if (pdu == NULL || len < 2)
+		return FALSE;
 
-	if (pdu == NULL)
-		return 0;
+	/* Values too long for a single entry are truncated */
+	elen = MIN(len - 2, MIN(elen, UINT8_MAX));
 
-	l = MIN(len - 2, list->len);
+	if (!writer_init(writer, pdu, len, 2, elen))
+		return FALSE;
 
 	pdu[0] = ATT_OP_READ_BY_TYPE_RESP;
-	pdu[1] = l;
-	ptr = &pdu[2];
-
-	for (i = 0, w = 2; i < list->num && w + l <= len; i++) {
-		memcpy(ptr, list->data[i], l);
-		ptr += l;
-		w += l;
-	}
+	pdu[1] = elen;
 
-	return w;
+	return TRUE;
 }
 
 struct att_data_list *dec_read_by_type_resp(const uint8_t *pdu, size_t len)
@@ -460,6 +505,18 @@ struct att_data_list *dec_read_by_type_resp(const uint8_t *pdu, size_t len)
 	return list;
 }
 
+gboolean dec_read_by_type_resp_iter(const uint8_t *pdu, size_t len,
+							struct att_iter *iter)
+{
+	if (pdu == NULL || len < 2)
+		return FALSE;
+
+	if (pdu[0] != ATT_OP_READ_BY_TYPE_RESP)
+		return FALSE;
+
+	return iter_init(iter, &pdu[2], len - 2, pdu[1]);
+}
+
 uint16_t enc_write_cmd(uint16_t handle, const uint8_t *value, size_t vlen,
 						uint8_t *pdu, size_t len)
 {
@@ -778,32 +835,25 @@ uint16_t dec_find_info_req(const uint8_t *pdu, size_t len, uint16_t *start,
 	return min_len;
 }
 
-uint16_t enc_find_info_resp(uint8_t format, struct att_data_list *list,
+gboolean enc_find_info_resp_init(struct att_writer *writer, uint8_t format,
 						uint8_t *pdu, size_t len)
 {
-	uint8_t *ptr;
-	size_t i, w;
-
-	if (pdu == NULL)
-		return 0;
+	uint16_t elen;
 
-	if (list == NULL)
-		return 0;
+	if (format == ATT_FIND_INFO_RESP_FMT_16BIT)
+		elen = sizeof(uint16_t) + 2;
+	else if (format == ATT_FIND_INFO_RESP_FMT_128BIT)
+		elen = sizeof(uint16_t) + 16;
+	else
+		return FALSE;
 
-	if (len < list->len + sizeof(uint8_t) * 2)
-		return 0;
+	if (!writer_init(writer, pdu, len, 2, elen))
+		return FALSE;
 
 	pdu[0] = ATT_OP_FIND_INFO_RESP;
 	pdu[1] = format;
-	ptr = (void *) &pdu[2];
-
-	for (i = 0, w = 2; i < list->num && w + list->len <= len; i++) {
-		memcpy(ptr, list->data[i], list->len);
-		ptr += list->len;
-		w += list->len;
-	}
 
-	return w;
+	return TRUE;
 }
 
 struct att_data_list *dec_find_info_resp(const uint8_t *pdu, size_t len,
@@ -846,6 +896,29 @@ struct att_data_list *dec_find_info_resp(const uint8_t *pdu, size_t len,
 	return list;
 }
 
+gboolean dec_find_info_resp_iter(const uint8_t *pdu, size_t len,
+				uint8_t *format, struct att_iter *iter)
+{
+	uint16_t elen;
+
+	if (pdu == NULL || format == NULL || len < 2)
+		return FALSE;
+
+	if (pdu[0] != ATT_OP_FIND_INFO_RESP)
+		return FALSE;
+
+	*format = pdu[1];
+
+	if (*format == ATT_FIND_INFO_RESP_FMT_16BIT)
+		elen = sizeof(uint16_t) + 2;
+	else if (*format == ATT_FIND_INFO_RESP_FMT_128BIT)
+		elen = sizeof(uint16_t) + 16;
+	else
+		return FALSE;
+
+	return iter_init(iter, &pdu[2], len - 2, elen);
+}
+
 uint16_t enc_notification(uint16_t handle, uint8_t *value, size_t vlen,
 						uint8_t *pdu, size_t len)
 {
@@ -111,6 +111,21 @@ struct att_range {
 	uint16_t end;
 };
 
+/* Walks the entries of a received list response without copying them */
+struct att_iter {
+	const uint8_t *ptr;
+	size_t len;
+	uint16_t elen;
+};
+
+/* Appends list response entries straight into the PDU buffer */
+struct att_writer {
+	uint8_t *pdu;
+	size_t len;
+	size_t offset;
+	uint16_t elen;
+};
+
 /* These functions do byte conversion */
 static inline uint8_t att_get_u8(const void *ptr)
 {
@@ -203,32 +218,42 @@ static inline bt_uuid_t att_get_uuid128(const void *ptr)
 struct att_data_list *att_data_list_alloc(uint16_t num, uint16_t len);
 void att_data_list_free(struct att_data_list *list);
 
+gboolean att_iter_next(struct att_iter *iter, const uint8_t **entry);
+uint8_t *att_writer_next(struct att_writer *writer);
+
 const char *att_ecode2str(uint8_t status);
 uint16_t enc_read_by_grp_req(uint16_t start, uint16_t end, bt_uuid_t *uuid,
 						uint8_t *pdu, size_t len);
 uint16_t dec_read_by_grp_req(const uint8_t *pdu, size_t len, uint16_t *start,
 					uint16_t *end, bt_uuid_t *uuid);
-uint16_t enc_read_by_grp_resp(struct att_data_list *list, uint8_t *pdu,
-								size_t len);
+gboolean enc_read_by_grp_resp_init(struct att_writer *writer, uint16_t elen,
+						uint8_t *pdu, size_t len);
 uint16_t enc_find_by_type_req(uint16_t start, uint16_t end, bt_uuid_t *uuid,
 				const uint8_t *value, size_t vlen, uint8_t *pdu,
 				size_t len);
 uint16_t dec_find_by_type_req(const uint8_t *pdu, size_t len, uint16_t *start,
 		uint16_t *end, bt_uuid_t *uuid, uint8_t *value, size_t *vlen);
-uint16_t enc_find_by_type_resp(GSList *ranges, uint8_t *pdu, size_t len);
+gboolean enc_find_by_type_resp_init(struct att_writer *writer, uint8_t *pdu,
+								size_t len);
 GSList *dec_find_by_type_resp(const uint8_t *pdu, size_t len);
+gboolean dec_find_by_type_resp_iter(const uint8_t *pdu, size_t len,
+							struct att_iter *iter);
 struct att_data_list *dec_read_by_grp_resp(const uint8_t *pdu, size_t len);
+gboolean dec_read_by_grp_resp_iter(const uint8_t *pdu, size_t len,
+							struct att_iter *iter);
 uint16_t enc_read_by_type_req(uint16_t start, uint16_t end, bt_uuid_t *uuid,
 						uint8_t *pdu, size_t len);
 uint16_t dec_read_by_type_req(const uint8_t *pdu, size_t len, uint16_t *start,
 					uint16_t *end, bt_uuid_t *uuid);
-uint16_t enc_read_by_type_resp(struct att_data_list *list, uint8_t *pdu,
-								size_t len);
+gboolean enc_read_by_type_resp_init(struct att_writer *writer, uint16_t elen,
+						uint8_t *pdu, size_t len);
 uint16_t enc_write_cmd(uint16_t handle, const uint8_t *value, size_t vlen,
 						uint8_t *pdu, size_t len);
 uint16_t dec_write_cmd(const uint8_t *pdu, size_t len, uint16_t *handle,
 						uint8_t *value, size_t *vlen);
 struct att_data_list *dec_read_by_type_resp(const uint8_t *pdu, size_t len);
+gboolean dec_read_by_type_resp_iter(const uint8_t *pdu, size_t len,
+							struct att_iter *iter);
 uint16_t enc_write_req(uint16_t handle, const uint8_t *value, size_t vlen,
 						uint8_t *pdu, size_t len);
 uint16_t dec_write_req(const uint8_t *pdu, size_t len, uint16_t *handle,
@@ -252,10 +277,12 @@ uint16_t enc_find_info_req(uint16_t start, uint16_t end, uint8_t *pdu,
 								size_t len);
 uint16_t dec_find_info_req(const uint8_t *pdu, size_t len, uint16_t *start,
 								uint16_t *end);
-uint16_t enc_find_info_resp(uint8_t format, struct att_data_list *list,
+gboolean enc_find_info_resp_init(struct att_writer *writer, uint8_t format,
 						uint8_t *pdu, size_t len);
 struct att_data_list *dec_find_info_resp(const uint8_t *pdu, size_t len,
 							uint8_t *format);
+gboolean dec_find_info_resp_iter(const uint8_t *pdu, size_t len,
+				uint8_t *format, struct att_iter *iter);
 uint16_t enc_notification(uint16_t handle, uint8_t *value, size_t vlen,
 						uint8_t *pdu, size_t len);
 uint16_t enc_indication(uint16_t handle, uint8_t *value, size_t vlen,
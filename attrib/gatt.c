@@ -148,8 +148,9 @@ static void primary_by_uuid_cb(guint8 status, const guint8 *ipdu,
 
 {
 	struct discover_primary *dp = user_data;
-	GSList *ranges, *last;
-	struct att_range *range;
+	struct att_range *range = NULL;
+	struct att_iter iter;
+	const uint8_t *entry;
 	uint8_t *buf;
 	guint16 oplen;
 	int err = 0;
@@ -160,16 +161,18 @@ static void primary_by_uuid_cb(guint8 status, const guint8 *ipdu,
 		goto done;
 	}
 
-	ranges = dec_find_by_type_resp(ipdu, iplen);
-	if (ranges == NULL)
+	if (!dec_find_by_type_resp_iter(ipdu, iplen, &iter))
 		goto done;
 
-	dp->primaries = g_slist_concat(dp->primaries, ranges);
+	while (att_iter_next(&iter, &entry)) {
+		range = g_new0(struct att_range, 1);
+		range->start = att_get_u16(&entry[0]);
+		range->end = att_get_u16(&entry[2]);
 
-	last = g_slist_last(ranges);
-	range = last->data;
+		dp->primaries = g_slist_append(dp->primaries, range);
+	}
 
-	if (range->end == 0xffff)
+	if (range == NULL || range->end == 0xffff)
 		goto done;
 
 	buf = g_attrib_get_buffer(dp->attrib, &buflen);
@@ -191,8 +194,9 @@ static void primary_all_cb(guint8 status, const guint8 *ipdu, guint16 iplen,
 							gpointer user_data)
 {
 	struct discover_primary *dp = user_data;
-	struct att_data_list *list;
-	unsigned int i, err;
+	struct att_iter iter;
+	const uint8_t *data;
+	unsigned int err;
 	uint16_t start, end;
 
 	if (status) {
@@ -200,24 +204,22 @@ static void primary_all_cb(guint8 status, const guint8 *ipdu, guint16 iplen,
 		goto done;
 	}
 
-	list = dec_read_by_grp_resp(ipdu, iplen);
-	if (list == NULL) {
+	if (!dec_read_by_grp_resp_iter(ipdu, iplen, &iter)) {
 		err = ATT_ECODE_IO;
 		goto done;
 	}
 
-	for (i = 0, end = 0; i < list->num; i++) {
-		const uint8_t *data = list->data[i];
+	for (end = 0; att_iter_next(&iter, &data);) {
 		struct gatt_primary *primary;
 		bt_uuid_t uuid;
 
 		start = att_get_u16(&data[0]);
 		end = att_get_u16(&data[2]);
 
-		if (list->len == 6) {
+		if (iter.elen == 6) {
 			bt_uuid_t uuid16 = att_get_uuid16(&data[4]);
 			bt_uuid_to_uuid128(&uuid16, &uuid);
-		} else if (list->len == 20) {
+		} else if (iter.elen == 20) {
 			uuid = att_get_uuid128(&data[4]);
 		} else {
 			/* Skipping invalid data */
@@ -226,7 +228,6 @@ static void primary_all_cb(guint8 status, const guint8 *ipdu, guint16 iplen,
 
 		primary = g_try_new0(struct gatt_primary, 1);
 		if (!primary) {
-			att_data_list_free(list);
 			err = ATT_ECODE_INSUFF_RESOURCES;
 			goto done;
 		}
@@ -236,7 +237,6 @@ static void primary_all_cb(guint8 status, const guint8 *ipdu, guint16 iplen,
 		dp->primaries = g_slist_append(dp->primaries, primary);
 	}
 
-	att_data_list_free(list);
 	err = 0;
 
 	if (end != 0xffff) {
@@ -381,8 +381,8 @@ static void find_included_cb(uint8_t status, const uint8_t *pdu, uint16_t len,
 	struct included_discovery *isd = user_data;
 	uint16_t last_handle = isd->end_handle;
 	unsigned int err = status;
-	struct att_data_list *list;
-	int i;
+	struct att_iter iter;
+	const uint8_t *data;
 
 	if (err == ATT_ECODE_ATTR_NOT_FOUND)
 		err = 0;
@@ -390,26 +390,24 @@ static void find_included_cb(uint8_t status, const uint8_t *pdu, uint16_t len,
 	if (status)
 		goto done;
 
-	list = dec_read_by_type_resp(pdu, len);
-	if (list == NULL) {
+	if (!dec_read_by_type_resp_iter(pdu, len, &iter)) {
 		err = ATT_ECODE_IO;
 		goto done;
 	}
 
-	if (list->len != 6 && list->len != 8) {
+	if (iter.elen != 6 && iter.elen != 8) {
 		err = ATT_ECODE_IO;
-		att_data_list_free(list);
 		goto done;
 	}
 
-	for (i = 0; i < list->num; i++) {
+	while (att_iter_next(&iter, &data)) {
 		struct gatt_included *incl;
 
-		incl = included_from_buf(list->data[i], list->len);
+		incl = included_from_buf(data, iter.elen);
 		last_handle = incl->handle;
 
 		/* 128 bit UUID, needs resolving */
-		if (list->len == 6) {
+		if (iter.elen == 6) {
 			resolve_included_uuid(isd, incl);
 			continue;
 		}
@@ -417,8 +415,6 @@ static void find_included_cb(uint8_t status, const uint8_t *pdu, uint16_t len,
 		isd->includes = g_slist_append(isd->includes, incl);
 	}
 
-	att_data_list_free(list);
-
 	if (last_handle < isd->end_handle)
 		find_included(isd, last_handle + 1);
 
@@ -445,8 +441,9 @@ static void char_discovered_cb(guint8 status, const guint8 *ipdu, guint16 iplen,
 							gpointer user_data)
 {
 	struct discover_char *dc = user_data;
-	struct att_data_list *list;
-	unsigned int i, err = ATT_ECODE_ATTR_NOT_FOUND;
+	struct att_iter iter;
+	const uint8_t *value;
+	unsigned int err = ATT_ECODE_ATTR_NOT_FOUND;
 	uint16_t last = 0;
 
 	if (status) {
@@ -454,20 +451,18 @@ static void char_discovered_cb(guint8 status, const guint8 *ipdu, guint16 iplen,
 		goto done;
 	}
 
-	list = dec_read_by_type_resp(ipdu, iplen);
-	if (list == NULL) {
+	if (!dec_read_by_type_resp_iter(ipdu, iplen, &iter)) {
 		err = ATT_ECODE_IO;
 		goto done;
 	}
 
-	for (i = 0; i < list->num; i++) {
-		uint8_t *value = list->data[i];
+	while (att_iter_next(&iter, &value)) {
 		struct gatt_char *chars;
 		bt_uuid_t uuid;
 
 		last = att_get_u16(value);
 
-		if (list->len == 7) {
+		if (iter.elen == 7) {
 			bt_uuid_t uuid16 = att_get_uuid16(&value[5]);
 			bt_uuid_to_uuid128(&uuid16, &uuid);
 		} else
@@ -490,8 +485,6 @@ static void char_discovered_cb(guint8 status, const guint8 *ipdu, guint16 iplen,
 									chars);
 	}
 
-	att_data_list_free(list);
-
 	if (last != 0 && (last + 1 < dc->end)) {
 		bt_uuid_t uuid;
 		guint16 oplen;
@@ -28,6 +28,7 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include <stdarg.h>
 #include <string.h>
 #include <glib.h>
 
@@ -43,6 +44,9 @@
 
 #define GATT_TIMEOUT 30
 
+/* Maximum number of PDUs without a response sent per write wakeup */
+#define GATT_WRITE_BATCH 16
+
 struct _GAttrib {
 	GIOChannel *io;
 	int refs;
@@ -54,9 +58,13 @@ struct _GAttrib {
 	GQueue *requests;
 	GQueue *responses;
 	GSList *events;
+	GSList *any_events;
+	GHashTable *handle_events;
 	guint next_cmd_id;
 	GDestroyNotify destroy;
 	gpointer destroy_user_data;
+	GAttribDebugFunc debug_func;
+	gpointer debug_data;
 	bool stale;
 };
 
@@ -67,6 +75,7 @@ struct command {
 	guint16 len;
 	guint8 expected;
 	bool sent;
+	gint64 queued;
 	GAttribResultFunc func;
 	gpointer user_data;
 	GDestroyNotify notify;
@@ -81,6 +90,21 @@ struct event {
 	GDestroyNotify notify;
 };
 
+static void attrib_debug(GAttrib *attrib, const char *format, ...)
+{
+	char str[78];
+	va_list ap;
+
+	if (!attrib->debug_func)
+		return;
+
+	va_start(ap, format);
+	vsnprintf(str, sizeof(str), format, ap);
+	va_end(ap);
+
+	attrib->debug_func(str, attrib->debug_data);
+}
+
 static guint8 opcode2expected(guint8 opcode)
 {
 	switch (opcode) {
@@ -200,6 +224,12 @@ static void attrib_destroy(GAttrib *attrib)
 	g_slist_free(attrib->events);
 	attrib->events = NULL;
 
+	g_slist_free(attrib->any_events);
+	attrib->any_events = NULL;
+
+	g_hash_table_destroy(attrib->handle_events);
+	attrib->handle_events = NULL;
+
 	if (attrib->timeout_watch > 0)
 		g_source_remove(attrib->timeout_watch);
 
@@ -296,6 +326,7 @@ static gboolean can_write_data(GIOChannel *io, GIOCondition cond,
 	gsize len;
 	GIOStatus iostat;
 	GQueue *queue;
+	int count = 0;
 
 	if (attrib->stale)
 		return FALSE;
@@ -303,6 +334,7 @@ static gboolean can_write_data(GIOChannel *io, GIOCondition cond,
 	if (cond & (G_IO_HUP | G_IO_ERR | G_IO_NVAL))
 		return FALSE;
 
+next:
 	queue = attrib->responses;
 	cmd = g_queue_peek_head(queue);
 	if (cmd == NULL) {
@@ -321,6 +353,9 @@ static gboolean can_write_data(GIOChannel *io, GIOCondition cond,
 
 	iostat = g_io_channel_write_chars(io, (char *) cmd->pdu, cmd->len,
 								&len, &gerr);
+	if (iostat == G_IO_STATUS_AGAIN)
+		return TRUE;
+
 	if (iostat != G_IO_STATUS_NORMAL) {
 		if (gerr) {
 			error("%s", gerr->message);
@@ -330,10 +365,25 @@ static gboolean can_write_data(GIOChannel *io, GIOCondition cond,
 		return FALSE;
 	}
 
+	if (attrib->debug_func)
+		attrib_debug(attrib, "< 0x%02x len %u depth %u/%u wait %"
+				G_GINT64_FORMAT " us", cmd->opcode, cmd->len,
+				g_queue_get_length(attrib->responses),
+				g_queue_get_length(attrib->requests),
+				g_get_monotonic_time() - cmd->queued);
+
+	/*
+	 * PDUs that don't expect a response, like write commands and
+	 * notifications, don't need to wait for anything: send several of
+	 * them per wakeup instead of one.
+	 */
 	if (cmd->expected == 0) {
 		g_queue_pop_head(queue);
 		command_destroy(cmd);
 
+		if (++count < GATT_WRITE_BATCH)
+			goto next;
+
 		return TRUE;
 	}
 
@@ -389,11 +439,58 @@ static bool match_event(struct event *evt, const uint8_t *pdu, gsize len)
 	return false;
 }
 
+static bool event_is_indexed(struct event *evt)
+{
+	if (evt->expected == GATTRIB_ALL_EVENTS ||
+					evt->expected == GATTRIB_ALL_REQS)
+		return false;
+
+	return evt->handle != GATTRIB_ALL_HANDLES;
+}
+
+static gpointer event_key(guint8 opcode, guint16 handle)
+{
+	return GUINT_TO_POINTER(opcode << 16 | handle);
+}
+
+static void dispatch_events(GAttrib *attrib, const uint8_t *pdu, gsize len)
+{
+	GSList *any = attrib->any_events;
+	GSList *indexed = NULL;
+
+	/*
+	 * Handlers bound to a specific opcode and handle are looked up
+	 * directly, the remaining ones are matched one by one. Both lists
+	 * are ordered by id, merge them so handlers are still called in
+	 * registration order.
+	 */
+	if (len >= 3)
+		indexed = g_hash_table_lookup(attrib->handle_events,
+				event_key(pdu[0], att_get_u16(&pdu[1])));
+
+	while (any || indexed) {
+		struct event *evt;
+
+		if (any && (!indexed || ((struct event *) any->data)->id <
+					((struct event *) indexed->data)->id)) {
+			evt = any->data;
+			any = any->next;
+
+			if (!match_event(evt, pdu, len))
+				continue;
+		} else {
+			evt = indexed->data;
+			indexed = indexed->next;
+		}
+
+		evt->func(pdu, len, evt->user_data);
+	}
+}
+
 static gboolean received_data(GIOChannel *io, GIOCondition cond, gpointer data)
 {
 	struct _GAttrib *attrib = data;
 	struct command *cmd = NULL;
-	GSList *l;
 	uint8_t buf[512], status;
 	gsize len;
 	GIOStatus iostat;
@@ -415,12 +512,7 @@ static gboolean received_data(GIOChannel *io, GIOCondition cond, gpointer data)
 		goto done;
 	}
 
-	for (l = attrib->events; l; l = l->next) {
-		struct event *evt = l->data;
-
-		if (match_event(evt, buf, len))
-			evt->func(buf, len, evt->user_data);
-	}
+	dispatch_events(attrib, buf, len);
 
 	if (!is_response(buf[0]))
 		return TRUE;
@@ -494,6 +586,9 @@ GAttrib *g_attrib_new(GIOChannel *io)
 	attrib->io = g_io_channel_ref(io);
 	attrib->requests = g_queue_new();
 	attrib->responses = g_queue_new();
+	attrib->handle_events = g_hash_table_new_full(g_direct_hash,
+					g_direct_equal, NULL,
+					(GDestroyNotify) g_slist_free);
 
 	attrib->read_watch = g_io_add_watch(attrib->io,
 			G_IO_IN | G_IO_HUP | G_IO_ERR | G_IO_NVAL,
@@ -527,6 +622,7 @@ guint g_attrib_send(GAttrib *attrib, guint id, const guint8 *pdu, guint16 len,
 	c->func = func;
 	c->user_data = user_data;
 	c->notify = notify;
+	c->queued = g_get_monotonic_time();
 
 	if (is_response(opcode))
 		queue = attrib->responses;
@@ -644,6 +740,12 @@ gboolean g_attrib_cancel_all(GAttrib *attrib)
 gboolean g_attrib_set_debug(GAttrib *attrib,
 		GAttribDebugFunc func, gpointer user_data)
 {
+	if (attrib == NULL)
+		return FALSE;
+
+	attrib->debug_func = func;
+	attrib->debug_data = user_data;
+
 	return TRUE;
 }
 
@@ -689,9 +791,41 @@ guint g_attrib_register(GAttrib *attrib, guint8 opcode, guint16 handle,
 
 	attrib->events = g_slist_append(attrib->events, event);
 
+	if (event_is_indexed(event)) {
+		gpointer key = event_key(opcode, handle);
+		GSList *l = g_hash_table_lookup(attrib->handle_events, key);
+
+		/* Steal the list so replacing it doesn't free it */
+		g_hash_table_steal(attrib->handle_events, key);
+		g_hash_table_insert(attrib->handle_events, key,
+						g_slist_append(l, event));
+	} else
+		attrib->any_events = g_slist_append(attrib->any_events, event);
+
 	return event->id;
 }
 
+static void event_unlink(GAttrib *attrib, struct event *evt)
+{
+	gpointer key;
+	GSList *l;
+
+	attrib->events = g_slist_remove(attrib->events, evt);
+
+	if (!event_is_indexed(evt)) {
+		attrib->any_events = g_slist_remove(attrib->any_events, evt);
+		return;
+	}
+
+	key = event_key(evt->expected, evt->handle);
+	l = g_hash_table_lookup(attrib->handle_events, key);
+	g_hash_table_steal(attrib->handle_events, key);
+
+	l = g_slist_remove(l, evt);
+	if (l)
+		g_hash_table_insert(attrib->handle_events, key, l);
+}
+
 static int event_cmp_by_id(gconstpointer a, gconstpointer b)
 {
 	const struct event *evt = a;
@@ -729,7 +863,7 @@ gboolean g_attrib_unregister(GAttrib *attrib, guint id)
 
 	evt = l->data;
 
-	attrib->events = g_slist_remove(attrib->events, evt);
+	event_unlink(attrib, evt);
 
 	if (evt->notify)
 		evt->notify(evt->user_data);
@@ -758,5 +892,10 @@ gboolean g_attrib_unregister_all(GAttrib *attrib)
 	g_slist_free(attrib->events);
 	attrib->events = NULL;
 
+	g_slist_free(attrib->any_events);
+	attrib->any_events = NULL;
+
+	g_hash_table_remove_all(attrib->handle_events);
+
 	return TRUE;
 }
@@ -299,6 +299,10 @@ void g_dbus_pending_property_error(GDBusPendingReply id, const char *name,
 void g_dbus_emit_property_changed(DBusConnection *connection,
 				const char *path, const char *interface,
 				const char *name);
+void g_dbus_set_property_interval(const char *interface, const char *name,
+							unsigned int interval);
+void g_dbus_get_property_stats(unsigned int *emitted,
+						unsigned int *suppressed);
 gboolean g_dbus_get_properties(DBusConnection *connection, const char *path,
 				const char *interface, DBusMessageIter *iter);
 
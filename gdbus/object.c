@@ -52,25 +52,54 @@ struct generic_data {
 	DBusConnection *conn;
 	char *path;
 	GSList *interfaces;
+	GHashTable *interface_table;
 	GSList *objects;
 	GSList *added;
 	GSList *removed;
-	guint process_id;
+	GList *pending_link;
+	guint delay_id;
 	gboolean pending_prop;
 	char *introspect;
 	struct generic_data *parent;
 };
 
 struct interface_data {
-	char *name;
+	const char *name;
 	const GDBusMethodTable *methods;
 	const GDBusSignalTable *signals;
 	const GDBusPropertyTable *properties;
+	struct member_index *method_index;
+	struct member_index *property_index;
 	GSList *pending_prop;
+	struct property_state *prop_state;
+	DBusMessage *cache;
+	int cache_flags;
 	void *user_data;
 	GDBusDestroyFunction destroy;
 };
 
+/*
+ * Name lookup for a method or property table, shared by every interface
+ * registered with the same table.
+ */
+struct member_index {
+	const void *table;
+	unsigned int refcount;
+	GHashTable *members;
+};
+
+struct property_state {
+	gboolean pending;
+	guint interval;
+	gint64 last;
+};
+
+struct property_interval {
+	char *interface;
+	char *name;
+	guint interval;
+};
+
 struct security_data {
 	GDBusPendingReply pending;
 	DBusMessage *message;
@@ -86,11 +115,19 @@ struct property_data {
 
 static int global_flags = 0;
 static struct generic_data *root;
-static GSList *pending = NULL;
-
-static gboolean process_changes(gpointer user_data);
-static void process_properties_from_interface(struct generic_data *data,
-						struct interface_data *iface);
+static GQueue pending = G_QUEUE_INIT;
+static guint pending_id = 0;
+static GSList *property_intervals = NULL;
+static unsigned int signals_emitted = 0;
+static unsigned int signals_suppressed = 0;
+static DBusMessage *objects_reply = NULL;
+static GHashTable *method_indexes = NULL;
+static GHashTable *property_indexes = NULL;
+
+static void process_changes(struct generic_data *data);
+static gint64 process_properties_from_interface(struct generic_data *data,
+						struct interface_data *iface,
+						gboolean force);
 static void process_property_changes(struct generic_data *data);
 
 static void print_arguments(GString *gstr, const GDBusArgInfo *args,
@@ -555,6 +592,132 @@ static void append_interface(gpointer data, gpointer user_data)
 	dbus_message_iter_close_container(array, &entry);
 }
 
+static void append_iter(DBusMessageIter *base, DBusMessageIter *iter);
+
+static void append_container(DBusMessageIter *base, DBusMessageIter *iter,
+								int type)
+{
+	DBusMessageIter iter_sub, base_sub;
+	char *sig;
+	int element;
+
+	dbus_message_iter_recurse(iter, &iter_sub);
+
+	if (type == DBUS_TYPE_ARRAY) {
+		element = dbus_message_iter_get_element_type(iter);
+		if (dbus_type_is_fixed(element) &&
+					element != DBUS_TYPE_UNIX_FD) {
+			char array_sig[2] = { element, '\0' };
+			const void *value;
+			int n_elements;
+
+			dbus_message_iter_get_fixed_array(&iter_sub, &value,
+								&n_elements);
+			dbus_message_iter_open_container(base, type, array_sig,
+								&base_sub);
+			dbus_message_iter_append_fixed_array(&base_sub, element,
+							&value, n_elements);
+			dbus_message_iter_close_container(base, &base_sub);
+			return;
+		}
+	}
+
+	switch (type) {
+	case DBUS_TYPE_ARRAY:
+	case DBUS_TYPE_VARIANT:
+		sig = dbus_message_iter_get_signature(&iter_sub);
+		break;
+	default:
+		sig = NULL;
+		break;
+	}
+
+	dbus_message_iter_open_container(base, type, sig, &base_sub);
+
+	if (sig != NULL)
+		dbus_free(sig);
+
+	append_iter(&base_sub, &iter_sub);
+
+	dbus_message_iter_close_container(base, &base_sub);
+}
+
+static void append_iter(DBusMessageIter *base, DBusMessageIter *iter)
+{
+	int type;
+
+	while ((type = dbus_message_iter_get_arg_type(iter)) !=
+							DBUS_TYPE_INVALID) {
+		if (dbus_type_is_basic(type)) {
+			union {
+				dbus_uint64_t u64;
+				double dbl;
+				const char *str;
+			} value;
+
+			dbus_message_iter_get_basic(iter, &value);
+			dbus_message_iter_append_basic(base, type, &value);
+		} else if (dbus_type_is_container(type))
+			append_container(base, iter, type);
+
+		dbus_message_iter_next(iter);
+	}
+}
+
+/*
+ * GetManagedObjects replies are assembled from a pre-marshalled property
+ * dictionary per interface, so only interfaces whose properties changed
+ * since the last call go through their getters again. The assembled reply
+ * is kept as well and copied as long as nothing in the tree changes.
+ */
+static void invalidate_objects(void)
+{
+	if (objects_reply == NULL)
+		return;
+
+	dbus_message_unref(objects_reply);
+	objects_reply = NULL;
+}
+
+static void invalidate_interface(struct interface_data *iface)
+{
+	if (iface->cache != NULL) {
+		dbus_message_unref(iface->cache);
+		iface->cache = NULL;
+	}
+
+	invalidate_objects();
+}
+
+static gboolean append_cached_properties(struct interface_data *iface,
+							DBusMessageIter *iter)
+{
+	DBusMessageIter props;
+
+	/* Experimental properties come and go with the global flags */
+	if (iface->cache != NULL && iface->cache_flags != global_flags) {
+		dbus_message_unref(iface->cache);
+		iface->cache = NULL;
+	}
+
+	if (iface->cache == NULL) {
+		iface->cache_flags = global_flags;
+		iface->cache = dbus_message_new(DBUS_MESSAGE_TYPE_METHOD_RETURN);
+		if (iface->cache == NULL)
+			return FALSE;
+
+		dbus_message_iter_init_append(iface->cache, &props);
+		append_properties(iface, &props);
+	}
+
+	if (!dbus_message_iter_init(iface->cache, &props))
+		return FALSE;
+
+	append_iter(iter, &props);
+
+	return TRUE;
+}
+
 static void emit_interfaces_added(struct generic_data *data)
 {
 	DBusMessage *signal;
@@ -587,6 +750,8 @@ static void emit_interfaces_added(struct generic_data *data)
 	g_slist_free(data->added);
 	data->added = NULL;
 
+	invalidate_objects();
+
 	dbus_message_iter_close_container(&iter, &array);
 
 	/* Use dbus_connection_send to avoid recursive calls to g_dbus_flush */
@@ -594,21 +759,99 @@ static void emit_interfaces_added(struct generic_data *data)
 	dbus_message_unref(signal);
 }
 
-static struct interface_data *find_interface(GSList *interfaces,
-						const char *name)
+static struct interface_data *find_interface(struct generic_data *data,
+							const char *name)
 {
-	GSList *list;
-
 	if (name == NULL)
 		return NULL;
 
-	for (list = interfaces; list; list = list->next) {
-		struct interface_data *iface = list->data;
-		if (!strcmp(name, iface->name))
-			return iface;
+	return g_hash_table_lookup(data->interface_table, name);
+}
+
+static struct member_index *member_index_ref(GHashTable **indexes,
+							const void *table)
+{
+	struct member_index *index;
+
+	if (*indexes == NULL)
+		*indexes = g_hash_table_new(NULL, NULL);
+
+	index = g_hash_table_lookup(*indexes, table);
+	if (index != NULL) {
+		index->refcount++;
+		return index;
 	}
 
-	return NULL;
+	index = g_new0(struct member_index, 1);
+	index->table = table;
+	index->refcount = 1;
+	index->members = g_hash_table_new(g_str_hash, g_str_equal);
+
+	g_hash_table_insert(*indexes, (void *) table, index);
+
+	return index;
+}
+
+static void member_index_unref(GHashTable *indexes,
+						struct member_index *index)
+{
+	if (index == NULL)
+		return;
+
+	if (--index->refcount > 0)
+		return;
+
+	g_hash_table_remove(indexes, index->table);
+	g_hash_table_destroy(index->members);
+	g_free(index);
+}
+
+static struct member_index *index_methods(const GDBusMethodTable *methods)
+{
+	struct member_index *index;
+	const GDBusMethodTable *method;
+
+	if (methods == NULL)
+		return NULL;
+
+	index = member_index_ref(&method_indexes, methods);
+	if (index->refcount > 1)
+		return index;
+
+	/* Dispatching has always stopped at the first entry without handler */
+	for (method = methods; method->name && method->function; method++) {
+		if (g_hash_table_lookup(index->members, method->name))
+			continue;
+
+		g_hash_table_insert(index->members, (char *) method->name,
+							(void *) method);
+	}
+
+	return index;
+}
+
+static struct member_index *index_properties(
+					const GDBusPropertyTable *properties)
+{
+	struct member_index *index;
+	const GDBusPropertyTable *property;
+
+	if (properties == NULL)
+		return NULL;
+
+	index = member_index_ref(&property_indexes, properties);
+	if (index->refcount > 1)
+		return index;
+
+	for (property = properties; property->name; property++) {
+		if (g_hash_table_lookup(index->members, property->name))
+			continue;
+
+		g_hash_table_insert(index->members, (char *) property->name,
+							(void *) property);
+	}
+
+	return index;
 }
 
 static gboolean g_dbus_args_have_signature(const GDBusArgInfo *args,
@@ -632,51 +875,75 @@ static gboolean g_dbus_args_have_signature(const GDBusArgInfo *args,
 	return TRUE;
 }
 
+static gboolean process_pending(gpointer user_data)
+{
+	struct generic_data *data;
+
+	pending_id = 0;
+
+	while ((data = g_queue_peek_head(&pending)))
+		process_changes(data);
+
+	return FALSE;
+}
+
+/*
+ * Objects with pending changes are queued and all of them are processed
+ * from a single idle callback, in the order they were queued.
+ */
 static void add_pending(struct generic_data *data)
 {
-	if (data->process_id > 0)
+	if (data->pending_link != NULL)
 		return;
 
-	data->process_id = g_idle_add(process_changes, data);
+	g_queue_push_tail(&pending, data);
+	data->pending_link = g_queue_peek_tail_link(&pending);
 
-	pending = g_slist_append(pending, data);
+	if (pending_id == 0)
+		pending_id = g_idle_add(process_pending, NULL);
 }
 
 static gboolean remove_interface(struct generic_data *data, const char *name)
 {
 	struct interface_data *iface;
 
-	iface = find_interface(data->interfaces, name);
+	iface = find_interface(data, name);
 	if (iface == NULL)
 		return FALSE;
 
-	process_properties_from_interface(data, iface);
+	process_properties_from_interface(data, iface, TRUE);
 
 	data->interfaces = g_slist_remove(data->interfaces, iface);
+	g_hash_table_remove(data->interface_table, iface->name);
+
+	invalidate_interface(iface);
 
 	if (iface->destroy) {
 		iface->destroy(iface->user_data);
 		iface->user_data = NULL;
 	}
 
+	g_free(iface->prop_state);
+
+	member_index_unref(method_indexes, iface->method_index);
+	member_index_unref(property_indexes, iface->property_index);
+
 	/*
 	 * Interface being removed was just added, on the same mainloop
 	 * iteration? Don't send any signal
 	 */
 	if (g_slist_find(data->added, iface)) {
 		data->added = g_slist_remove(data->added, iface);
-		g_free(iface->name);
 		g_free(iface);
 		return TRUE;
 	}
 
 	if (data->parent == NULL) {
-		g_free(iface->name);
 		g_free(iface);
 		return TRUE;
 	}
 
-	data->removed = g_slist_prepend(data->removed, iface->name);
+	data->removed = g_slist_prepend(data->removed, (char *) iface->name);
 	g_free(iface);
 
 	add_pending(data);
@@ -729,28 +996,30 @@ static struct generic_data *invalidate_parent_data(DBusConnection *conn,
 	data->objects = g_slist_prepend(data->objects, child);
 	child->parent = data;
 
+	invalidate_objects();
+
 done:
 	g_free(parent_path);
 	return data;
 }
 
-static inline const GDBusPropertyTable *find_property(const GDBusPropertyTable *properties,
-							const char *name)
+static inline const GDBusPropertyTable *find_property(
+						struct interface_data *iface,
+						const char *name)
 {
 	const GDBusPropertyTable *p;
 
-	for (p = properties; p && p->name; p++) {
-		if (strcmp(name, p->name) != 0)
-			continue;
+	if (iface->property_index == NULL || name == NULL)
+		return NULL;
 
-		if (check_experimental(p->flags,
-					G_DBUS_PROPERTY_FLAG_EXPERIMENTAL))
-			break;
+	p = g_hash_table_lookup(iface->property_index->members, name);
+	if (p == NULL)
+		return NULL;
 
-		return p;
-	}
+	if (check_experimental(p->flags, G_DBUS_PROPERTY_FLAG_EXPERIMENTAL))
+		return NULL;
 
-	return NULL;
+	return p;
 }
 
 static DBusMessage *properties_get(DBusConnection *connection,
@@ -769,12 +1038,12 @@ static DBusMessage *properties_get(DBusConnection *connection,
 					DBUS_TYPE_INVALID))
 		return NULL;
 
-	iface = find_interface(data->interfaces, interface);
+	iface = find_interface(data, interface);
 	if (iface == NULL)
 		return g_dbus_create_error(message, DBUS_ERROR_INVALID_ARGS,
 				"No such interface '%s'", interface);
 
-	property = find_property(iface->properties, name);
+	property = find_property(iface, name);
 	if (property == NULL)
 		return g_dbus_create_error(message, DBUS_ERROR_INVALID_ARGS,
 				"No such property '%s'", name);
@@ -820,7 +1089,7 @@ static DBusMessage *properties_get_all(DBusConnection *connection,
 					DBUS_TYPE_INVALID))
 		return NULL;
 
-	iface = find_interface(data->interfaces, interface);
+	iface = find_interface(data, interface);
 	if (iface == NULL)
 		return g_dbus_create_error(message, DBUS_ERROR_INVALID_ARGS,
 					"No such interface '%s'", interface);
@@ -875,12 +1144,12 @@ static DBusMessage *properties_set(DBusConnection *connection,
 
 	dbus_message_iter_recurse(&iter, &sub);
 
-	iface = find_interface(data->interfaces, interface);
+	iface = find_interface(data, interface);
 	if (iface == NULL)
 		return g_dbus_create_error(message, DBUS_ERROR_INVALID_ARGS,
 					"No such interface '%s'", interface);
 
-	property = find_property(iface->properties, name);
+	property = find_property(iface, name);
 	if (property == NULL)
 		return g_dbus_create_error(message,
 						DBUS_ERROR_UNKNOWN_PROPERTY,
@@ -970,7 +1239,7 @@ static void emit_interfaces_removed(struct generic_data *data)
 					DBUS_TYPE_STRING_AS_STRING, &array);
 
 	g_slist_foreach(data->removed, append_name, &array);
-	g_slist_free_full(data->removed, g_free);
+	g_slist_free(data->removed);
 	data->removed = NULL;
 
 	dbus_message_iter_close_container(&iter, &array);
@@ -982,18 +1251,20 @@ static void emit_interfaces_removed(struct generic_data *data)
 
 static void remove_pending(struct generic_data *data)
 {
-	if (data->process_id > 0) {
-		g_source_remove(data->process_id);
-		data->process_id = 0;
-	}
+	if (data->pending_link == NULL)
+		return;
 
-	pending = g_slist_remove(pending, data);
+	g_queue_delete_link(&pending, data->pending_link);
+	data->pending_link = NULL;
+
+	if (g_queue_is_empty(&pending) && pending_id > 0) {
+		g_source_remove(pending_id);
+		pending_id = 0;
+	}
 }
 
-static gboolean process_changes(gpointer user_data)
+static void process_changes(struct generic_data *data)
 {
-	struct generic_data *data = user_data;
-
 	remove_pending(data);
 
 	if (data->added != NULL)
@@ -1005,8 +1276,6 @@ static gboolean process_changes(gpointer user_data)
 
 	if (data->removed != NULL)
 		emit_interfaces_removed(data);
-
-	return FALSE;
 }
 
 static void generic_unregister(DBusConnection *connection, void *user_data)
@@ -1017,15 +1286,19 @@ static void generic_unregister(DBusConnection *connection, void *user_data)
 	if (parent != NULL)
 		parent->objects = g_slist_remove(parent->objects, data);
 
-	if (data->process_id > 0) {
-		g_source_remove(data->process_id);
+	invalidate_objects();
+
+	if (data->delay_id > 0)
+		g_source_remove(data->delay_id);
+
+	if (data->pending_link != NULL)
 		process_changes(data);
-	}
 
 	g_slist_foreach(data->objects, reset_parent, data->parent);
 	g_slist_free(data->objects);
 
 	dbus_connection_unref(data->conn);
+	g_hash_table_destroy(data->interface_table);
 	g_free(data->introspect);
 	g_free(data->path);
 	g_free(data);
@@ -1037,19 +1310,29 @@ static DBusHandlerResult generic_message(DBusConnection *connection,
 	struct generic_data *data = user_data;
 	struct interface_data *iface;
 	const GDBusMethodTable *method;
-	const char *interface;
+	const char *interface, *member;
+
+	if (dbus_message_get_type(message) != DBUS_MESSAGE_TYPE_METHOD_CALL)
+		return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
 
 	interface = dbus_message_get_interface(message);
 
-	iface = find_interface(data->interfaces, interface);
-	if (iface == NULL)
+	iface = find_interface(data, interface);
+	if (iface == NULL || iface->method_index == NULL)
 		return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
 
-	for (method = iface->methods; method &&
-			method->name && method->function; method++) {
+	member = dbus_message_get_member(message);
+	if (member == NULL)
+		return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+
+	/*
+	 * The index points at the first method with this name, overloads
+	 * with a different signature may follow later in the table.
+	 */
+	method = g_hash_table_lookup(iface->method_index->members, member);
 
-		if (dbus_message_is_method_call(message, iface->name,
-							method->name) == FALSE)
+	for (; method && method->name && method->function; method++) {
+		if (strcmp(method->name, member) != 0)
 			continue;
 
 		if (check_experimental(method->flags,
@@ -1098,10 +1381,21 @@ static void append_interfaces(struct generic_data *data, DBusMessageIter *iter)
 				DBUS_DICT_ENTRY_END_CHAR_AS_STRING, &array);
 
 	for (l = data->interfaces; l != NULL; l = l->next) {
-		if (g_slist_find(data->added, l->data))
+		struct interface_data *iface = l->data;
+		DBusMessageIter entry;
+
+		if (g_slist_find(data->added, iface))
 			continue;
 
-		append_interface(l->data, &array);
+		dbus_message_iter_open_container(&array, DBUS_TYPE_DICT_ENTRY,
+								NULL, &entry);
+		dbus_message_iter_append_basic(&entry, DBUS_TYPE_STRING,
+								&iface->name);
+
+		if (!append_cached_properties(iface, &entry))
+			append_properties(iface, &entry);
+
+		dbus_message_iter_close_container(&array, &entry);
 	}
 
 	dbus_message_iter_close_container(iter, &array);
@@ -1131,6 +1425,19 @@ static DBusMessage *get_objects(DBusConnection *connection,
 	DBusMessageIter iter;
 	DBusMessageIter array;
 
+	if (data == root && objects_reply != NULL) {
+		reply = dbus_message_copy(objects_reply);
+		if (reply == NULL)
+			return NULL;
+
+		dbus_message_set_reply_serial(reply,
+					dbus_message_get_serial(message));
+		dbus_message_set_destination(reply,
+					dbus_message_get_sender(message));
+
+		return reply;
+	}
+
 	reply = dbus_message_new_method_return(message);
 	if (reply == NULL)
 		return NULL;
@@ -1156,6 +1463,9 @@ static DBusMessage *get_objects(DBusConnection *connection,
 
 	dbus_message_iter_close_container(&iter, &array);
 
+	if (data == root)
+		objects_reply = dbus_message_ref(reply);
+
 	return reply;
 }
 
@@ -1186,6 +1496,7 @@ static gboolean add_interface(struct generic_data *data,
 	const GDBusMethodTable *method;
 	const GDBusSignalTable *signal;
 	const GDBusPropertyTable *property;
+	GSList *l;
 
 	for (method = methods; method && method->name; method++) {
 		if (!check_experimental(method->flags,
@@ -1210,14 +1521,41 @@ static gboolean add_interface(struct generic_data *data,
 
 done:
 	iface = g_new0(struct interface_data, 1);
-	iface->name = g_strdup(name);
+	iface->name = g_intern_string(name);
 	iface->methods = methods;
 	iface->signals = signals;
 	iface->properties = properties;
+	iface->method_index = index_methods(methods);
+	iface->property_index = index_properties(properties);
 	iface->user_data = user_data;
 	iface->destroy = destroy;
 
+	property = properties;
+	while (property && property->name)
+		property++;
+
+	if (property != properties)
+		iface->prop_state = g_new0(struct property_state,
+							property - properties);
+
+	for (l = property_intervals; l != NULL; l = l->next) {
+		struct property_interval *pi = l->data;
+
+		if (strcmp(pi->interface, name) != 0)
+			continue;
+
+		property = find_property(iface, pi->name);
+		if (property == NULL)
+			continue;
+
+		iface->prop_state[property - properties].interval =
+								pi->interval;
+	}
+
 	data->interfaces = g_slist_append(data->interfaces, iface);
+	g_hash_table_insert(data->interface_table, (char *) iface->name, iface);
+	invalidate_objects();
+
 	if (data->parent == NULL)
 		return TRUE;
 
@@ -1245,11 +1583,13 @@ static struct generic_data *object_path_ref(DBusConnection *connection,
 	data->conn = dbus_connection_ref(connection);
 	data->path = g_strdup(path);
 	data->refcount = 1;
+	data->interface_table = g_hash_table_new(g_str_hash, g_str_equal);
 
 	data->introspect = g_strdup(DBUS_INTROSPECT_1_0_XML_DOCTYPE_DECL_NODE "<node></node>");
 
 	if (!dbus_connection_register_object_path(connection, path,
 						&generic_table, data)) {
+		g_hash_table_destroy(data->interface_table);
 		g_free(data->introspect);
 		g_free(data);
 		return NULL;
@@ -1303,7 +1643,7 @@ static gboolean check_signal(DBusConnection *conn, const char *path,
 		return FALSE;
 	}
 
-	iface = find_interface(data->interfaces, interface);
+	iface = find_interface(data, interface);
 	if (iface == NULL) {
 		error("dbus_connection_emit_signal: %s does not implement %s",
 				path, interface);
@@ -1342,7 +1682,7 @@ gboolean g_dbus_register_interface(DBusConnection *connection,
 	if (data == NULL)
 		return FALSE;
 
-	if (find_interface(data->interfaces, name)) {
+	if (find_interface(data, name)) {
 		object_path_unref(connection, path);
 		return FALSE;
 	}
@@ -1353,7 +1693,7 @@ gboolean g_dbus_register_interface(DBusConnection *connection,
 		return FALSE;
 	}
 
-	if (properties != NULL && !find_interface(data->interfaces,
+	if (properties != NULL && !find_interface(data,
 						DBUS_INTERFACE_PROPERTIES))
 		add_interface(data, DBUS_INTERFACE_PROPERTIES,
 				properties_methods, properties_signals, NULL,
@@ -1466,9 +1806,9 @@ DBusMessage *g_dbus_create_reply(DBusMessage *message, int type, ...)
 
 static void g_dbus_flush(DBusConnection *connection)
 {
-	GSList *l;
+	GList *l;
 
-	for (l = pending; l;) {
+	for (l = pending.head; l;) {
 		struct generic_data *data = l->data;
 
 		l = l->next;
@@ -1643,29 +1983,65 @@ fail:
 	return ret;
 }
 
-static void process_properties_from_interface(struct generic_data *data,
-						struct interface_data *iface)
+/*
+ * Send the pending changes of an interface, except for properties emitted
+ * less than their minimum interval ago unless force is set. Returns how
+ * long until the next of those held back properties can be sent, in
+ * microseconds, or 0 if none is left.
+ */
+static gint64 process_properties_from_interface(struct generic_data *data,
+						struct interface_data *iface,
+						gboolean force)
 {
 	GSList *l;
 	DBusMessage *signal;
 	DBusMessageIter iter, dict, array;
-	GSList *invalidated;
-
-	data->pending_prop = FALSE;
+	GSList *ready, *deferred, *invalidated;
+	gint64 now, wait = 0;
 
 	if (iface->pending_prop == NULL)
-		return;
+		return 0;
+
+	now = g_get_monotonic_time();
+	ready = NULL;
+	deferred = NULL;
+
+	/* pending_prop holds the most recent change first */
+	for (l = iface->pending_prop; l != NULL; l = l->next) {
+		const GDBusPropertyTable *p = l->data;
+		struct property_state *state;
+		gint64 next;
+
+		state = &iface->prop_state[p - iface->properties];
+		next = state->last + (gint64) state->interval * 1000;
+
+		if (!force && state->interval > 0 && now < next) {
+			deferred = g_slist_append(deferred, (void *) p);
+			if (wait == 0 || next - now < wait)
+				wait = next - now;
+			continue;
+		}
+
+		state->pending = FALSE;
+		state->last = now;
+		ready = g_slist_prepend(ready, (void *) p);
+	}
+
+	g_slist_free(iface->pending_prop);
+	iface->pending_prop = deferred;
+
+	if (ready == NULL)
+		return wait;
 
 	signal = dbus_message_new_signal(data->path,
 			DBUS_INTERFACE_PROPERTIES, "PropertiesChanged");
 	if (signal == NULL) {
 		error("Unable to allocate new " DBUS_INTERFACE_PROPERTIES
 						".PropertiesChanged signal");
-		return;
+		g_slist_free(ready);
+		return wait;
 	}
 
-	iface->pending_prop = g_slist_reverse(iface->pending_prop);
-
 	dbus_message_iter_init_append(signal, &iter);
 	dbus_message_iter_append_basic(&iter, DBUS_TYPE_STRING,	&iface->name);
 	dbus_message_iter_open_container(&iter, DBUS_TYPE_ARRAY,
@@ -1675,7 +2051,7 @@ static void process_properties_from_interface(struct generic_data *data,
 
 	invalidated = NULL;
 
-	for (l = iface->pending_prop; l != NULL; l = l->next) {
+	for (l = ready; l != NULL; l = l->next) {
 		GDBusPropertyTable *p = l->data;
 
 		if (p->get == NULL)
@@ -1702,23 +2078,53 @@ static void process_properties_from_interface(struct generic_data *data,
 	g_slist_free(invalidated);
 	dbus_message_iter_close_container(&iter, &array);
 
-	g_slist_free(iface->pending_prop);
-	iface->pending_prop = NULL;
+	g_slist_free(ready);
+
+	signals_emitted++;
 
 	/* Use dbus_connection_send to avoid recursive calls to g_dbus_flush */
 	dbus_connection_send(data->conn, signal, NULL);
 	dbus_message_unref(signal);
+
+	return wait;
+}
+
+static gboolean process_delayed_changes(gpointer user_data)
+{
+	struct generic_data *data = user_data;
+
+	data->delay_id = 0;
+
+	add_pending(data);
+
+	return FALSE;
 }
 
 static void process_property_changes(struct generic_data *data)
 {
 	GSList *l;
+	gint64 wait = 0;
+
+	data->pending_prop = FALSE;
 
 	for (l = data->interfaces; l != NULL; l = l->next) {
 		struct interface_data *iface = l->data;
+		gint64 next;
 
-		process_properties_from_interface(data, iface);
+		next = process_properties_from_interface(data, iface, FALSE);
+		if (next > 0 && (wait == 0 || next < wait))
+			wait = next;
 	}
+
+	if (wait == 0)
+		return;
+
+	/* Come back once the first held back property can be sent */
+	data->pending_prop = TRUE;
+
+	if (data->delay_id == 0)
+		data->delay_id = g_timeout_add((wait + 999) / 1000,
+						process_delayed_changes, data);
 }
 
 void g_dbus_emit_property_changed(DBusConnection *connection,
@@ -1728,6 +2134,7 @@ void g_dbus_emit_property_changed(DBusConnection *connection,
 	const GDBusPropertyTable *property;
 	struct generic_data *data;
 	struct interface_data *iface;
+	struct property_state *state;
 
 	if (path == NULL)
 		return;
@@ -1736,10 +2143,12 @@ void g_dbus_emit_property_changed(DBusConnection *connection,
 					(void **) &data) || data == NULL)
 		return;
 
-	iface = find_interface(data->interfaces, interface);
+	iface = find_interface(data, interface);
 	if (iface == NULL)
 		return;
 
+	invalidate_interface(iface);
+
 	/*
 	 * If ObjectManager is attached, don't emit property changed if
 	 * interface is not yet published
@@ -1747,15 +2156,20 @@ void g_dbus_emit_property_changed(DBusConnection *connection,
 	if (root && g_slist_find(data->added, iface))
 		return;
 
-	property = find_property(iface->properties, name);
+	property = find_property(iface, name);
 	if (property == NULL) {
 		error("Could not find property %s in %p", name,
 							iface->properties);
 		return;
 	}
 
-	if (g_slist_find(iface->pending_prop, (void *) property) != NULL)
+	state = &iface->prop_state[property - iface->properties];
+	if (state->pending) {
+		signals_suppressed++;
 		return;
+	}
+
+	state->pending = TRUE;
 
 	data->pending_prop = TRUE;
 	iface->pending_prop = g_slist_prepend(iface->pending_prop,
@@ -1777,7 +2191,7 @@ gboolean g_dbus_get_properties(DBusConnection *connection, const char *path,
 					(void **) &data) || data == NULL)
 		return FALSE;
 
-	iface = find_interface(data->interfaces, interface);
+	iface = find_interface(data, interface);
 	if (iface == NULL)
 		return FALSE;
 
@@ -1808,6 +2222,7 @@ gboolean g_dbus_detach_object_manager(DBusConnection *connection)
 					DBUS_INTERFACE_OBJECT_MANAGER))
 		return FALSE;
 
+	invalidate_objects();
 	root = NULL;
 
 	return TRUE;
@@ -1816,4 +2231,39 @@ gboolean g_dbus_detach_object_manager(DBusConnection *connection)
 void g_dbus_set_flags(int flags)
 {
 	global_flags = flags;
+	invalidate_objects();
+}
+
+void g_dbus_set_property_interval(const char *interface, const char *name,
+							unsigned int interval)
+{
+	struct property_interval *pi;
+	GSList *l;
+
+	for (l = property_intervals; l != NULL; l = l->next) {
+		pi = l->data;
+
+		if (strcmp(pi->interface, interface) == 0 &&
+					strcmp(pi->name, name) == 0) {
+			pi->interval = interval;
+			return;
+		}
+	}
+
+	pi = g_new0(struct property_interval, 1);
+	pi->interface = g_strdup(interface);
+	pi->name = g_strdup(name);
+	pi->interval = interval;
+
+	property_intervals = g_slist_prepend(property_intervals, pi);
+}
+
+void g_dbus_get_property_stats(unsigned int *emitted,
+						unsigned int *suppressed)
+{
+	if (emitted)
+		*emitted = signals_emitted;
+
+	if (suppressed)
+		*suppressed = signals_suppressed;
 }
@@ -969,6 +969,9 @@ void sdp_data_free(sdp_data_t *d)
 	case SDP_SEQ8:
 	case SDP_SEQ16:
 	case SDP_SEQ32:
+	case SDP_ALT8:
+	case SDP_ALT16:
+	case SDP_ALT32:
 		data_seq_free(d);
 		break;
 	case SDP_URL_STR8:
@@ -1293,6 +1296,12 @@ static sdp_data_t *extract_seq(const void *p, int bufsize, int *len,
 		if (curr == NULL)
 			break;
 
+		/* A truncated sequence header makes no progress */
+		if (attrlen == 0) {
+			sdp_data_free(curr);
+			break;
+		}
+
 		if (prev)
 			prev->next = curr;
 		else
@@ -39,14 +39,16 @@
 #include "lib/bluetooth.h"
 #include "lib/hci.h"
 #include "lib/mgmt.h"
+#include "src/shared/btsnoop.h"
 
 #include "mainloop.h"
 #include "display.h"
 #include "packet.h"
-#include "btsnoop.h"
 #include "hcidump.h"
+#include "parallel.h"
 #include "control.h"
 
+static struct btsnoop *btsnoop_file = NULL;
 static bool hcidump_fallback = false;
 
 #define MAX_PACKET_SIZE		(1486 + 4)
@@ -626,7 +628,8 @@ static void data_callback(int fd, uint32_t events, void *user_data)
 			break;
 		case HCI_CHANNEL_MONITOR:
 			packet_monitor(tv, index, opcode, data->buf, pktlen);
-			btsnoop_write_hci(tv, index, opcode, data->buf, pktlen);
+			btsnoop_write_hci(btsnoop_file, tv, index, opcode,
+							data->buf, pktlen);
 			break;
 		}
 	}
@@ -809,64 +812,133 @@ void control_server(const char *path)
 
 void control_writer(const char *path)
 {
-	btsnoop_create(path, BTSNOOP_TYPE_EXTENDED_HCI);
+	btsnoop_file = btsnoop_create(path, BTSNOOP_TYPE_MONITOR);
 }
 
-void control_reader(const char *path)
+static bool seek_window(const char *path, const struct timeval *begin,
+				const struct timeval *end, bool save_index,
+				struct timeval *limit)
 {
-	unsigned char buf[MAX_PACKET_SIZE];
+	struct timeval first, tv;
+	const void *data;
+	uint16_t size;
+	char *index_path = NULL;
+
+	if (!btsnoop_read(btsnoop_file, &first, NULL, &data, &size))
+		return false;
+
+	/* Keep time offsets relative to the start of the trace */
+	packet_set_time_offset(&first);
+
+	/* The index is only kept next to the trace when asked for */
+	if (save_index && asprintf(&index_path, "%s.idx", path) < 0)
+		return false;
+
+	btsnoop_build_index(btsnoop_file, index_path);
+	free(index_path);
+
+	if (end)
+		timeradd(&first, end, limit);
+
+	if (!begin)
+		return btsnoop_seek(btsnoop_file, 0);
+
+	timeradd(&first, begin, &tv);
+
+	return btsnoop_seek_time(btsnoop_file, &tv);
+}
+
+int control_reader(const char *path, const struct timeval *begin,
+				const struct timeval *end, bool save_index,
+				unsigned int jobs)
+{
+	const void *data;
 	uint16_t pktlen;
 	uint32_t type;
-	struct timeval tv;
+	struct timeval tv, limit;
+	int err = 0;
 
-	if (btsnoop_open(path, &type) < 0)
-		return;
+	btsnoop_file = btsnoop_open(path);
+	if (!btsnoop_file) {
+		fprintf(stderr, "Failed to open btsnoop file\n");
+		return -EIO;
+	}
+
+	type = btsnoop_get_type(btsnoop_file);
 
 	switch (type) {
 	case BTSNOOP_TYPE_HCI:
 	case BTSNOOP_TYPE_UART:
-	case BTSNOOP_TYPE_EXTENDED_PHY:
+	case BTSNOOP_TYPE_SIMULATOR:
 		packet_del_filter(PACKET_FILTER_SHOW_INDEX);
 		break;
 
-	case BTSNOOP_TYPE_EXTENDED_HCI:
+	case BTSNOOP_TYPE_MONITOR:
 		packet_add_filter(PACKET_FILTER_SHOW_INDEX);
 		break;
 	}
 
+	if ((begin || end) && !seek_window(path, begin, end, save_index,
+								&limit)) {
+		fprintf(stderr, "Failed to seek in btsnoop file\n");
+		btsnoop_unref(btsnoop_file);
+		btsnoop_file = NULL;
+		return -EIO;
+	}
+
 	open_pager();
 
 	switch (type) {
 	case BTSNOOP_TYPE_HCI:
 	case BTSNOOP_TYPE_UART:
-	case BTSNOOP_TYPE_EXTENDED_HCI:
+	case BTSNOOP_TYPE_MONITOR:
+		err = parallel_reader(btsnoop_file, jobs, end ? &limit : NULL);
+		if (err < 0) {
+			fprintf(stderr, "Failed to merge decoded output\n");
+			break;
+		}
+
+		if (err > 0) {
+			err = 0;
+			break;
+		}
+
 		while (1) {
 			uint16_t index, opcode;
 
-			if (btsnoop_read_hci(&tv, &index, &opcode,
-							buf, &pktlen) < 0)
+			if (!btsnoop_read_hci(btsnoop_file, &tv, &index,
+						&opcode, &data, &pktlen))
+				break;
+
+			if (end && timercmp(&tv, &limit, >))
 				break;
 
-			packet_monitor(&tv, index, opcode, buf, pktlen);
+			packet_monitor(&tv, index, opcode, data, pktlen);
 		}
 		break;
 
-	case BTSNOOP_TYPE_EXTENDED_PHY:
+	case BTSNOOP_TYPE_SIMULATOR:
 		while (1) {
 			uint16_t frequency;
 
-			if (btsnoop_read_phy(&tv, &frequency,
-							buf, &pktlen) < 0)
+			if (!btsnoop_read_phy(btsnoop_file, &tv, &frequency,
+							&data, &pktlen))
 				break;
 
-			packet_simulator(&tv, frequency, buf, pktlen);
+			if (end && timercmp(&tv, &limit, >))
+				break;
+
+			packet_simulator(&tv, frequency, data, pktlen);
 		}
 		break;
 	}
 
 	close_pager();
 
-	btsnoop_close();
+	btsnoop_unref(btsnoop_file);
+	btsnoop_file = NULL;
+
+	return err;
 }
 
 int control_tracing(void)
@@ -23,9 +23,13 @@
  */
 
 #include <stdint.h>
+#include <stdbool.h>
+#include <sys/time.h>
 
 void control_writer(const char *path);
-void control_reader(const char *path);
+int control_reader(const char *path, const struct timeval *begin,
+				const struct timeval *end, bool save_index,
+				unsigned int jobs);
 void control_server(const char *path);
 int control_tracing(void);
 
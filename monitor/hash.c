@@ -0,0 +1,231 @@
+/*
+ *
+ *  BlueZ - Bluetooth protocol stack for Linux
+ *
+ *  Copyright (C) 2013  Intel Corporation
+ *
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdlib.h>
+
+#include "hash.h"
+
+#define MIN_BUCKETS	64
+
+struct hash_entry {
+	uint64_t key;
+	void *value;
+	struct hash_entry *next;
+};
+
+struct hash {
+	struct hash_entry **buckets;
+	unsigned int num_buckets;
+	unsigned int count;
+	hash_destroy_func_t destroy;
+};
+
+static inline unsigned int bucket_of(uint64_t key, unsigned int num_buckets)
+{
+	/* Fibonacci hashing spreads the packed index/handle/cid keys */
+	key *= 0x9e3779b97f4a7c15ull;
+
+	return (key >> 32) & (num_buckets - 1);
+}
+
+struct hash *hash_new(hash_destroy_func_t destroy)
+{
+	struct hash *hash;
+
+	hash = calloc(1, sizeof(*hash));
+	if (!hash)
+		return NULL;
+
+	hash->buckets = calloc(MIN_BUCKETS, sizeof(*hash->buckets));
+	if (!hash->buckets) {
+		free(hash);
+		return NULL;
+	}
+
+	hash->num_buckets = MIN_BUCKETS;
+	hash->destroy = destroy;
+
+	return hash;
+}
+
+void hash_free(struct hash *hash)
+{
+	unsigned int i;
+
+	if (!hash)
+		return;
+
+	for (i = 0; i < hash->num_buckets; i++) {
+		struct hash_entry *entry = hash->buckets[i];
+
+		while (entry) {
+			struct hash_entry *next = entry->next;
+
+			if (hash->destroy)
+				hash->destroy(entry->value);
+
+			free(entry);
+			entry = next;
+		}
+	}
+
+	free(hash->buckets);
+	free(hash);
+}
+
+static void resize(struct hash *hash, unsigned int num_buckets)
+{
+	struct hash_entry **buckets;
+	unsigned int i;
+
+	buckets = calloc(num_buckets, sizeof(*buckets));
+	if (!buckets)
+		return;
+
+	for (i = 0; i < hash->num_buckets; i++) {
+		struct hash_entry *entry = hash->buckets[i];
+
+		while (entry) {
+			struct hash_entry *next = entry->next;
+			unsigned int n = bucket_of(entry->key, num_buckets);
+
+			entry->next = buckets[n];
+			buckets[n] = entry;
+			entry = next;
+		}
+	}
+
+	free(hash->buckets);
+	hash->buckets = buckets;
+	hash->num_buckets = num_buckets;
+}
+
+static struct hash_entry **find_entry(struct hash *hash, uint64_t key)
+{
+	struct hash_entry **entry;
+
+	entry = &hash->buckets[bucket_of(key, hash->num_buckets)];
+
+	while (*entry) {
+		if ((*entry)->key == key)
+			break;
+
+		entry = &(*entry)->next;
+	}
+
+	return entry;
+}
+
+bool hash_insert(struct hash *hash, uint64_t key, void *value)
+{
+	struct hash_entry **entry, *new_entry;
+
+	if (!hash)
+		return false;
+
+	entry = find_entry(hash, key);
+	if (*entry) {
+		if (hash->destroy && (*entry)->value != value)
+			hash->destroy((*entry)->value);
+
+		(*entry)->value = value;
+		return true;
+	}
+
+	new_entry = malloc(sizeof(*new_entry));
+	if (!new_entry)
+		return false;
+
+	new_entry->key = key;
+	new_entry->value = value;
+	new_entry->next = NULL;
+	*entry = new_entry;
+
+	hash->count++;
+
+	if (hash->count > hash->num_buckets)
+		resize(hash, hash->num_buckets * 2);
+
+	return true;
+}
+
+void *hash_lookup(struct hash *hash, uint64_t key)
+{
+	struct hash_entry **entry;
+
+	if (!hash)
+		return NULL;
+
+	entry = find_entry(hash, key);
+	if (!*entry)
+		return NULL;
+
+	return (*entry)->value;
+}
+
+void *hash_steal(struct hash *hash, uint64_t key)
+{
+	struct hash_entry **entry, *old_entry;
+	void *value;
+
+	if (!hash)
+		return NULL;
+
+	entry = find_entry(hash, key);
+	if (!*entry)
+		return NULL;
+
+	old_entry = *entry;
+	value = old_entry->value;
+
+	*entry = old_entry->next;
+	free(old_entry);
+
+	hash->count--;
+
+	if (hash->num_buckets > MIN_BUCKETS &&
+				hash->count < hash->num_buckets / 4)
+		resize(hash, hash->num_buckets / 2);
+
+	return value;
+}
+
+bool hash_remove(struct hash *hash, uint64_t key)
+{
+	void *value;
+
+	if (!hash || !hash_lookup(hash, key))
+		return false;
+
+	value = hash_steal(hash, key);
+
+	if (hash->destroy)
+		hash->destroy(value);
+
+	return true;
+}
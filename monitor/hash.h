@@ -0,0 +1,38 @@
+/*
+ *
+ *  BlueZ - Bluetooth protocol stack for Linux
+ *
+ *  Copyright (C) 2013  Intel Corporation
+ *
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+
+#include <stdint.h>
+#include <stdbool.h>
+
+typedef void (*hash_destroy_func_t)(void *value);
+
+struct hash;
+
+struct hash *hash_new(hash_destroy_func_t destroy);
+void hash_free(struct hash *hash);
+
+bool hash_insert(struct hash *hash, uint64_t key, void *value);
+void *hash_lookup(struct hash *hash, uint64_t key);
+void *hash_steal(struct hash *hash, uint64_t key);
+bool hash_remove(struct hash *hash, uint64_t key);
@@ -28,6 +28,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <inttypes.h>
 
 #include <bluetooth/bluetooth.h>
@@ -37,11 +38,11 @@
 #include "display.h"
 #include "l2cap.h"
 #include "uuid.h"
+#include "hash.h"
 #include "sdp.h"
 
-#define MAX_CHAN 64
-
 struct chan_data {
+	uint16_t id;
 	uint16_t index;
 	uint16_t handle;
 	uint16_t scid;
@@ -51,222 +52,263 @@ struct chan_data {
 	uint8_t  mode;
 };
 
-static struct chan_data chan_list[MAX_CHAN];
+struct index_data {
+	uint16_t next_chan_id;
+};
 
-static void assign_scid(const struct l2cap_frame *frame,
-				uint16_t scid, uint16_t psm, uint8_t ctrlid)
+struct conn_data {
+	void *frag_buf;
+	uint16_t frag_pos;
+	uint16_t frag_len;
+	uint16_t frag_cid;
+};
+
+/* Handle used for the lookup keys of channels moved to an AMP controller */
+#define AMP_HANDLE	0xffff
+
+/*
+ * Channels are keyed by controller index, handle, direction and CID. A
+ * channel with both CIDs known is reachable through two keys, and a
+ * channel on an AMP controller is reachable through the AMP index too.
+ */
+static struct hash *chan_hash = NULL;
+static struct hash *index_hash = NULL;
+static struct hash *conn_hash = NULL;
+
+static inline uint64_t chan_key(uint16_t index, uint16_t handle,
+						bool dcid, uint16_t cid)
+{
+	return ((uint64_t) index << 33) | ((uint64_t) handle << 17) |
+					((uint64_t) dcid << 16) | cid;
+}
+
+static inline uint64_t conn_key(uint16_t index, bool in, uint16_t handle)
 {
-	int i, n = -1;
+	return ((uint64_t) index << 17) | ((uint64_t) in << 16) | handle;
+}
 
-	for (i = 0; i < MAX_CHAN; i++) {
-		if (n < 0 && chan_list[i].handle == 0x0000)
-			n = i;
+static void unlink_key(uint64_t key, struct chan_data *chan)
+{
+	if (hash_lookup(chan_hash, key) == chan)
+		hash_steal(chan_hash, key);
+}
 
-		if (chan_list[i].index != frame->index)
-			continue;
+static void unlink_cid(struct chan_data *chan, bool dcid, uint16_t cid)
+{
+	if (!cid)
+		return;
 
-		if (chan_list[i].handle != frame->handle)
-			continue;
+	unlink_key(chan_key(chan->index, chan->handle, dcid, cid), chan);
 
-		if (frame->in) {
-			if (chan_list[i].dcid == scid) {
-				n = i;
-				break;
-			}
-		} else {
-			if (chan_list[i].scid == scid) {
-				n = i;
-				break;
-			}
+	if (chan->ctrlid)
+		unlink_key(chan_key(chan->ctrlid, AMP_HANDLE, dcid, cid), chan);
+}
+
+static void unlink_chan(struct chan_data *chan)
+{
+	unlink_cid(chan, false, chan->scid);
+	unlink_cid(chan, true, chan->dcid);
+
+	free(chan);
+}
+
+static void link_key(uint64_t key, struct chan_data *chan)
+{
+	struct chan_data *old;
+
+	/* A channel that reused the key of a stale one replaces it */
+	old = hash_lookup(chan_hash, key);
+	if (old && old != chan)
+		unlink_chan(old);
+
+	hash_insert(chan_hash, key, chan);
+}
+
+static void link_cid(struct chan_data *chan, bool dcid, uint16_t cid)
+{
+	link_key(chan_key(chan->index, chan->handle, dcid, cid), chan);
+
+	if (chan->ctrlid)
+		link_key(chan_key(chan->ctrlid, AMP_HANDLE, dcid, cid), chan);
+}
+
+static struct chan_data *find_chan(const struct l2cap_frame *frame,
+						bool dcid, uint16_t cid)
+{
+	return hash_lookup(chan_hash, chan_key(frame->index, frame->handle,
+								dcid, cid));
+}
+
+static uint16_t alloc_chan_id(uint16_t index)
+{
+	struct index_data *index_data;
+
+	index_data = hash_lookup(index_hash, index);
+	if (!index_data) {
+		if (!index_hash)
+			index_hash = hash_new(free);
+
+		index_data = calloc(1, sizeof(*index_data));
+		if (!index_data)
+			return 0;
+
+		if (!hash_insert(index_hash, index, index_data)) {
+			free(index_data);
+			return 0;
 		}
 	}
 
-	if (n < 0)
+	return index_data->next_chan_id++;
+}
+
+static void assign_scid(const struct l2cap_frame *frame,
+				uint16_t scid, uint16_t psm, uint8_t ctrlid)
+{
+	struct chan_data *chan;
+
+	if (!chan_hash) {
+		chan_hash = hash_new(NULL);
+		if (!chan_hash)
+			return;
+	}
+
+	chan = find_chan(frame, frame->in, scid);
+	if (chan)
+		unlink_chan(chan);
+
+	chan = calloc(1, sizeof(*chan));
+	if (!chan)
 		return;
 
-	memset(&chan_list[n], 0, sizeof(chan_list[n]));
-	chan_list[n].index = frame->index;
-	chan_list[n].handle = frame->handle;
+	chan->id = alloc_chan_id(frame->index);
+	chan->index = frame->index;
+	chan->handle = frame->handle;
 
 	if (frame->in)
-		chan_list[n].dcid = scid;
+		chan->dcid = scid;
 	else
-		chan_list[n].scid = scid;
+		chan->scid = scid;
 
-	chan_list[n].psm = psm;
-	chan_list[n].ctrlid = ctrlid;
-	chan_list[n].mode = 0;
+	chan->psm = psm;
+	chan->ctrlid = ctrlid;
+	chan->mode = 0;
+
+	link_cid(chan, frame->in, scid);
 }
 
 static void release_scid(const struct l2cap_frame *frame, uint16_t scid)
 {
-	int i;
-
-	for (i = 0; i < MAX_CHAN; i++) {
-		if (chan_list[i].index != frame->index)
-			continue;
-
-		if (chan_list[i].handle != frame->handle)
-			continue;
+	struct chan_data *chan;
 
-		if (frame->in) {
-			if (chan_list[i].scid == scid) {
-				chan_list[i].handle = 0;
-				break;
-			}
-		} else {
-			if (chan_list[i].dcid == scid) {
-				chan_list[i].handle = 0;
-				break;
-			}
-		}
-	}
+	chan = find_chan(frame, !frame->in, scid);
+	if (chan)
+		unlink_chan(chan);
 }
 
 static void assign_dcid(const struct l2cap_frame *frame,
 					uint16_t dcid, uint16_t scid)
 {
-	int i;
+	struct chan_data *chan;
 
-	for (i = 0; i < MAX_CHAN; i++) {
-		if (chan_list[i].index != frame->index)
-			continue;
-
-		if (chan_list[i].handle != frame->handle)
-			continue;
+	chan = find_chan(frame, !frame->in, scid);
+	if (!chan)
+		return;
 
-		if (frame->in) {
-			if (chan_list[i].scid == scid) {
-				chan_list[i].dcid = dcid;
-				break;
-			}
-		} else {
-			if (chan_list[i].dcid == scid) {
-				chan_list[i].scid = dcid;
-				break;
-			}
-		}
+	if (frame->in) {
+		unlink_cid(chan, true, chan->dcid);
+		chan->dcid = dcid;
+		link_cid(chan, true, dcid);
+	} else {
+		unlink_cid(chan, false, chan->scid);
+		chan->scid = dcid;
+		link_cid(chan, false, dcid);
 	}
 }
 
 static void assign_mode(const struct l2cap_frame *frame,
 					uint8_t mode, uint16_t dcid)
 {
-	int i;
-
-	for (i = 0; i < MAX_CHAN; i++) {
-		if (chan_list[i].index != frame->index)
-			continue;
-
-		if (chan_list[i].handle != frame->handle)
-			continue;
+	struct chan_data *chan;
 
-		if (frame->in) {
-			if (chan_list[i].scid == dcid) {
-				chan_list[i].mode = mode;
-				break;
-			}
-		} else {
-			if (chan_list[i].dcid == dcid) {
-				chan_list[i].mode = mode;
-				break;
-			}
-		}
-	}
+	chan = find_chan(frame, !frame->in, dcid);
+	if (chan)
+		chan->mode = mode;
 }
 
-static uint16_t get_psm(const struct l2cap_frame *frame)
+static struct chan_data *get_frame_chan(const struct l2cap_frame *frame)
 {
-	int i;
+	struct chan_data *chan;
 
-	for (i = 0; i < MAX_CHAN; i++) {
-		if (chan_list[i].index != frame->index &&
-					chan_list[i].ctrlid == 0)
-			continue;
+	chan = find_chan(frame, !frame->in, frame->cid);
+	if (chan)
+		return chan;
 
-		if (chan_list[i].handle != frame->handle &&
-					chan_list[i].ctrlid != frame->index)
-			continue;
+	/* Channels moved to an AMP controller are owned by another index */
+	return hash_lookup(chan_hash, chan_key(frame->index, AMP_HANDLE,
+						!frame->in, frame->cid));
+}
 
-		if (frame->in) {
-			if (chan_list[i].scid == frame->cid)
-				return chan_list[i].psm;
-		} else {
-			if (chan_list[i].dcid == frame->cid)
-				return chan_list[i].psm;
-		}
-	}
+static uint16_t get_psm(const struct l2cap_frame *frame)
+{
+	struct chan_data *chan = get_frame_chan(frame);
 
-	return 0;
+	return chan ? chan->psm : 0;
 }
 
 static uint8_t get_mode(const struct l2cap_frame *frame)
 {
-	int i;
+	struct chan_data *chan = get_frame_chan(frame);
 
-	for (i = 0; i < MAX_CHAN; i++) {
-		if (chan_list[i].index != frame->index &&
-					chan_list[i].ctrlid == 0)
-			continue;
-
-		if (chan_list[i].handle != frame->handle &&
-					chan_list[i].ctrlid != frame->index)
-			continue;
+	return chan ? chan->mode : 0;
+}
 
-		if (frame->in) {
-			if (chan_list[i].scid == frame->cid)
-				return chan_list[i].mode;
-		} else {
-			if (chan_list[i].dcid == frame->cid)
-				return chan_list[i].mode;
-		}
-	}
+static uint16_t get_chan(const struct l2cap_frame *frame)
+{
+	struct chan_data *chan = get_frame_chan(frame);
 
-	return 0;
+	return chan ? chan->id : 0;
 }
 
-static uint16_t get_chan(const struct l2cap_frame *frame)
+static void conn_free(void *data)
 {
-	int i;
+	struct conn_data *conn = data;
 
-	for (i = 0; i < MAX_CHAN; i++) {
-		if (chan_list[i].index != frame->index &&
-					chan_list[i].ctrlid == 0)
-			continue;
+	free(conn->frag_buf);
+	free(conn);
+}
 
-		if (chan_list[i].handle != frame->handle &&
-					chan_list[i].ctrlid != frame->index)
-			continue;
+static struct conn_data *get_conn(uint16_t index, bool in, uint16_t handle)
+{
+	struct conn_data *conn;
 
-		if (frame->in) {
-			if (chan_list[i].scid == frame->cid)
-				return i;
-		} else {
-			if (chan_list[i].dcid == frame->cid)
-				return i;
-		}
-	}
+	conn = hash_lookup(conn_hash, conn_key(index, in, handle));
+	if (conn)
+		return conn;
 
-	return 0;
-}
+	if (!conn_hash) {
+		conn_hash = hash_new(conn_free);
+		if (!conn_hash)
+			return NULL;
+	}
 
-#define MAX_INDEX 16
+	conn = calloc(1, sizeof(*conn));
+	if (!conn)
+		return NULL;
 
-struct index_data {
-	void *frag_buf;
-	uint16_t frag_pos;
-	uint16_t frag_len;
-	uint16_t frag_cid;
-};
+	if (!hash_insert(conn_hash, conn_key(index, in, handle), conn)) {
+		free(conn);
+		return NULL;
+	}
 
-static struct index_data index_list[MAX_INDEX];
+	return conn;
+}
 
-static void clear_fragment_buffer(uint16_t index)
+static void clear_fragment_buffer(struct conn_data *conn)
 {
-	free(index_list[index].frag_buf);
-	index_list[index].frag_buf = NULL;
-	index_list[index].frag_pos = 0;
-	index_list[index].frag_len = 0;
+	free(conn->frag_buf);
+	conn->frag_buf = NULL;
+	conn->frag_pos = 0;
+	conn->frag_len = 0;
 }
 
 static void print_psm(uint16_t psm)
@@ -2566,10 +2608,12 @@ void l2cap_packet(uint16_t index, bool in, uint16_t handle, uint8_t flags,
 					const void *data, uint16_t size)
 {
 	const struct bt_l2cap_hdr *hdr = data;
+	struct conn_data *conn;
 	uint16_t len, cid;
 
-	if (index > MAX_INDEX - 1) {
-		print_text(COLOR_ERROR, "controller index too large");
+	conn = get_conn(index, in, handle);
+	if (!conn) {
+		print_text(COLOR_ERROR, "failed connection allocation");
 		packet_hexdump(data, size);
 		return;
 	}
@@ -2577,10 +2621,10 @@ void l2cap_packet(uint16_t index, bool in, uint16_t handle, uint8_t flags,
 	switch (flags) {
 	case 0x00:	/* start of a non-automatically-flushable PDU */
 	case 0x02:	/* start of an automatically-flushable PDU */
-		if (index_list[index].frag_len) {
+		if (conn->frag_len) {
 			print_text(COLOR_ERROR, "unexpected start frame");
 			packet_hexdump(data, size);
-			clear_fragment_buffer(index);
+			clear_fragment_buffer(conn);
 			return;
 		}
 
@@ -2608,54 +2652,51 @@ void l2cap_packet(uint16_t index, bool in, uint16_t handle, uint8_t flags,
 			return;
 		}
 
-		index_list[index].frag_buf = malloc(len);
-		if (!index_list[index].frag_buf) {
+		conn->frag_buf = malloc(len);
+		if (!conn->frag_buf) {
 			print_text(COLOR_ERROR, "failed buffer allocation");
 			packet_hexdump(data, size);
 			return;
 		}
 
-		memcpy(index_list[index].frag_buf, data, size);
-		index_list[index].frag_pos = size;
-		index_list[index].frag_len = len - size;
-		index_list[index].frag_cid = cid;
+		memcpy(conn->frag_buf, data, size);
+		conn->frag_pos = size;
+		conn->frag_len = len - size;
+		conn->frag_cid = cid;
 		break;
 
 	case 0x01:	/* continuing fragment */
-		if (!index_list[index].frag_len) {
+		if (!conn->frag_len) {
 			print_text(COLOR_ERROR, "unexpected continuation");
 			packet_hexdump(data, size);
 			return;
 		}
 
-		if (size > index_list[index].frag_len) {
+		if (size > conn->frag_len) {
 			print_text(COLOR_ERROR, "fragment too long");
 			packet_hexdump(data, size);
-			clear_fragment_buffer(index);
+			clear_fragment_buffer(conn);
 			return;
 		}
 
-		memcpy(index_list[index].frag_buf +
-				index_list[index].frag_pos, data, size);
-		index_list[index].frag_pos += size;
-		index_list[index].frag_len -= size;
+		memcpy(conn->frag_buf + conn->frag_pos, data, size);
+		conn->frag_pos += size;
+		conn->frag_len -= size;
 
-		if (!index_list[index].frag_len) {
+		if (!conn->frag_len) {
 			/* complete frame */
-			l2cap_frame(index, in, handle,
-					index_list[index].frag_cid,
-					index_list[index].frag_buf,
-					index_list[index].frag_pos);
-			clear_fragment_buffer(index);
+			l2cap_frame(index, in, handle, conn->frag_cid,
+					conn->frag_buf, conn->frag_pos);
+			clear_fragment_buffer(conn);
 			return;
 		}
 		break;
 
 	case 0x03:	/* complete automatically-flushable PDU */
-		if (index_list[index].frag_len) {
+		if (conn->frag_len) {
 			print_text(COLOR_ERROR, "unexpected complete frame");
 			packet_hexdump(data, size);
-			clear_fragment_buffer(index);
+			clear_fragment_buffer(conn);
 			return;
 		}
 
@@ -2688,3 +2729,9 @@ void l2cap_packet(uint16_t index, bool in, uint16_t handle, uint8_t flags,
 		return;
 	}
 }
+
+void l2cap_release_handle(uint16_t index, uint16_t handle)
+{
+	hash_remove(conn_hash, conn_key(index, false, handle));
+	hash_remove(conn_hash, conn_key(index, true, handle));
+}
@@ -59,3 +59,4 @@ static inline void l2cap_frame_pull(struct l2cap_frame *frame,
 
 void l2cap_packet(uint16_t index, bool in, uint16_t handle, uint8_t flags,
 					const void *data, uint16_t size);
+void l2cap_release_handle(uint16_t index, uint16_t handle);
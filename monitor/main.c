@@ -30,7 +30,9 @@
 #include <ctype.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdbool.h>
 #include <getopt.h>
+#include <sys/time.h>
 
 #include "mainloop.h"
 #include "packet.h"
@@ -53,6 +55,10 @@ static void usage(void)
 	printf("\tbtmon [options]\n");
 	printf("options:\n"
 		"\t-r, --read <file>      Read traces in btsnoop format\n"
+		"\t-B, --begin <seconds>  Start reading at time offset\n"
+		"\t-E, --end <seconds>    Stop reading at time offset\n"
+		"\t-I, --save-index       Keep seek index in <file>.idx\n"
+		"\t-j, --jobs <num>       Decode controllers in parallel\n"
 		"\t-w, --write <file>     Save traces in btsnoop format\n"
 		"\t-s, --server <socket>  Start monitor server socket\n"
 		"\t-i, --index <num>      Show only specified controller\n"
@@ -64,6 +70,10 @@ static void usage(void)
 
 static const struct option main_options[] = {
 	{ "read",    required_argument, NULL, 'r' },
+	{ "begin",   required_argument, NULL, 'B' },
+	{ "end",     required_argument, NULL, 'E' },
+	{ "save-index", no_argument,    NULL, 'I' },
+	{ "jobs",    required_argument, NULL, 'j' },
 	{ "write",   required_argument, NULL, 'w' },
 	{ "server",  required_argument, NULL, 's' },
 	{ "index",   required_argument, NULL, 'i' },
@@ -75,10 +85,29 @@ static const struct option main_options[] = {
 	{ }
 };
 
+static bool parse_offset(const char *str, struct timeval *tv)
+{
+	char *end;
+	double secs;
+
+	secs = strtod(str, &end);
+	if (end == str || *end != '\0' || secs < 0)
+		return false;
+
+	tv->tv_sec = secs;
+	tv->tv_usec = (secs - tv->tv_sec) * 1000000;
+
+	return true;
+}
+
 int main(int argc, char *argv[])
 {
 	unsigned long filter_mask = 0;
 	const char *str, *reader_path = NULL, *writer_path = NULL;
+	struct timeval begin, end;
+	bool have_begin = false, have_end = false, save_index = false;
+	unsigned int jobs = 1;
+	bool index_selected = false;
 	sigset_t mask;
 
 	mainloop_init();
@@ -88,7 +117,7 @@ int main(int argc, char *argv[])
 	for (;;) {
 		int opt;
 
-		opt = getopt_long(argc, argv, "r:w:s:i:tTSvh",
+		opt = getopt_long(argc, argv, "r:B:E:Ij:w:s:i:tTSvh",
 						main_options, NULL);
 		if (opt < 0)
 			break;
@@ -97,6 +126,26 @@ int main(int argc, char *argv[])
 		case 'r':
 			reader_path = optarg;
 			break;
+		case 'B':
+			if (!parse_offset(optarg, &begin)) {
+				usage();
+				return EXIT_FAILURE;
+			}
+			have_begin = true;
+			break;
+		case 'E':
+			if (!parse_offset(optarg, &end)) {
+				usage();
+				return EXIT_FAILURE;
+			}
+			have_end = true;
+			break;
+		case 'I':
+			save_index = true;
+			break;
+		case 'j':
+			jobs = atoi(optarg);
+			break;
 		case 'w':
 			writer_path = optarg;
 			break;
@@ -113,6 +162,7 @@ int main(int argc, char *argv[])
 				return EXIT_FAILURE;
 			}
 			packet_select_index(atoi(str));
+			index_selected = true;
 			break;
 		case 't':
 			filter_mask &= ~PACKET_FILTER_SHOW_TIME_OFFSET;
@@ -153,7 +203,15 @@ int main(int argc, char *argv[])
 	packet_set_filter(filter_mask);
 
 	if (reader_path) {
-		control_reader(reader_path);
+		/* A single controller is a single stream */
+		if (index_selected)
+			jobs = 1;
+
+		if (control_reader(reader_path, have_begin ? &begin : NULL,
+					have_end ? &end : NULL, save_index,
+					jobs) < 0)
+			return EXIT_FAILURE;
+
 		return EXIT_SUCCESS;
 	}
 
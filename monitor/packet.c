@@ -41,14 +41,16 @@
 #include <bluetooth/hci.h>
 #include <bluetooth/hci_lib.h>
 
+#include "src/shared/btsnoop.h"
+
 #include "display.h"
 #include "bt.h"
 #include "ll.h"
 #include "uuid.h"
 #include "l2cap.h"
 #include "control.h"
-#include "btsnoop.h"
 #include "vendor.h"
+#include "hash.h"
 #include "packet.h"
 
 #define COLOR_INDEX_LABEL		COLOR_WHITE
@@ -73,57 +75,65 @@
 
 #define COLOR_PHY_PACKET		COLOR_BLUE
 
+#ifndef NELEM
+#define NELEM(x) (sizeof(x) / sizeof((x)[0]))
+#endif
+
 static time_t time_offset = ((time_t) -1);
 static unsigned long filter_mask = 0;
 static bool index_filter = false;
 static uint16_t index_number = 0;
 static uint16_t index_current = 0;
 
-#define MAX_CONN 16
-
 struct conn_data {
 	uint16_t handle;
 	uint8_t  type;
 };
 
-static struct conn_data conn_list[MAX_CONN];
+/* Connections keyed by controller index and handle */
+static struct hash *conn_hash = NULL;
+
+static inline uint64_t conn_key(uint16_t index, uint16_t handle)
+{
+	return ((uint64_t) index << 16) | handle;
+}
 
 static void assign_handle(uint16_t handle, uint8_t type)
 {
-	int i;
+	struct conn_data *conn;
 
-	for (i = 0; i < MAX_CONN; i++) {
-		if (conn_list[i].handle == 0x0000) {
-			conn_list[i].handle = handle;
-			conn_list[i].type = type;
-			break;
-		}
+	if (!conn_hash) {
+		conn_hash = hash_new(free);
+		if (!conn_hash)
+			return;
 	}
+
+	conn = malloc(sizeof(*conn));
+	if (!conn)
+		return;
+
+	conn->handle = handle;
+	conn->type = type;
+
+	if (!hash_insert(conn_hash, conn_key(index_current, handle), conn))
+		free(conn);
 }
 
 static void release_handle(uint16_t handle)
 {
-	int i;
-
-	for (i = 0; i < MAX_CONN; i++) {
-		if (conn_list[i].handle == handle) {
-			conn_list[i].handle = 0x0000;
-			conn_list[i].type = 0x00;
-			break;
-		}
-	}
+	hash_remove(conn_hash, conn_key(index_current, handle));
+	l2cap_release_handle(index_current, handle);
 }
 
 static uint8_t get_type(uint16_t handle)
 {
-	int i;
+	struct conn_data *conn;
 
-	for (i = 0; i < MAX_CONN; i++) {
-		if (conn_list[i].handle == handle)
-			return conn_list[i].type;
-	}
+	conn = hash_lookup(conn_hash, conn_key(index_current, handle));
+	if (!conn)
+		return 0xff;
 
-	return 0xff;
+	return conn->type;
 }
 
 void packet_set_filter(unsigned long filter)
@@ -152,6 +162,11 @@ void packet_select_index(uint16_t index)
 	index_number = index;
 }
 
+void packet_set_time_offset(const struct timeval *tv)
+{
+	time_offset = tv->tv_sec;
+}
+
 #define print_space(x) printf("%*c", (x), ' ');
 
 static void print_packet(struct timeval *tv, uint16_t index, char ident,
@@ -2610,19 +2625,19 @@ struct monitor_new_index {
 
 #define MONITOR_DEL_INDEX_SIZE 0
 
-#define MAX_INDEX 16
-
 struct index_data {
 	uint8_t  type;
 	bdaddr_t bdaddr;
 };
 
-static struct index_data index_list[MAX_INDEX];
+/* Controllers keyed by index */
+static struct hash *index_hash = NULL;
 
 void packet_monitor(struct timeval *tv, uint16_t index, uint16_t opcode,
 					const void *data, uint16_t size)
 {
 	const struct monitor_new_index *ni;
+	struct index_data *index_data;
 	char str[18], extra_str[24];
 
 	if (index_filter && index_number != index)
@@ -2637,20 +2652,30 @@ void packet_monitor(struct timeval *tv, uint16_t index, uint16_t opcode,
 	case BTSNOOP_OPCODE_NEW_INDEX:
 		ni = data;
 
-		if (index < MAX_INDEX) {
-			index_list[index].type = ni->type;
-			bacpy(&index_list[index].bdaddr, &ni->bdaddr);
+		if (!index_hash)
+			index_hash = hash_new(free);
+
+		index_data = malloc(sizeof(*index_data));
+		if (index_data) {
+			index_data->type = ni->type;
+			bacpy(&index_data->bdaddr, &ni->bdaddr);
+
+			if (!hash_insert(index_hash, index, index_data))
+				free(index_data);
 		}
 
 		ba2str(&ni->bdaddr, str);
 		packet_new_index(tv, index, str, ni->type, ni->bus, ni->name);
 		break;
 	case BTSNOOP_OPCODE_DEL_INDEX:
-		if (index < MAX_INDEX)
-			ba2str(&index_list[index].bdaddr, str);
+		index_data = hash_steal(index_hash, index);
+		if (index_data)
+			ba2str(&index_data->bdaddr, str);
 		else
 			ba2str(BDADDR_ANY, str);
 
+		free(index_data);
+
 		packet_del_index(tv, index, str);
 		break;
 	case BTSNOOP_OPCODE_COMMAND_PKT:
@@ -3927,11 +3952,14 @@ static void read_sync_train_params_rsp(const void *data, uint8_t size)
 static void read_local_version_rsp(const void *data, uint8_t size)
 {
 	const struct bt_hci_rsp_read_local_version *rsp = data;
+	struct index_data *index_data;
 
 	print_status(rsp->status);
 	print_hci_version(rsp->hci_ver, rsp->hci_rev);
 
-	switch (index_list[index_current].type) {
+	index_data = hash_lookup(index_hash, index_current);
+
+	switch (index_data ? index_data->type : HCI_BREDR) {
 	case HCI_BREDR:
 		print_lmp_version(rsp->lmp_ver, rsp->lmp_subver);
 		break;
@@ -4673,6 +4701,7 @@ struct opcode_data {
 	bool rsp_fixed;
 };
 
+/* Sorted by opcode, since lookups use a binary search */
 static const struct opcode_data opcode_table[] = {
 	{ 0x0000,  -1, "NOP" },
 
@@ -5221,6 +5250,20 @@ static const struct opcode_data opcode_table[] = {
 	{ }
 };
 
+static int opcode_cmp(const void *key, const void *entry)
+{
+	const struct opcode_data *data = entry;
+
+	return *((const uint16_t *) key) - data->opcode;
+}
+
+static const struct opcode_data *find_opcode(uint16_t opcode)
+{
+	/* The terminating empty entry is not part of the search */
+	return bsearch(&opcode, opcode_table, NELEM(opcode_table) - 1,
+					sizeof(opcode_table[0]), opcode_cmp);
+}
+
 static const char *get_supported_command(int bit)
 {
 	int i;
@@ -5377,14 +5420,8 @@ static void cmd_complete_evt(const void *data, uint8_t size)
 	uint16_t ocf = cmd_opcode_ocf(opcode);
 	const struct opcode_data *opcode_data = NULL;
 	const char *opcode_color, *opcode_str;
-	int i;
 
-	for (i = 0; opcode_table[i].str; i++) {
-		if (opcode_table[i].opcode == opcode) {
-			opcode_data = &opcode_table[i];
-			break;
-		}
-	}
+	opcode_data = find_opcode(opcode);
 
 	if (opcode_data) {
 		if (opcode_data->rsp_func)
@@ -5430,14 +5467,8 @@ static void cmd_status_evt(const void *data, uint8_t size)
 	uint16_t ocf = cmd_opcode_ocf(opcode);
 	const struct opcode_data *opcode_data = NULL;
 	const char *opcode_color, *opcode_str;
-	int i;
 
-	for (i = 0; opcode_table[i].str; i++) {
-		if (opcode_table[i].opcode == opcode) {
-			opcode_data = &opcode_table[i];
-			break;
-		}
-	}
+	opcode_data = find_opcode(opcode);
 
 	if (opcode_data) {
 		opcode_color = COLOR_HCI_COMMAND;
@@ -6027,6 +6058,7 @@ struct subevent_data {
 	bool fixed;
 };
 
+/* Sorted by subevent, since lookups use a binary search */
 static const struct subevent_data subevent_table[] = {
 	{ 0x01, "LE Connection Complete",
 				le_conn_complete_evt, 18, true },
@@ -6041,19 +6073,27 @@ static const struct subevent_data subevent_table[] = {
 	{ }
 };
 
+static int subevent_cmp(const void *key, const void *entry)
+{
+	const struct subevent_data *data = entry;
+
+	return *((const uint8_t *) key) - data->subevent;
+}
+
+static const struct subevent_data *find_subevent(uint8_t subevent)
+{
+	return bsearch(&subevent, subevent_table,
+				NELEM(subevent_table) - 1,
+				sizeof(subevent_table[0]), subevent_cmp);
+}
+
 static void le_meta_event_evt(const void *data, uint8_t size)
 {
 	uint8_t subevent = *((const uint8_t *) data);
 	const struct subevent_data *subevent_data = NULL;
 	const char *subevent_color, *subevent_str;
-	int i;
 
-	for (i = 0; subevent_table[i].str; i++) {
-		if (subevent_table[i].subevent == subevent) {
-			subevent_data = &subevent_table[i];
-			break;
-		}
-	}
+	subevent_data = find_subevent(subevent);
 
 	if (subevent_data) {
 		if (subevent_data->func)
@@ -6104,6 +6144,7 @@ struct event_data {
 	bool fixed;
 };
 
+/* Sorted by event code, since lookups use a binary search */
 static const struct event_data event_table[] = {
 	{ 0x01, "Inquiry Complete",
 				status_evt, 1, true },
@@ -6267,7 +6308,6 @@ void packet_hci_command(struct timeval *tv, uint16_t index,
 	const struct opcode_data *opcode_data = NULL;
 	const char *opcode_color, *opcode_str;
 	char extra_str[25];
-	int i;
 
 	if (size < HCI_COMMAND_HDR_SIZE) {
 		sprintf(extra_str, "(len %d)", size);
@@ -6280,12 +6320,7 @@ void packet_hci_command(struct timeval *tv, uint16_t index,
 	data += HCI_COMMAND_HDR_SIZE;
 	size -= HCI_COMMAND_HDR_SIZE;
 
-	for (i = 0; opcode_table[i].str; i++) {
-		if (opcode_table[i].opcode == opcode) {
-			opcode_data = &opcode_table[i];
-			break;
-		}
-	}
+	opcode_data = find_opcode(opcode);
 
 	if (opcode_data) {
 		if (opcode_data->cmd_func)
@@ -6325,6 +6360,19 @@ void packet_hci_command(struct timeval *tv, uint16_t index,
 	opcode_data->cmd_func(data, hdr->plen);
 }
 
+static int event_cmp(const void *key, const void *entry)
+{
+	const struct event_data *data = entry;
+
+	return *((const uint8_t *) key) - data->event;
+}
+
+static const struct event_data *find_event(uint8_t event)
+{
+	return bsearch(&event, event_table, NELEM(event_table) - 1,
+					sizeof(event_table[0]), event_cmp);
+}
+
 void packet_hci_event(struct timeval *tv, uint16_t index,
 					const void *data, uint16_t size)
 {
@@ -6332,7 +6380,6 @@ void packet_hci_event(struct timeval *tv, uint16_t index,
 	const struct event_data *event_data = NULL;
 	const char *event_color, *event_str;
 	char extra_str[25];
-	int i;
 
 	if (size < HCI_EVENT_HDR_SIZE) {
 		sprintf(extra_str, "(len %d)", size);
@@ -6345,12 +6392,7 @@ void packet_hci_event(struct timeval *tv, uint16_t index,
 	data += HCI_EVENT_HDR_SIZE;
 	size -= HCI_EVENT_HDR_SIZE;
 
-	for (i = 0; event_table[i].str; i++) {
-		if (event_table[i].event == hdr->evt) {
-			event_data = &event_table[i];
-			break;
-		}
-	}
+	event_data = find_event(hdr->evt);
 
 	if (event_data) {
 		if (event_data->func)
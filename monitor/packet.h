@@ -38,6 +38,7 @@ void packet_add_filter(unsigned long filter);
 void packet_del_filter(unsigned long filter);
 
 void packet_select_index(uint16_t index);
+void packet_set_time_offset(const struct timeval *tv);
 
 void packet_hexdump(const unsigned char *buf, uint16_t len);
 void packet_print_version(const char *label, uint8_t version,
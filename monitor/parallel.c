@@ -0,0 +1,369 @@
+/*
+ *
+ *  BlueZ - Bluetooth protocol stack for Linux
+ *
+ *  Copyright (C) 2013  Intel Corporation
+ *
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <errno.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#include "src/shared/btsnoop.h"
+
+#include "display.h"
+#include "packet.h"
+#include "parallel.h"
+
+#define MAX_WORKERS	32
+#define MAX_STREAMS	65536
+#define NO_WORKER	0xff
+
+#define NEW_INDEX_TYPE_AMP	0x01
+
+/*
+ * Each worker is a forked copy of the decoder, so the per-controller
+ * state in packet.c, l2cap.c and sdp.c is private to it. Workers only
+ * decode the controllers assigned to them and record where the output
+ * of every record ends, so the parent can splice the rendered text
+ * back together in the original record order.
+ */
+struct worker {
+	pid_t pid;
+	FILE *out;
+	FILE *ends;
+	const char *map;
+	size_t size;
+	size_t pos;
+};
+
+static bool read_record(struct btsnoop *btsnoop, const struct timeval *limit,
+				struct timeval *tv, uint16_t *index,
+				uint16_t *opcode, const void **data,
+				uint16_t *size)
+{
+	if (!btsnoop_read_hci(btsnoop, tv, index, opcode, data, size))
+		return false;
+
+	if (limit && timercmp(tv, limit, >))
+		return false;
+
+	return true;
+}
+
+static unsigned int assign_streams(struct btsnoop *btsnoop,
+					unsigned int jobs,
+					const struct timeval *limit,
+					uint8_t *assign, struct timeval *first)
+{
+	unsigned int num_workers = 0, next = 0;
+	bool have_first = false;
+	struct timeval tv;
+	const void *data;
+	uint16_t index, opcode, size;
+
+	memset(assign, NO_WORKER, MAX_STREAMS);
+
+	while (read_record(btsnoop, limit, &tv, &index, &opcode,
+							&data, &size)) {
+		if (!have_first) {
+			*first = tv;
+			have_first = true;
+		}
+
+		/*
+		 * Frames on an AMP controller refer to channels set up on
+		 * another controller, so the streams are not independent.
+		 */
+		if (opcode == BTSNOOP_OPCODE_NEW_INDEX && size > 0 &&
+			((const uint8_t *) data)[0] == NEW_INDEX_TYPE_AMP)
+			return 0;
+
+		if (assign[index] != NO_WORKER)
+			continue;
+
+		assign[index] = next;
+		next = (next + 1) % jobs;
+
+		if (num_workers < jobs)
+			num_workers++;
+	}
+
+	return num_workers;
+}
+
+static void run_worker(struct btsnoop *btsnoop, const uint8_t *assign,
+				uint8_t id, const struct timeval *limit,
+				struct worker *worker)
+{
+	struct timeval tv;
+	const void *data;
+	uint16_t index, opcode, size;
+
+	if (dup2(fileno(worker->out), STDOUT_FILENO) < 0)
+		_exit(EXIT_FAILURE);
+
+	while (read_record(btsnoop, limit, &tv, &index, &opcode,
+							&data, &size)) {
+		long offset;
+
+		if (assign[index] != id)
+			continue;
+
+		packet_monitor(&tv, index, opcode, data, size);
+
+		offset = ftell(stdout);
+		if (offset < 0)
+			_exit(EXIT_FAILURE);
+
+		if (fwrite(&offset, sizeof(offset), 1, worker->ends) != 1)
+			_exit(EXIT_FAILURE);
+	}
+
+	if (fflush(stdout) || fflush(worker->ends))
+		_exit(EXIT_FAILURE);
+
+	_exit(EXIT_SUCCESS);
+}
+
+static bool wait_worker(struct worker *worker)
+{
+	int status;
+
+	while (waitpid(worker->pid, &status, 0) < 0) {
+		if (errno != EINTR)
+			return false;
+	}
+
+	worker->pid = 0;
+
+	return WIFEXITED(status) && WEXITSTATUS(status) == EXIT_SUCCESS;
+}
+
+static bool map_worker(struct worker *worker)
+{
+	struct stat st;
+	void *map;
+
+	if (fstat(fileno(worker->out), &st) < 0)
+		return false;
+
+	rewind(worker->ends);
+
+	worker->size = st.st_size;
+	worker->pos = 0;
+
+	if (!worker->size)
+		return true;
+
+	map = mmap(NULL, worker->size, PROT_READ, MAP_SHARED,
+						fileno(worker->out), 0);
+	if (map == MAP_FAILED)
+		return false;
+
+	worker->map = map;
+
+	return true;
+}
+
+/*
+ * The output of the workers is checked against the trace before any of
+ * it is written, so a failure leaves nothing on stdout and the caller
+ * can still fall back to the serial decoder.
+ */
+static bool merge_output(struct btsnoop *btsnoop, uint32_t start,
+				const uint8_t *assign,
+				const struct timeval *limit,
+				struct worker *workers, unsigned int num_workers,
+				bool check)
+{
+	struct timeval tv;
+	const void *data;
+	uint16_t index, opcode, size;
+	unsigned int i;
+
+	if (!btsnoop_seek(btsnoop, start))
+		return false;
+
+	for (i = 0; i < num_workers; i++) {
+		rewind(workers[i].ends);
+		workers[i].pos = 0;
+	}
+
+	while (read_record(btsnoop, limit, &tv, &index, &opcode,
+							&data, &size)) {
+		struct worker *worker = &workers[assign[index]];
+		long offset;
+
+		if (fread(&offset, sizeof(offset), 1, worker->ends) != 1)
+			return false;
+
+		if (offset < (long) worker->pos ||
+					(size_t) offset > worker->size)
+			return false;
+
+		if (!check && offset > (long) worker->pos &&
+				fwrite(worker->map + worker->pos,
+					offset - worker->pos, 1, stdout) != 1)
+			return false;
+
+		worker->pos = offset;
+	}
+
+	for (i = 0; i < num_workers; i++) {
+		if (workers[i].pos != workers[i].size)
+			return false;
+	}
+
+	return true;
+}
+
+static void free_worker(struct worker *worker)
+{
+	if (worker->pid > 0) {
+		kill(worker->pid, SIGTERM);
+		wait_worker(worker);
+	}
+
+	if (worker->map)
+		munmap((void *) worker->map, worker->size);
+
+	if (worker->out)
+		fclose(worker->out);
+
+	if (worker->ends)
+		fclose(worker->ends);
+}
+
+/*
+ * Returns 1 when the trace has been decoded, 0 when it has to be decoded
+ * serially and a negative error when decoding failed after some of the
+ * output was written.
+ */
+int parallel_reader(struct btsnoop *btsnoop, unsigned int jobs,
+						const struct timeval *limit)
+{
+	struct worker workers[MAX_WORKERS];
+	struct timeval first;
+	unsigned int num_workers, i;
+	uint8_t *assign;
+	uint32_t start;
+	int result = 0;
+
+	if (jobs < 2)
+		return 0;
+
+	if (jobs > MAX_WORKERS)
+		jobs = MAX_WORKERS;
+
+	assign = malloc(MAX_STREAMS);
+	if (!assign)
+		return 0;
+
+	start = btsnoop_tell(btsnoop);
+
+	/* A pipe can't be rewound after assigning the controllers */
+	if (!btsnoop_seek(btsnoop, start)) {
+		free(assign);
+		return 0;
+	}
+
+	num_workers = assign_streams(btsnoop, jobs, limit, assign, &first);
+
+	if (!btsnoop_seek(btsnoop, start) || num_workers < 2) {
+		free(assign);
+		return 0;
+	}
+
+	/* Match the serial decoder, which starts the clock at this record */
+	if (start == 0)
+		packet_set_time_offset(&first);
+
+	/* Settle terminal properties before stdout gets redirected */
+	use_color();
+	num_columns();
+
+	fflush(stdout);
+
+	memset(workers, 0, sizeof(workers));
+
+	for (i = 0; i < num_workers; i++) {
+		workers[i].out = tmpfile();
+		workers[i].ends = tmpfile();
+
+		if (!workers[i].out || !workers[i].ends)
+			goto done;
+	}
+
+	for (i = 0; i < num_workers; i++) {
+		workers[i].pid = fork();
+		if (workers[i].pid < 0) {
+			workers[i].pid = 0;
+			goto done;
+		}
+
+		if (workers[i].pid == 0)
+			run_worker(btsnoop, assign, i, limit, &workers[i]);
+	}
+
+	for (i = 0; i < num_workers; i++) {
+		if (!wait_worker(&workers[i]))
+			goto done;
+	}
+
+	for (i = 0; i < num_workers; i++) {
+		if (!map_worker(&workers[i]))
+			goto done;
+	}
+
+	if (!merge_output(btsnoop, start, assign, limit, workers,
+							num_workers, true)) {
+		fprintf(stderr, "Parallel decoding failed, "
+						"decoding serially\n");
+		goto done;
+	}
+
+	if (!merge_output(btsnoop, start, assign, limit, workers,
+							num_workers, false))
+		result = -EIO;
+	else
+		result = 1;
+
+done:
+	for (i = 0; i < num_workers; i++)
+		free_worker(&workers[i]);
+
+	if (result == 0)
+		btsnoop_seek(btsnoop, start);
+
+	free(assign);
+
+	return result;
+}
@@ -38,48 +38,60 @@
 #include "display.h"
 #include "l2cap.h"
 #include "uuid.h"
+#include "hash.h"
 #include "sdp.h"
 
-#define MAX_TID 16
-
 struct tid_data {
-	bool inuse;
+	uint16_t index;
 	uint16_t tid;
 	uint16_t channel;
 	uint8_t cont[17];
 };
 
-static struct tid_data tid_list[MAX_TID];
+/* Transactions keyed by controller index, channel and transaction id */
+static struct hash *tid_hash = NULL;
 
-static struct tid_data *get_tid(uint16_t tid, uint16_t channel)
+static inline uint64_t tid_key(uint16_t index, uint16_t channel,
+								uint16_t tid)
 {
-	int i, n = -1;
+	return ((uint64_t) index << 32) | ((uint64_t) channel << 16) | tid;
+}
 
-	for (i = 0; i < MAX_TID; i++) {
-		if (!tid_list[i].inuse) {
-			if (n < 0)
-				n = i;
-			continue;
-		}
+static struct tid_data *get_tid(uint16_t index, uint16_t tid, uint16_t channel)
+{
+	struct tid_data *tid_data;
+
+	tid_data = hash_lookup(tid_hash, tid_key(index, channel, tid));
+	if (tid_data)
+		return tid_data;
 
-		if (tid_list[i].tid == tid && tid_list[i].channel == channel)
-			return &tid_list[i];
+	if (!tid_hash) {
+		tid_hash = hash_new(free);
+		if (!tid_hash)
+			return NULL;
 	}
 
-	if (n < 0)
+	tid_data = calloc(1, sizeof(*tid_data));
+	if (!tid_data)
 		return NULL;
 
-	tid_list[n].inuse = true;
-	tid_list[n].tid = tid;
-	tid_list[n].channel = channel;
+	tid_data->index = index;
+	tid_data->tid = tid;
+	tid_data->channel = channel;
+
+	if (!hash_insert(tid_hash, tid_key(index, channel, tid), tid_data)) {
+		free(tid_data);
+		return NULL;
+	}
 
-	return &tid_list[n];
+	return tid_data;
 }
 
 static void clear_tid(struct tid_data *tid)
 {
 	if (tid)
-		tid->inuse = false;
+		hash_remove(tid_hash, tid_key(tid->index, tid->channel,
+								tid->tid));
 }
 
 static void print_uint(uint8_t indent, const uint8_t *data, uint32_t size)
@@ -413,22 +425,87 @@ static void store_continuation(struct tid_data *tid,
 	print_continuation(data, size);
 }
 
-#define MAX_CONT 8
-
 struct cont_data {
-	uint16_t channel;
 	uint8_t cont[17];
 	void *data;
 	uint32_t size;
+	struct cont_data *next;
 };
 
-static struct cont_data cont_list[MAX_CONT];
+/* Pending continuations, listed per controller index and channel */
+static struct hash *cont_hash = NULL;
+
+static inline uint64_t cont_key(const struct tid_data *tid)
+{
+	return ((uint64_t) tid->index << 16) | tid->channel;
+}
+
+static void free_cont(struct cont_data *cont)
+{
+	free(cont->data);
+	free(cont);
+}
+
+static struct cont_data *get_cont(const struct tid_data *tid)
+{
+	struct cont_data *cont;
+
+	for (cont = hash_lookup(cont_hash, cont_key(tid)); cont;
+							cont = cont->next) {
+		if (cont->cont[0] != tid->cont[0])
+			continue;
+
+		if (!memcmp(cont->cont + 1, tid->cont + 1, tid->cont[0]))
+			return cont;
+	}
+
+	if (!cont_hash) {
+		cont_hash = hash_new(NULL);
+		if (!cont_hash)
+			return NULL;
+	}
+
+	cont = calloc(1, sizeof(*cont));
+	if (!cont)
+		return NULL;
+
+	cont->next = hash_lookup(cont_hash, cont_key(tid));
+
+	if (!hash_insert(cont_hash, cont_key(tid), cont)) {
+		free(cont);
+		return NULL;
+	}
+
+	return cont;
+}
+
+static void release_cont(const struct tid_data *tid, struct cont_data *cont)
+{
+	struct cont_data *prev;
+
+	prev = hash_lookup(cont_hash, cont_key(tid));
+
+	if (prev == cont) {
+		if (cont->next)
+			hash_insert(cont_hash, cont_key(tid), cont->next);
+		else
+			hash_remove(cont_hash, cont_key(tid));
+	} else {
+		while (prev && prev->next != cont)
+			prev = prev->next;
+
+		if (prev)
+			prev->next = cont->next;
+	}
+
+	free_cont(cont);
+}
 
 static void handle_continuation(struct tid_data *tid, bool nested,
 			uint16_t bytes, const uint8_t *data, uint16_t size)
 {
+	struct cont_data *cont;
 	uint8_t *newdata;
-	int i, n = -1;
 
 	if (bytes + 1 > size) {
 		print_text(COLOR_ERROR, "missing continuation state");
@@ -443,59 +520,35 @@ static void handle_continuation(struct tid_data *tid, bool nested,
 		return;
 	}
 
-	for (i = 0; i < MAX_CONT; i++) {
-		if (cont_list[i].cont[0] == 0x00) {
-			if (n < 0)
-				n = i;
-			continue;
-		}
-
-		if (cont_list[i].channel != tid->channel)
-			continue;
-
-		if (cont_list[i].cont[0] != tid->cont[0])
-			continue;
-
-		if (!memcmp(cont_list[i].cont + 1,
-					tid->cont + 1, tid->cont[0])) {
-			n = i;
-			break;
-		}
-	}
-
 	print_continuation(data + bytes, size - bytes);
 
-	if (n < 0)
+	cont = get_cont(tid);
+	if (!cont)
 		return;
 
-	newdata = realloc(cont_list[n].data, cont_list[n].size + bytes);
+	newdata = realloc(cont->data, cont->size + bytes);
 	if (!newdata) {
 		print_text(COLOR_ERROR, "failed buffer allocation");
-		free(cont_list[n].data);
-		cont_list[n].data = NULL;
-		cont_list[n].size = 0;
+		release_cont(tid, cont);
 		return;
 	}
 
-	cont_list[n].channel = tid->channel;
-	cont_list[n].data = newdata;
+	cont->data = newdata;
 
 	if (bytes > 0) {
-		memcpy(cont_list[n].data + cont_list[n].size, data, bytes);
-		cont_list[n].size += bytes;
+		memcpy(cont->data + cont->size, data, bytes);
+		cont->size += bytes;
 	}
 
 	if (data[bytes] == 0x00) {
-		print_field("Combined attribute bytes: %d", cont_list[n].size);
+		print_field("Combined attribute bytes: %d", cont->size);
 
-		decode_data_elements(0, 2, cont_list[n].data, cont_list[n].size,
+		decode_data_elements(0, 2, cont->data, cont->size,
 				nested ? print_attr_lists : print_attr_list);
 
-		free(cont_list[n].data);
-		cont_list[n].data = NULL;
-		cont_list[n].size = 0;
+		release_cont(tid, cont);
 	} else
-		memcpy(cont_list[i].cont, data + bytes, data[bytes] + 1);
+		memcpy(cont->cont, data + bytes, data[bytes] + 1);
 }
 
 static uint16_t common_rsp(const struct l2cap_frame *frame,
@@ -741,7 +794,7 @@ void sdp_packet(const struct l2cap_frame *frame, uint16_t channel)
 		return;
 	}
 
-	tid_info = get_tid(tid, channel);
+	tid_info = get_tid(frame->index, tid, channel);
 
 	l2cap_frame_pull(&sdp_frame, frame, 5);
 	sdp_data->func(&sdp_frame, tid_info);
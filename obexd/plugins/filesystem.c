@@ -36,6 +36,10 @@
 #include <sys/stat.h>
 #include <sys/statvfs.h>
 #include <sys/sendfile.h>
+#include <sys/inotify.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/fs.h>
 #include <fcntl.h>
 #include <wait.h>
 #include <inttypes.h>
@@ -253,51 +257,148 @@ static ssize_t filesystem_write(void *object, const void *buf, size_t count)
 	return ret;
 }
 
-static int filesystem_rename(const char *name, const char *destname)
+/* Bytes copied per main loop iteration */
+#define COPY_CHUNK_SIZE (1024 * 1024)
+
+struct copy_job {
+	int in_fd;
+	int out_fd;
+	char *source;
+	char *destname;
+	gboolean move;		/* remove the source once copied */
+	gboolean use_sendfile;
+	off_t size;
+	off_t offset;
+	guint id;
+	obex_action_complete_func func;
+	void *user_data;
+};
+
+static GSList *copy_jobs = NULL;
+
+static void copy_job_free(struct copy_job *job, int err)
 {
-	int ret;
+	obex_action_complete_func func = job->func;
+	void *user_data = job->user_data;
 
-	ret = rename(name, destname);
-	if (ret < 0) {
-		error("rename(%s, %s): %s (%d)", name, destname,
-						strerror(errno), errno);
-		return -errno;
+	copy_jobs = g_slist_remove(copy_jobs, job);
+
+	if (job->id > 0)
+		g_source_remove(job->id);
+
+	close(job->in_fd);
+	close(job->out_fd);
+
+	g_free(job->source);
+	g_free(job->destname);
+	g_free(job);
+
+	if (func)
+		func(err, user_data);
+}
+
+static void copy_job_finish(struct copy_job *job)
+{
+	if (job->move && unlink(job->source) < 0)
+		error("unlink(%s): %s (%d)", job->source, strerror(errno),
+									errno);
+
+	copy_job_free(job, 0);
+}
+
+static void copy_job_abort(struct copy_job *job, int err)
+{
+	/* Don't leave truncated files behind */
+	if (unlink(job->destname) < 0)
+		error("unlink(%s): %s (%d)", job->destname, strerror(errno),
+									errno);
+
+	copy_job_free(job, err);
+}
+
+static ssize_t copy_chunk(struct copy_job *job, size_t count)
+{
+	ssize_t ret;
+
+#ifdef __NR_copy_file_range
+	if (!job->use_sendfile) {
+		ret = syscall(__NR_copy_file_range, job->in_fd, NULL,
+					job->out_fd, NULL, count, 0);
+		if (ret >= 0)
+			return ret;
+
+		/* Not supported by the kernel or across these filesystems */
+		if (errno != ENOSYS && errno != EXDEV && errno != EINVAL &&
+							errno != EOPNOTSUPP)
+			return -errno;
+
+		job->use_sendfile = TRUE;
 	}
+#endif
+
+	ret = sendfile(job->out_fd, job->in_fd, NULL, count);
+	if (ret < 0)
+		return -errno;
 
 	return ret;
 }
 
-static int sendfile_async(int out_fd, int in_fd, off_t *offset, size_t count)
+/* Returns 1 while there is more to copy, 0 once done and -errno on failure */
+static int copy_job_next(struct copy_job *job)
 {
-	int pid;
+	ssize_t ret;
 
-	/* Run sendfile on child process */
-	pid = fork();
-	switch (pid) {
-		case 0:
-			break;
-		case -1:
-			error("fork() %s (%d)", strerror(errno), errno);
-			return -errno;
-		default:
-			DBG("child %d forked", pid);
-			return pid;
+	ret = copy_chunk(job, MIN(job->size - job->offset, COPY_CHUNK_SIZE));
+	if (ret == -EINTR || ret == -EAGAIN)
+		return 1;
+
+	if (ret < 0) {
+		error("copy(%s, %s): %s (%zd)", job->source, job->destname,
+							strerror(-ret), -ret);
+		return ret;
 	}
 
-	/* At child */
-	if (sendfile(out_fd, in_fd, offset, count) < 0)
-		error("sendfile(): %s (%d)", strerror(errno), errno);
+	/* The source was truncated while being copied */
+	if (ret == 0) {
+		error("copy(%s, %s): source ended at %" PRIu64 " of %" PRIu64
+				" bytes", job->source, job->destname,
+				(uint64_t) job->offset, (uint64_t) job->size);
+		return -EIO;
+	}
 
-	close(in_fd);
-	close(out_fd);
+	job->offset += ret;
 
-	exit(errno);
+	DBG("%s: %" PRIu64 "/%" PRIu64 " bytes", job->destname,
+				(uint64_t) job->offset, (uint64_t) job->size);
+
+	return job->offset < job->size;
 }
 
-static int filesystem_copy(const char *name, const char *destname)
+static gboolean copy_job_step(gpointer user_data)
 {
+	struct copy_job *job = user_data;
+	int err;
+
+	err = copy_job_next(job);
+	if (err > 0)
+		return TRUE;
+
+	job->id = 0;
+
+	if (err < 0)
+		copy_job_abort(job, err);
+	else
+		copy_job_finish(job);
+
+	return FALSE;
+}
+
+static int copy_start(const char *name, const char *destname,
+			gboolean move, obex_action_complete_func func,
+			void *user_data)
+{
+	struct copy_job *job;
 	void *in, *out;
-	ssize_t ret;
 	size_t size;
 	struct stat st;
 	int in_fd, out_fd, err;
@@ -305,14 +406,20 @@ static int filesystem_copy(const char *name, const char *destname)
 	in = filesystem_open(name, O_RDONLY, 0, NULL, &size, &err);
 	if (in == NULL) {
 		error("open(%s): %s (%d)", name, strerror(-err), -err);
-		return -err;
+		return err;
 	}
 
 	in_fd = GPOINTER_TO_INT(in);
-	ret = fstat(in_fd, &st);
-	if (ret < 0) {
-		error("stat(%s): %s (%d)", name, strerror(errno), errno);
-		return -errno;
+	if (fstat(in_fd, &st) < 0) {
+		err = -errno;
+		error("stat(%s): %s (%d)", name, strerror(-err), -err);
+		filesystem_close(in);
+		return err;
+	}
+
+	if (S_ISDIR(st.st_mode)) {
+		filesystem_close(in);
+		return -EISDIR;
 	}
 
 	out = filesystem_open(destname, O_WRONLY | O_CREAT | O_TRUNC,
@@ -320,32 +427,108 @@ static int filesystem_copy(const char *name, const char *destname)
 	if (out == NULL) {
 		error("open(%s): %s (%d)", destname, strerror(-err), -err);
 		filesystem_close(in);
-		return -errno;
+		return err;
 	}
 
 	out_fd = GPOINTER_TO_INT(out);
 
-	/* Check if sendfile is supported */
-	ret = sendfile(out_fd, in_fd, NULL, 0);
-	if (ret < 0) {
-		ret = -errno;
-		error("sendfile: %s (%zd)", strerror(-ret), -ret);
-		goto done;
+	job = g_new0(struct copy_job, 1);
+	job->in_fd = in_fd;
+	job->out_fd = out_fd;
+	job->source = g_strdup(name);
+	job->destname = g_strdup(destname);
+	job->move = move;
+	job->size = st.st_size;
+
+	copy_jobs = g_slist_prepend(copy_jobs, job);
+
+#ifdef FICLONE
+	/* Share the data blocks if the filesystem supports it */
+	if (ioctl(out_fd, FICLONE, in_fd) == 0) {
+		DBG("%s cloned to %s", name, destname);
+		copy_job_finish(job);
+		return 0;
 	}
+#endif
 
-	ret = sendfile_async(out_fd, in_fd, NULL, st.st_size);
-	if (ret < 0)
-		goto done;
+	if (job->size == 0) {
+		copy_job_finish(job);
+		return 0;
+	}
 
-	return 0;
+	/*
+	 * Files up to COPY_CHUNK_SIZE are copied right away. Anything larger
+	 * is copied from the main loop and the action is answered through
+	 * func once done; removing the destination cancels it.
+	 */
+	err = copy_job_next(job);
+	if (err < 0) {
+		copy_job_abort(job, err);
+		return err;
+	}
 
-done:
-	filesystem_close(in);
-	filesystem_close(out);
+	if (err == 0) {
+		copy_job_finish(job);
+		return 0;
+	}
+
+	job->func = func;
+	job->user_data = user_data;
+	job->id = g_idle_add(copy_job_step, job);
+
+	return -EINPROGRESS;
+}
+
+/* Stop any copy into a file that is about to be removed */
+static void copy_cancel(const char *path)
+{
+	GSList *l;
+
+	for (l = copy_jobs; l; l = l->next) {
+		struct copy_job *job = l->data;
+
+		if (g_str_equal(job->destname, path)) {
+			DBG("cancel copy of %s to %s", job->source, path);
+			copy_job_free(job, -ECANCELED);
+			return;
+		}
+	}
+}
+
+static int filesystem_rename(const char *name, const char *destname,
+			obex_action_complete_func func, void *user_data)
+{
+	int ret;
+
+	ret = rename(name, destname);
+	if (ret < 0 && errno == EXDEV &&
+				!g_file_test(name, G_FILE_TEST_IS_DIR)) {
+		/* Move files across filesystems by copying them */
+		return copy_start(name, destname, TRUE, func, user_data);
+	}
+
+	if (ret < 0) {
+		error("rename(%s, %s): %s (%d)", name, destname,
+						strerror(errno), errno);
+		return -errno;
+	}
 
 	return ret;
 }
 
+static int filesystem_copy(const char *name, const char *destname,
+			obex_action_complete_func func, void *user_data)
+{
+	return copy_start(name, destname, FALSE, func, user_data);
+}
+
+static int filesystem_remove(const char *name)
+{
+	copy_cancel(name);
+
+	return remove(name);
+}
+
 struct capability_object {
 	int pid;
 	int output;
@@ -459,140 +642,412 @@ fail:
 	return NULL;
 }
 
-static GString *append_pcsuite_preamble(GString *object)
+/* Directories whose listings are kept, and the entries kept for each */
+#define FOLDER_CACHE_MAX		8
+#define FOLDER_CACHE_MAX_ENTRIES	65536
+
+struct folder_entry {
+	char *name;
+	mode_t mode;
+	off_t size;
+	time_t atime;
+	time_t mtime;
+	time_t ctime;
+};
+
+/*
+ * Metadata of the entries of a directory, dropped as soon as inotify
+ * reports a change in it. Access time updates alone don't invalidate
+ * the cache, as every read from the directory would.
+ */
+struct folder_cache {
+	int refcount;
+	char *path;
+	int wd;
+	GPtrArray *entries;
+	gboolean complete;
+	gboolean stale;
+};
+
+/* Folder listing generated as it is read */
+struct folder_listing {
+	GString *buffer;
+	char *name;
+	gboolean root;
+	struct stat dstat;
+	DIR *dp;
+	struct folder_cache *cache;
+	gboolean fill;		/* cache is filled from dp */
+	guint index;
+	gboolean done;
+};
+
+static GSList *folder_caches = NULL;
+static int inotify_fd = -1;
+static guint inotify_watch = 0;
+
+static void folder_entry_free(gpointer data)
 {
-	return g_string_append(object, FL_TYPE_PCSUITE);
+	struct folder_entry *entry = data;
+
+	g_free(entry->name);
+	g_free(entry);
 }
 
-static GString *append_folder_preamble(GString *object)
+static struct folder_cache *folder_cache_ref(struct folder_cache *cache)
 {
-	return g_string_append(object, FL_TYPE);
+	cache->refcount++;
+
+	return cache;
 }
 
-static GString *append_listing(GString *object, const char *name,
-				gboolean pcsuite, size_t *size, int *err)
+static void folder_cache_unref(struct folder_cache *cache)
 {
-	struct stat fstat, dstat;
-	struct dirent *ep;
-	DIR *dp;
-	gboolean root;
-	int ret;
+	if (--cache->refcount > 0)
+		return;
 
-	root = g_str_equal(name, obex_option_root_folder());
+	g_ptr_array_free(cache->entries, TRUE);
+	g_free(cache->path);
+	g_free(cache);
+}
 
-	dp = opendir(name);
-	if (dp == NULL) {
-		if (err)
-			*err = -ENOENT;
-		goto failed;
-	}
+static void folder_cache_drop(struct folder_cache *cache, gboolean watched)
+{
+	DBG("%s", cache->path);
 
-	if (!root)
-		object = g_string_append(object, FL_PARENT_FOLDER_ELEMENT);
+	folder_caches = g_slist_remove(folder_caches, cache);
 
-	ret = verify_path(name);
-	if (ret < 0) {
-		*err = ret;
-		goto failed;
-	}
+	if (watched)
+		inotify_rm_watch(inotify_fd, cache->wd);
 
-	ret = stat(name, &dstat);
-	if (ret < 0) {
-		if (err)
-			*err = -errno;
-		goto failed;
+	cache->stale = TRUE;
+	folder_cache_unref(cache);
+}
+
+static gboolean inotify_read(GIOChannel *io, GIOCondition cond,
+							gpointer user_data)
+{
+	char buf[4096]
+		__attribute__ ((aligned(__alignof__(struct inotify_event))));
+	ssize_t len, i;
+
+	if (cond & (G_IO_ERR | G_IO_HUP | G_IO_NVAL)) {
+		inotify_watch = 0;
+		return FALSE;
 	}
 
-	while ((ep = readdir(dp))) {
-		char *filename;
-		char *fullname;
-		char *line;
+	len = read(inotify_fd, buf, sizeof(buf));
+	if (len <= 0)
+		return TRUE;
 
-		if (ep->d_name[0] == '.')
-			continue;
+	for (i = 0; i < len;) {
+		struct inotify_event *event = (void *) &buf[i];
+		GSList *l;
+
+		i += sizeof(*event) + event->len;
 
-		filename = g_filename_to_utf8(ep->d_name, -1, NULL, NULL, NULL);
-		if (filename == NULL) {
-			error("g_filename_to_utf8: invalid filename");
+		/* Events were lost, nothing can be trusted anymore */
+		if (event->mask & IN_Q_OVERFLOW) {
+			while (folder_caches)
+				folder_cache_drop(folder_caches->data, TRUE);
 			continue;
 		}
 
-		fullname = g_build_filename(name, ep->d_name, NULL);
+		for (l = folder_caches; l; l = l->next) {
+			struct folder_cache *cache = l->data;
 
-		ret = stat(fullname, &fstat);
-		if (ret < 0) {
-			DBG("stat: %s(%d)", strerror(errno), errno);
-			g_free(filename);
-			g_free(fullname);
-			continue;
+			if (cache->wd != event->wd)
+				continue;
+
+			folder_cache_drop(cache, !(event->mask & IN_IGNORED));
+			break;
 		}
+	}
 
-		g_free(fullname);
+	return TRUE;
+}
 
-		line = file_stat_line(filename, &fstat, &dstat, root, FALSE);
-		if (line == NULL) {
-			g_free(filename);
-			continue;
-		}
+static gboolean inotify_setup(void)
+{
+	GIOChannel *io;
 
-		g_free(filename);
+	if (inotify_fd >= 0)
+		return TRUE;
 
-		object = g_string_append(object, line);
-		g_free(line);
+	inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (inotify_fd < 0) {
+		error("inotify_init1: %s (%d)", strerror(errno), errno);
+		return FALSE;
 	}
 
-	closedir(dp);
+	io = g_io_channel_unix_new(inotify_fd);
+	inotify_watch = g_io_add_watch(io, G_IO_IN | G_IO_ERR | G_IO_HUP |
+						G_IO_NVAL, inotify_read, NULL);
+	g_io_channel_unref(io);
 
-	object = g_string_append(object, FL_BODY_END);
-	if (size)
-		*size = object->len;
+	return TRUE;
+}
 
-	if (err)
-		*err = 0;
+static struct folder_cache *folder_cache_find(const char *path)
+{
+	GSList *l;
 
-	return object;
+	for (l = folder_caches; l; l = l->next) {
+		struct folder_cache *cache = l->data;
 
-failed:
-	if (dp)
-		closedir(dp);
+		if (g_str_equal(cache->path, path))
+			return cache;
+	}
 
-	g_string_free(object, TRUE);
 	return NULL;
 }
 
-static void *folder_open(const char *name, int oflag, mode_t mode,
-					void *context, size_t *size, int *err)
+/* Start caching a directory, its entries get added while listing it */
+static struct folder_cache *folder_cache_new(const char *path)
 {
-	GString *object;
+	struct folder_cache *cache;
+	int wd;
 
-	object = g_string_new(FL_VERSION);
-	object = append_folder_preamble(object);
-	object = g_string_append(object, FL_BODY_BEGIN);
+	if (!inotify_setup())
+		return NULL;
+
+	wd = inotify_add_watch(inotify_fd, path, IN_CREATE | IN_DELETE |
+				IN_MODIFY | IN_ATTRIB | IN_MOVED_FROM |
+				IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF |
+				IN_ONLYDIR);
+	if (wd < 0) {
+		DBG("inotify_add_watch(%s): %s (%d)", path, strerror(errno),
+									errno);
+		return NULL;
+	}
 
-	return append_listing(object, name, FALSE, size, err);
+	/* Make room by dropping the oldest directory */
+	if (g_slist_length(folder_caches) >= FOLDER_CACHE_MAX)
+		folder_cache_drop(g_slist_last(folder_caches)->data, TRUE);
+
+	cache = g_new0(struct folder_cache, 1);
+	cache->refcount = 1;
+	cache->path = g_strdup(path);
+	cache->wd = wd;
+	cache->entries = g_ptr_array_new_with_free_func(folder_entry_free);
+
+	folder_caches = g_slist_prepend(folder_caches, cache);
+
+	return folder_cache_ref(cache);
 }
 
-static void *pcsuite_open(const char *name, int oflag, mode_t mode,
-					void *context, size_t *size, int *err)
+static void folder_listing_append(struct folder_listing *listing,
+					const char *filename,
+					struct stat *fstat)
 {
-	GString *object;
+	char *line;
 
-	object = g_string_new(FL_VERSION);
-	object = append_pcsuite_preamble(object);
-	object = g_string_append(object, FL_BODY_BEGIN);
+	line = file_stat_line((char *) filename, fstat, &listing->dstat,
+							listing->root, FALSE);
+	if (line == NULL)
+		return;
 
-	return append_listing(object, name, TRUE, size, err);
+	g_string_append(listing->buffer, line);
+	g_free(line);
 }
 
-static int string_free(void *object)
+static void folder_listing_cache(struct folder_listing *listing,
+					const char *filename,
+					struct stat *fstat)
 {
-	GString *string = object;
+	struct folder_cache *cache = listing->cache;
+	struct folder_entry *entry;
+
+	/* Too large to be kept, the directory gets read every time */
+	if (cache->entries->len == FOLDER_CACHE_MAX_ENTRIES) {
+		if (!cache->stale)
+			folder_cache_drop(cache, TRUE);
+		folder_cache_unref(cache);
+		listing->cache = NULL;
+		listing->fill = FALSE;
+		return;
+	}
+
+	entry = g_new0(struct folder_entry, 1);
+	entry->name = g_strdup(filename);
+	entry->mode = fstat->st_mode;
+	entry->size = fstat->st_size;
+	entry->atime = fstat->st_atime;
+	entry->mtime = fstat->st_mtime;
+	entry->ctime = fstat->st_ctime;
+
+	g_ptr_array_add(cache->entries, entry);
+}
+
+static void folder_listing_read_dir(struct folder_listing *listing)
+{
+	struct stat fstat;
+	struct dirent *ep;
+	char *filename, *fullname;
+
+	ep = readdir(listing->dp);
+	if (ep == NULL) {
+		closedir(listing->dp);
+		listing->dp = NULL;
+
+		if (listing->fill) {
+			listing->cache->complete = TRUE;
+			listing->fill = FALSE;
+		}
+
+		g_string_append(listing->buffer, FL_BODY_END);
+		listing->done = TRUE;
+		return;
+	}
+
+	if (ep->d_name[0] == '.')
+		return;
+
+	filename = g_filename_to_utf8(ep->d_name, -1, NULL, NULL, NULL);
+	if (filename == NULL) {
+		error("g_filename_to_utf8: invalid filename");
+		return;
+	}
+
+	fullname = g_build_filename(listing->name, ep->d_name, NULL);
+
+	if (stat(fullname, &fstat) < 0) {
+		DBG("stat: %s(%d)", strerror(errno), errno);
+		g_free(filename);
+		g_free(fullname);
+		return;
+	}
+
+	g_free(fullname);
+
+	if (listing->fill)
+		folder_listing_cache(listing, filename, &fstat);
 
-	g_string_free(string, TRUE);
+	folder_listing_append(listing, filename, &fstat);
+
+	g_free(filename);
+}
+
+static void folder_listing_read_cache(struct folder_listing *listing)
+{
+	GPtrArray *entries = listing->cache->entries;
+	struct folder_entry *entry;
+	struct stat fstat;
+
+	if (listing->index == entries->len) {
+		g_string_append(listing->buffer, FL_BODY_END);
+		listing->done = TRUE;
+		return;
+	}
+
+	entry = g_ptr_array_index(entries, listing->index++);
+
+	memset(&fstat, 0, sizeof(fstat));
+	fstat.st_mode = entry->mode;
+	fstat.st_size = entry->size;
+	fstat.st_atime = entry->atime;
+	fstat.st_mtime = entry->mtime;
+	fstat.st_ctime = entry->ctime;
+
+	folder_listing_append(listing, entry->name, &fstat);
+}
+
+static int folder_listing_free(void *object)
+{
+	struct folder_listing *listing = object;
+
+	if (listing->dp)
+		closedir(listing->dp);
+
+	if (listing->cache) {
+		/* An incomplete cache is of no use to anyone */
+		if (listing->fill && !listing->cache->stale)
+			folder_cache_drop(listing->cache, TRUE);
+
+		folder_cache_unref(listing->cache);
+	}
+
+	g_string_free(listing->buffer, TRUE);
+	g_free(listing->name);
+	g_free(listing);
 
 	return 0;
 }
 
+static void *folder_listing_open(const char *name, const char *preamble,
+								int *err)
+{
+	struct folder_listing *listing;
+	struct folder_cache *cache;
+	int ret;
+
+	listing = g_new0(struct folder_listing, 1);
+	listing->name = g_strdup(name);
+	listing->root = g_str_equal(name, obex_option_root_folder());
+
+	cache = folder_cache_find(name);
+	if (cache == NULL || !cache->complete) {
+		listing->dp = opendir(name);
+		if (listing->dp == NULL) {
+			ret = -ENOENT;
+			goto failed;
+		}
+	}
+
+	ret = verify_path(name);
+	if (ret < 0)
+		goto failed;
+
+	if (stat(name, &listing->dstat) < 0) {
+		ret = -errno;
+		goto failed;
+	}
+
+	if (listing->dp == NULL) {
+		listing->cache = folder_cache_ref(cache);
+	} else if (cache == NULL) {
+		listing->cache = folder_cache_new(name);
+		listing->fill = listing->cache != NULL;
+	}
+
+	listing->buffer = g_string_new(FL_VERSION);
+	g_string_append(listing->buffer, preamble);
+	g_string_append(listing->buffer, FL_BODY_BEGIN);
+
+	if (!listing->root)
+		g_string_append(listing->buffer, FL_PARENT_FOLDER_ELEMENT);
+
+	/* The size isn't known until the whole directory has been read */
+	if (err)
+		*err = 0;
+
+	return listing;
+
+failed:
+	if (err)
+		*err = ret;
+
+	if (listing->dp)
+		closedir(listing->dp);
+
+	g_free(listing->name);
+	g_free(listing);
+
+	return NULL;
+}
+
+static void *folder_open(const char *name, int oflag, mode_t mode,
+					void *context, size_t *size, int *err)
+{
+	return folder_listing_open(name, FL_TYPE, err);
+}
+
+static void *pcsuite_open(const char *name, int oflag, mode_t mode,
+					void *context, size_t *size, int *err)
+{
+	return folder_listing_open(name, FL_TYPE_PCSUITE, err);
+}
+
 ssize_t string_read(void *object, void *buf, size_t count)
 {
 	GString *string = object;
@@ -610,7 +1065,17 @@ ssize_t string_read(void *object, void *buf, size_t count)
 
 static ssize_t folder_read(void *object, void *buf, size_t count)
 {
-	return string_read(object, buf, count);
+	struct folder_listing *listing = object;
+
+	/* Only generate what the next packet needs */
+	while (listing->buffer->len < count && !listing->done) {
+		if (listing->dp)
+			folder_listing_read_dir(listing);
+		else
+			folder_listing_read_cache(listing);
+	}
+
+	return string_read(listing->buffer, buf, count);
 }
 
 static ssize_t capability_read(void *object, void *buf, size_t count)
@@ -659,7 +1124,7 @@ static struct obex_mime_type_driver file = {
 	.close = filesystem_close,
 	.read = filesystem_read,
 	.write = filesystem_write,
-	.remove = remove,
+	.remove = filesystem_remove,
 	.move = filesystem_rename,
 	.copy = filesystem_copy,
 };
@@ -678,7 +1143,7 @@ static struct obex_mime_type_driver folder = {
 	.target_size = FTP_TARGET_SIZE,
 	.mimetype = "x-obex/folder-listing",
 	.open = folder_open,
-	.close = string_free,
+	.close = folder_listing_free,
 	.read = folder_read,
 };
 
@@ -689,7 +1154,7 @@ static struct obex_mime_type_driver pcsuite = {
 	.who_size = PCSUITE_WHO_SIZE,
 	.mimetype = "x-obex/folder-listing",
 	.open = pcsuite_open,
-	.close = string_free,
+	.close = folder_listing_free,
 	.read = folder_read,
 };
 
@@ -714,6 +1179,18 @@ static int filesystem_init(void)
 
 static void filesystem_exit(void)
 {
+	while (copy_jobs)
+		copy_job_abort(copy_jobs->data, -ECANCELED);
+
+	while (folder_caches)
+		folder_cache_drop(folder_caches->data, TRUE);
+
+	if (inotify_watch > 0)
+		g_source_remove(inotify_watch);
+
+	if (inotify_fd >= 0)
+		close(inotify_fd);
+
 	obex_mime_type_driver_unregister(&folder);
 	obex_mime_type_driver_unregister(&capability);
 	obex_mime_type_driver_unregister(&file);
@@ -64,6 +64,7 @@ struct irmc_session {
 	char manu[DID_LEN];
 	char model[DID_LEN];
 	void *request;
+	gboolean partial;
 };
 
 #define IRMC_TARGET_SIZE 9
@@ -109,7 +110,7 @@ static void query_result(const char *buffer, size_t bufsize, int vcards,
 
 	DBG("bufsize %zu vcards %d missed %d", bufsize, vcards, missed);
 
-	if (irmc->request) {
+	if (irmc->request && lastpart) {
 		phonebook_req_finalize(irmc->request);
 		irmc->request = NULL;
 	}
@@ -117,7 +118,7 @@ static void query_result(const char *buffer, size_t bufsize, int vcards,
 	/* first add a 'owner' vcard */
 	if (!irmc->buffer)
 		irmc->buffer = g_string_new(owner_vcard);
-	else
+	else if (!irmc->partial)
 		irmc->buffer = g_string_append(irmc->buffer, owner_vcard);
 
 	if (buffer == NULL)
@@ -147,6 +148,12 @@ static void query_result(const char *buffer, size_t bufsize, int vcards,
 	irmc->buffer = g_string_append(irmc->buffer, s);
 
 done:
+	/* Backends may return the phonebook in parts, collect all of them */
+	irmc->partial = !lastpart;
+	if (irmc->partial && phonebook_pull_read(irmc->request) == 0)
+		return;
+
+	irmc->partial = FALSE;
 	obex_object_set_io_flags(irmc, G_IO_IN, 0);
 }
 
@@ -423,7 +430,7 @@ static ssize_t irmc_read(void *object, void *buf, size_t count)
 	int len;
 
 	DBG("buffer %p count %zu", irmc->buffer, count);
-	if (!irmc->buffer)
+	if (!irmc->buffer || irmc->partial)
                 return -EAGAIN;
 
 	len = string_read(irmc->buffer, buf, count);
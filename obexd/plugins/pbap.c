@@ -65,16 +65,29 @@
 #define PHONEBOOKSIZE_TAG	0X08
 #define NEWMISSEDCALLS_TAG	0X09
 
+/*
+ * Sort orders as carried by the Order application parameter:
+ * 0x00 = indexed, 0x01 = alphanumeric, 0x02 = phonetic
+ */
+#define ORDER_INDEXED		0x00
+#define ORDER_ALPHANUMERIC	0x01
+#define ORDER_PHONETIC		0x02
+#define ORDER_MAX		3
+
 struct cache {
 	gboolean valid;
 	uint32_t index;
-	GSList *entries;
+	GPtrArray *entries;
+	GHashTable *handles;
+	/* Entries sorted per order, built on first use */
+	struct cache_entry **sorted[ORDER_MAX];
 };
 
 struct cache_entry {
 	uint32_t handle;
 	char *id;
 	char *name;
+	char *name_down;
 	char *sound;
 	char *tel;
 };
@@ -92,6 +105,7 @@ struct pbap_object {
 	GObexApparam *apparam;
 	gboolean firstpacket;
 	gboolean lastpart;
+	gboolean pending;
 	struct pbap_session *session;
 	void *request;
 };
@@ -109,6 +123,7 @@ static void cache_entry_free(void *data)
 
 	g_free(entry->id);
 	g_free(entry->name);
+	g_free(entry->name_down);
 	g_free(entry->sound);
 	g_free(entry->tel);
 	g_free(entry);
@@ -117,20 +132,13 @@ static void cache_entry_free(void *data)
 static gboolean entry_name_find(const struct cache_entry *entry,
 		const char *value)
 {
-	char *name;
-	gboolean ret;
-
 	if (!entry->name)
 		return FALSE;
 
 	if (strlen(value) == 0)
 		return TRUE;
 
-	name = g_utf8_strdown(entry->name, -1);
-	ret = (g_strstr_len(name, -1, value) ? TRUE : FALSE);
-	g_free(name);
-
-	return ret;
+	return (g_strstr_len(entry->name_down, -1, value) ? TRUE : FALSE);
 }
 
 static gboolean entry_sound_find(const struct cache_entry *entry,
@@ -153,22 +161,46 @@ static gboolean entry_tel_find(const struct cache_entry *entry,
 
 static const char *cache_find(struct cache *cache, uint32_t handle)
 {
-	GSList *l;
+	struct cache_entry *entry;
 
-	for (l = cache->entries; l; l = l->next) {
-		struct cache_entry *entry = l->data;
+	if (!cache->handles)
+		return NULL;
 
-		if (entry->handle == handle)
-			return entry->id;
-	}
+	entry = g_hash_table_lookup(cache->handles, GUINT_TO_POINTER(handle));
+	if (!entry)
+		return NULL;
 
-	return NULL;
+	return entry->id;
+}
+
+static guint cache_size(struct cache *cache)
+{
+	return cache->entries ? cache->entries->len : 0;
+}
+
+static void cache_sorted_clear(struct cache *cache)
+{
+	int i;
+
+	for (i = 0; i < ORDER_MAX; i++) {
+		g_free(cache->sorted[i]);
+		cache->sorted[i] = NULL;
+	}
 }
 
 static void cache_clear(struct cache *cache)
 {
-	g_slist_free_full(cache->entries, cache_entry_free);
-	cache->entries = NULL;
+	cache_sorted_clear(cache);
+
+	if (cache->handles) {
+		g_hash_table_destroy(cache->handles);
+		cache->handles = NULL;
+	}
+
+	if (cache->entries) {
+		g_ptr_array_free(cache->entries, TRUE);
+		cache->entries = NULL;
+	}
 }
 
 static void phonebook_size_result(const char *buffer, size_t bufsize,
@@ -218,6 +250,7 @@ static void query_result(const char *buffer, size_t bufsize, int vcards,
 	}
 
 	pbap->obj->lastpart = lastpart;
+	pbap->obj->pending = FALSE;
 
 	if (vcards < 0) {
 		obex_object_set_io_flags(pbap->obj, G_IO_ERR, -ENOENT);
@@ -259,67 +292,132 @@ static void cache_entry_notify(const char *id, uint32_t handle,
 
 	entry->id = g_strdup(id);
 	entry->name = g_strdup(name);
+	entry->name_down = name ? g_utf8_strdown(name, -1) : NULL;
 	entry->sound = g_strdup(sound);
 	entry->tel = g_strdup(tel);
 
-	cache->entries = g_slist_append(cache->entries, entry);
+	if (!cache->entries) {
+		cache->entries = g_ptr_array_new_with_free_func(
+							cache_entry_free);
+		cache->handles = g_hash_table_new(g_direct_hash,
+							g_direct_equal);
+	}
+
+	g_ptr_array_add(cache->entries, entry);
+
+	/* Lookups by handle always returned the first match */
+	if (!g_hash_table_lookup(cache->handles,
+					GUINT_TO_POINTER(entry->handle)))
+		g_hash_table_insert(cache->handles,
+				GUINT_TO_POINTER(entry->handle), entry);
+
+	cache_sorted_clear(cache);
 }
 
-static int alpha_sort(gconstpointer a, gconstpointer b)
+static int indexed_sort(const void *a, const void *b)
 {
-	const struct cache_entry *e1 = a;
-	const struct cache_entry *e2 = b;
+	const struct cache_entry *e1 = *(struct cache_entry * const *) a;
+	const struct cache_entry *e2 = *(struct cache_entry * const *) b;
 
-	return g_strcmp0(e1->name, e2->name);
+	if (e1->handle == e2->handle)
+		return 0;
+
+	return e1->handle < e2->handle ? -1 : 1;
 }
 
-static int indexed_sort(gconstpointer a, gconstpointer b)
+static int alpha_sort(const void *a, const void *b)
 {
-	const struct cache_entry *e1 = a;
-	const struct cache_entry *e2 = b;
+	const struct cache_entry *e1 = *(struct cache_entry * const *) a;
+	const struct cache_entry *e2 = *(struct cache_entry * const *) b;
+	int ret;
 
-	return (e1->handle - e2->handle);
+	ret = g_strcmp0(e1->name, e2->name);
+	if (ret)
+		return ret;
+
+	return indexed_sort(a, b);
 }
 
-static int phonetical_sort(gconstpointer a, gconstpointer b)
+static int phonetical_sort(const void *a, const void *b)
 {
-	const struct cache_entry *e1 = a;
-	const struct cache_entry *e2 = b;
+	const struct cache_entry *e1 = *(struct cache_entry * const *) a;
+	const struct cache_entry *e2 = *(struct cache_entry * const *) b;
+	int ret;
 
-	/* SOUND attribute is optional. Use Indexed sort if not present. */
-	if (!e1->sound || !e2->sound)
-		return indexed_sort(a, b);
+	/*
+	 * SOUND attribute is optional. Entries without it come first, in
+	 * Indexed order.
+	 */
+	ret = g_strcmp0(e1->sound, e2->sound);
+	if (ret)
+		return ret;
 
-	return g_strcmp0(e1->sound, e2->sound);
+	return indexed_sort(a, b);
 }
 
-static GSList *sort_entries(GSList *l, uint8_t order, uint8_t search_attrib,
-							const char *value)
+static struct cache_entry **cache_sorted(struct cache *cache, uint8_t order)
 {
-	GSList *sorted = NULL;
-	cache_entry_find_f find;
-	GCompareFunc sort;
-	char *searchval;
+	int (*sort) (const void *a, const void *b);
+	guint len = cache_size(cache);
 
 	/*
 	 * Default sorter is "Indexed". Some backends doesn't inform the index,
 	 * for this case a sequential internal index is assigned.
-	 * 0x00 = indexed
-	 * 0x01 = alphanumeric
-	 * 0x02 = phonetic
 	 */
 	switch (order) {
-	case 0x01:
+	case ORDER_ALPHANUMERIC:
 		sort = alpha_sort;
 		break;
-	case 0x02:
+	case ORDER_PHONETIC:
 		sort = phonetical_sort;
 		break;
 	default:
+		order = ORDER_INDEXED;
 		sort = indexed_sort;
 		break;
 	}
 
+	if (cache->sorted[order] || len == 0)
+		return cache->sorted[order];
+
+	/*
+	 * The cache only changes while it is being (re)built, so each order
+	 * is sorted once and then reused by every listing request, making
+	 * paging a matter of indexing into the array.
+	 */
+	cache->sorted[order] = g_new(struct cache_entry *, len);
+	memcpy(cache->sorted[order], cache->entries->pdata,
+					len * sizeof(struct cache_entry *));
+	qsort(cache->sorted[order], len, sizeof(struct cache_entry *), sort);
+
+	return cache->sorted[order];
+}
+
+static void append_entry(GString *buffer, const struct cache_entry *entry)
+{
+	char *escaped_name = g_markup_escape_text(entry->name, -1);
+
+	g_string_append_printf(buffer, VCARD_LISTING_ELEMENT, entry->handle,
+								escaped_name);
+
+	g_free(escaped_name);
+}
+
+static void append_entries(GString *buffer, struct cache_entry **sorted,
+				guint len, guint offset, uint16_t max,
+				uint8_t search_attrib, const char *value)
+{
+	cache_entry_find_f find;
+	char *searchval;
+	guint i;
+
+	if (!value) {
+		for (i = offset; i < len && max; i++, max--)
+			append_entry(buffer, sorted[i]);
+
+		return;
+	}
+
 	/*
 	 * This implementation checks if the given field CONTAINS the
 	 * search value(case insensitive). Name is the default field
@@ -339,33 +437,35 @@ static GSList *sort_entries(GSList *l, uint8_t order, uint8_t search_attrib,
 			break;
 	}
 
-	searchval = value ? g_utf8_strdown(value, -1) : NULL;
-	for (; l; l = l->next) {
-		struct cache_entry *entry = l->data;
+	/* Offset counts matching entries only */
+	searchval = g_utf8_strdown(value, -1);
+	for (i = 0; i < len && max; i++) {
+		if (!find(sorted[i], (const char *) searchval))
+			continue;
 
-		if (searchval && !find(entry, (const char *) searchval))
+		if (offset > 0) {
+			offset--;
 			continue;
+		}
 
-		sorted = g_slist_insert_sorted(sorted, entry, sort);
+		append_entry(buffer, sorted[i]);
+		max--;
 	}
 
 	g_free(searchval);
-
-	return sorted;
 }
 
 static int generate_response(void *user_data)
 {
 	struct pbap_session *pbap = user_data;
-	GSList *sorted;
-	GSList *l;
+	struct cache_entry **sorted;
 	uint16_t max = pbap->params->maxlistcount;
 
 	DBG("");
 
 	if (max == 0) {
 		/* Ignore all other parameter and return PhoneBookSize */
-		uint16_t size = htons(g_slist_length(pbap->cache.entries));
+		uint16_t size = htons(cache_size(&pbap->cache));
 
 		pbap->obj->apparam = g_obex_apparam_set_uint16(
 							pbap->obj->apparam,
@@ -375,31 +475,18 @@ static int generate_response(void *user_data)
 		return 0;
 	}
 
-	/*
-	 * Don't free the sorted list content: this list contains
-	 * only the reference for the "real" cache entry.
-	 */
-	sorted = sort_entries(pbap->cache.entries, pbap->params->order,
-				pbap->params->searchattrib,
-				(const char *) pbap->params->searchval);
-
-	/* Computing offset considering first entry of the phonebook */
-	l = g_slist_nth(sorted, pbap->params->liststartoffset);
+	sorted = cache_sorted(&pbap->cache, pbap->params->order);
 
 	pbap->obj->buffer = g_string_new(VCARD_LISTING_BEGIN);
-	for (; l && max; l = l->next, max--) {
-		const struct cache_entry *entry = l->data;
-		char *escaped_name = g_markup_escape_text(entry->name, -1);
-
-		g_string_append_printf(pbap->obj->buffer,
-			VCARD_LISTING_ELEMENT, entry->handle, escaped_name);
 
-		g_free(escaped_name);
-	}
+	/* Computing offset considering first entry of the phonebook */
+	append_entries(pbap->obj->buffer, sorted, cache_size(&pbap->cache),
+				pbap->params->liststartoffset, max,
+				pbap->params->searchattrib,
+				(const char *) pbap->params->searchval);
 
 	pbap->obj->buffer = g_string_append(pbap->obj->buffer,
 							VCARD_LISTING_END);
-	g_slist_free(sorted);
 
 	return 0;
 }
@@ -650,6 +737,7 @@ static void *vobject_pull_open(const char *name, int oflag, mode_t mode,
 	phonebook_cb cb;
 	int ret;
 	void *request;
+	struct pbap_object *obj;
 
 	DBG("name %s context %p maxlistcount %d", name, context,
 						pbap->params->maxlistcount);
@@ -682,7 +770,10 @@ static void *vobject_pull_open(const char *name, int oflag, mode_t mode,
 	if (err)
 		*err = 0;
 
-	return vobject_create(pbap, request);
+	obj = vobject_create(pbap, request);
+	obj->pending = TRUE;
+
+	return obj;
 
 fail:
 	if (err)
@@ -853,17 +944,24 @@ static ssize_t vobject_pull_read(void *object, void *buf, size_t count)
 	}
 
 	len = string_read(obj->buffer, buf, count);
-	if (len == 0 && !obj->lastpart) {
-		/* in case when buffer is empty and we know that more
-		 * data is still available in backend, requesting new
-		 * data part via phonebook_pull_read and returning
-		 * -EAGAIN to suspend request for now */
+
+	/*
+	 * Only one part is buffered at a time: when less than a packet is
+	 * left and the backend has more data, request the next part so it
+	 * is ready by the time the buffer drains instead of stalling the
+	 * transfer once it is empty.
+	 */
+	if (!obj->lastpart && !obj->pending && obj->buffer->len < count) {
+		obj->pending = TRUE;
+
 		ret = phonebook_pull_read(obj->request);
 		if (ret)
 			return -EPERM;
+	}
 
+	/* Suspend the request until the next part arrives */
+	if (len == 0 && !obj->lastpart)
 		return -EAGAIN;
-	}
 
 	return len;
 }
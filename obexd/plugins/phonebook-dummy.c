@@ -44,22 +44,21 @@
 #include "log.h"
 #include "phonebook.h"
 
+#define VCARDS_PART_COUNT 50 /* amount of vcards sent at once to PBAP core */
+
 typedef void (*vcard_func_t) (const char *file, VObject *vo, void *user_data);
 
 struct dummy_data {
 	phonebook_cb cb;
-	void *user_data;
-	const struct apparam_field *apparams;
-	char *folder;
-	int fd;
-	guint id;
-};
-
-struct cache_query {
 	phonebook_entry_cb entry_cb;
 	phonebook_cache_ready_cb ready_cb;
 	void *user_data;
+	const struct apparam_field *apparams;
+	int fd;
 	DIR *dp;
+	GSList *vcards;
+	uint16_t remaining;
+	guint id;
 };
 
 static char *root_folder = NULL;
@@ -71,18 +70,11 @@ static void dummy_free(void *user_data)
 	if (dummy->fd >= 0)
 		close(dummy->fd);
 
-	g_free(dummy->folder);
-	g_free(dummy);
-}
-
-static void query_free(void *user_data)
-{
-	struct cache_query *query = user_data;
-
-	if (query->dp)
-		closedir(query->dp);
+	if (dummy->dp)
+		closedir(dummy->dp);
 
-	g_free(query);
+	g_slist_free_full(dummy->vcards, g_free);
+	g_free(dummy);
 }
 
 int phonebook_init(void)
@@ -117,22 +109,10 @@ static int handle_cmp(gconstpointer a, gconstpointer b)
 	return (i1 - i2);
 }
 
-static int foreach_vcard(DIR *dp, vcard_func_t func, uint16_t offset,
-			uint16_t maxlistcount, void *user_data, uint16_t *count)
+static GSList *sorted_vcards(DIR *dp)
 {
 	struct dirent *ep;
-	GSList *sorted = NULL, *l;
-	VObject *v;
-	FILE *fp;
-	int err, fd, folderfd;
-	uint16_t n = 0;
-
-	folderfd = dirfd(dp);
-	if (folderfd < 0) {
-		err = errno;
-		error("dirfd(): %s(%d)", strerror(err), err);
-		return -err;
-	}
+	GSList *sorted = NULL;
 
 	/*
 	 * Sorting vcards by file name. versionsort is a GNU extension.
@@ -160,36 +140,38 @@ static int foreach_vcard(DIR *dp, vcard_func_t func, uint16_t offset,
 		sorted = g_slist_insert_sorted(sorted, filename, handle_cmp);
 	}
 
-	/*
-	 * Filtering only the requested vCards attributes. Offset
-	 * shall be based on the first entry of the phonebook.
-	 */
-	for (l = g_slist_nth(sorted, offset);
-			l && n < maxlistcount; l = l->next) {
-		const char *filename = l->data;
-
-		fd = openat(folderfd, filename, O_RDONLY);
-		if (fd < 0) {
-			err = errno;
-			error("openat(%s): %s(%d)", filename, strerror(err), err);
-			continue;
-		}
+	return sorted;
+}
 
-		fp = fdopen(fd, "r");
-		v = Parse_MIME_FromFile(fp);
-		if (v != NULL) {
-			func(filename, v, user_data);
-			deleteVObject(v);
-			n++;
-		}
+static int parse_vcard(DIR *dp, const char *filename, vcard_func_t func,
+							void *user_data)
+{
+	VObject *v;
+	FILE *fp;
+	int err, fd;
+
+	fd = openat(dirfd(dp), filename, O_RDONLY);
+	if (fd < 0) {
+		err = errno;
+		error("openat(%s): %s(%d)", filename, strerror(err), err);
+		return -err;
+	}
 
+	fp = fdopen(fd, "r");
+	if (fp == NULL) {
+		err = errno;
 		close(fd);
+		return -err;
 	}
 
-	g_slist_free_full(sorted, g_free);
+	v = Parse_MIME_FromFile(fp);
+	fclose(fp);
+
+	if (v == NULL)
+		return -EINVAL;
 
-	if (count)
-		*count = n;
+	func(filename, v, user_data);
+	deleteVObject(v);
 
 	return 0;
 }
@@ -217,38 +199,43 @@ static gboolean read_dir(void *user_data)
 {
 	struct dummy_data *dummy = user_data;
 	GString *buffer;
-	DIR *dp;
-	uint16_t count = 0, max, offset;
-
-	buffer = g_string_new("");
+	uint16_t count = 0, part;
+	gboolean lastpart;
 
-	dp = opendir(dummy->folder);
-	if (dp == NULL) {
-		int err = errno;
-		DBG("opendir(): %s(%d)", strerror(err), err);
-		goto done;
-	}
+	dummy->id = 0;
 
 	/*
-	 * For PullPhoneBook function, the decision of returning the size
-	 * or contacts is made in the PBAP core. When MaxListCount is ZERO,
-	 * PCE wants to know the size of a given folder, PSE shall ignore all
-	 * other applicattion parameters that may be present in the request.
+	 * The size is reported at once. Contacts are serialized at most
+	 * VCARDS_PART_COUNT at a time, the next part is only produced when
+	 * the PBAP core asks for it with phonebook_pull_read.
 	 */
-	if (dummy->apparams->maxlistcount == 0) {
-		max = 0xffff;
-		offset = 0;
-	} else {
-		max = dummy->apparams->maxlistcount;
-		offset = dummy->apparams->liststartoffset;
+	if (dummy->apparams->maxlistcount == 0)
+		part = 0xffff;
+	else
+		part = VCARDS_PART_COUNT;
+
+	buffer = g_string_new("");
+
+	while (dummy->vcards && dummy->remaining > 0 && count < part) {
+		char *filename = dummy->vcards->data;
+
+		dummy->vcards = g_slist_delete_link(dummy->vcards,
+							dummy->vcards);
+
+		if (parse_vcard(dummy->dp, filename, entry_concat,
+							buffer) == 0) {
+			dummy->remaining--;
+			count++;
+		}
+
+		g_free(filename);
 	}
 
-	foreach_vcard(dp, entry_concat, offset, max, buffer, &count);
+	lastpart = (dummy->vcards == NULL || dummy->remaining == 0);
 
-	closedir(dp);
-done:
 	/* FIXME: Missing vCards fields filtering */
-	dummy->cb(buffer->str, buffer->len, count, 0, TRUE, dummy->user_data);
+	dummy->cb(buffer->str, buffer->len, count, 0, lastpart,
+							dummy->user_data);
 
 	g_string_free(buffer, TRUE);
 
@@ -257,7 +244,7 @@ done:
 
 static void entry_notify(const char *filename, VObject *v, void *user_data)
 {
-	struct cache_query *query = user_data;
+	struct dummy_data *dummy = user_data;
 	VObject *property, *subproperty;
 	GString *name;
 	const char *tel;
@@ -307,14 +294,17 @@ static void entry_notify(const char *filename, VObject *v, void *user_data)
 
 	tel = property ? fakeCString(vObjectUStringZValue(property)) : NULL;
 
-	query->entry_cb(filename, handle, name->str, NULL, tel,
-							query->user_data);
+	dummy->entry_cb(filename, handle, name->str, NULL, tel,
+							dummy->user_data);
 	g_string_free(name, TRUE);
 }
 
 static gboolean create_cache(void *user_data)
 {
-	struct cache_query *query = user_data;
+	struct dummy_data *dummy = user_data;
+	GSList *l;
+
+	dummy->id = 0;
 
 	/*
 	 * MaxListCount and ListStartOffset shall not be used
@@ -322,9 +312,10 @@ static gboolean create_cache(void *user_data)
 	 * PBAP core is responsible for consider these application
 	 * parameters before reply the entries.
 	 */
-	foreach_vcard(query->dp, entry_notify, 0, 0xffff, query, NULL);
+	for (l = dummy->vcards; l; l = l->next)
+		parse_vcard(dummy->dp, l->data, entry_notify, dummy);
 
-	query->ready_cb(query->user_data);
+	dummy->ready_cb(dummy->user_data);
 
 	return FALSE;
 }
@@ -335,6 +326,8 @@ static gboolean read_entry(void *user_data)
 	char buffer[1024];
 	ssize_t count;
 
+	dummy->id = 0;
+
 	memset(buffer, 0, sizeof(buffer));
 	count = read(dummy->fd, buffer, sizeof(buffer));
 
@@ -451,10 +444,13 @@ void phonebook_req_finalize(void *request)
 {
 	struct dummy_data *dummy = request;
 
-	/* dummy_data will be cleaned when request will be finished via
-	 * g_source_remove */
-	if (dummy && dummy->id)
+	if (!dummy)
+		return;
+
+	if (dummy->id)
 		g_source_remove(dummy->id);
+
+	dummy_free(dummy);
 }
 
 void *phonebook_pull(const char *name, const struct apparam_field *params,
@@ -462,6 +458,8 @@ void *phonebook_pull(const char *name, const struct apparam_field *params,
 {
 	struct dummy_data *dummy;
 	char *filename, *folder;
+	uint16_t offset;
+	DIR *dp;
 
 	/*
 	 * Main phonebook objects will be created dinamically based on the
@@ -487,12 +485,43 @@ void *phonebook_pull(const char *name, const struct apparam_field *params,
 		return NULL;
 	}
 
+	dp = opendir(folder);
+	g_free(folder);
+	if (dp == NULL) {
+		DBG("opendir(): %s(%d)", strerror(errno), errno);
+		if (err)
+			*err = -ENOENT;
+		return NULL;
+	}
+
 	dummy = g_new0(struct dummy_data, 1);
 	dummy->cb = cb;
 	dummy->user_data = user_data;
 	dummy->apparams = params;
-	dummy->folder = folder;
 	dummy->fd = -1;
+	dummy->dp = dp;
+	dummy->vcards = sorted_vcards(dp);
+
+	/*
+	 * For PullPhoneBook function, the decision of returning the size
+	 * or contacts is made in the PBAP core. When MaxListCount is ZERO,
+	 * PCE wants to know the size of a given folder, PSE shall ignore all
+	 * other applicattion parameters that may be present in the request.
+	 */
+	if (params->maxlistcount == 0) {
+		dummy->remaining = 0xffff;
+		offset = 0;
+	} else {
+		dummy->remaining = params->maxlistcount;
+		offset = params->liststartoffset;
+	}
+
+	/* Offset shall be based on the first entry of the phonebook */
+	for (; dummy->vcards && offset > 0; offset--) {
+		g_free(dummy->vcards->data);
+		dummy->vcards = g_slist_delete_link(dummy->vcards,
+							dummy->vcards);
+	}
 
 	if (err)
 		*err = 0;
@@ -507,8 +536,11 @@ int phonebook_pull_read(void *request)
 	if (!dummy)
 		return -ENOENT;
 
+	if (dummy->id)
+		return 0;
+
 	dummy->id = g_idle_add_full(G_PRIORITY_DEFAULT_IDLE, read_dir, dummy,
-								dummy_free);
+									NULL);
 
 	return 0;
 }
@@ -520,7 +552,6 @@ void *phonebook_get_entry(const char *folder, const char *id,
 	struct dummy_data *dummy;
 	char *filename;
 	int fd;
-	guint ret;
 
 	filename = g_build_filename(root_folder, folder, id, NULL);
 
@@ -538,22 +569,21 @@ void *phonebook_get_entry(const char *folder, const char *id,
 	dummy->apparams = params;
 	dummy->fd = fd;
 
-	ret = g_idle_add_full(G_PRIORITY_DEFAULT_IDLE, read_entry, dummy,
-								dummy_free);
+	dummy->id = g_idle_add_full(G_PRIORITY_DEFAULT_IDLE, read_entry,
+								dummy, NULL);
 
 	if (err)
 		*err = 0;
 
-	return GINT_TO_POINTER(ret);
+	return dummy;
 }
 
 void *phonebook_create_cache(const char *name, phonebook_entry_cb entry_cb,
 		phonebook_cache_ready_cb ready_cb, void *user_data, int *err)
 {
-	struct cache_query *query;
+	struct dummy_data *dummy;
 	char *foldername;
 	DIR *dp;
-	guint ret;
 
 	foldername = g_build_filename(root_folder, name, NULL);
 	dp = opendir(foldername);
@@ -566,17 +596,19 @@ void *phonebook_create_cache(const char *name, phonebook_entry_cb entry_cb,
 		return NULL;
 	}
 
-	query = g_new0(struct cache_query, 1);
-	query->entry_cb = entry_cb;
-	query->ready_cb = ready_cb;
-	query->user_data = user_data;
-	query->dp = dp;
+	dummy = g_new0(struct dummy_data, 1);
+	dummy->entry_cb = entry_cb;
+	dummy->ready_cb = ready_cb;
+	dummy->user_data = user_data;
+	dummy->fd = -1;
+	dummy->dp = dp;
+	dummy->vcards = sorted_vcards(dp);
 
-	ret = g_idle_add_full(G_PRIORITY_DEFAULT_IDLE, create_cache, query,
-								query_free);
+	dummy->id = g_idle_add_full(G_PRIORITY_DEFAULT_IDLE, create_cache,
+								dummy, NULL);
 
 	if (err)
 		*err = 0;
 
-	return GINT_TO_POINTER(ret);
+	return dummy;
 }
@@ -42,6 +42,8 @@
 #define QUERY_NAME "(contains \"given_name\" \"%s\")"
 #define QUERY_PHONE "(contains \"phone\" \"%s\")"
 
+#define VCARDS_PART_COUNT 50 /* amount of vcards sent at once to PBAP core */
+
 struct query_context {
 	const struct apparam_field *params;
 	phonebook_cb contacts_cb;
@@ -49,7 +51,8 @@ struct query_context {
 	phonebook_cache_ready_cb ready_cb;
 	EBookQuery *query;
 	unsigned int count;
-	GString *buf;
+	GSList *contacts;
+	guint part_id;
 	char *id;
 	unsigned queued_calls;
 	void *user_data;
@@ -100,8 +103,10 @@ static void free_query_context(struct query_context *data)
 {
 	g_free(data->id);
 
-	if (data->buf != NULL)
-		g_string_free(data->buf, TRUE);
+	if (data->part_id > 0)
+		g_source_remove(data->part_id);
+
+	g_slist_free_full(data->contacts, g_object_unref);
 
 	if (data->query != NULL)
 		e_book_query_unref(data->query);
@@ -157,6 +162,48 @@ static char *evcard_to_string(EVCard *evcard, unsigned int format,
 	return vcard;
 }
 
+static void send_pull_part(struct query_context *data)
+{
+	GString *buf;
+	unsigned int count;
+
+	buf = g_string_new("");
+
+	for (count = 0; data->contacts && count < VCARDS_PART_COUNT; count++) {
+		EVCard *evcard = E_VCARD(data->contacts->data);
+		char *vcard;
+
+		vcard = evcard_to_string(evcard, EVC_FORMAT_VCARD_30,
+						data->params->filter);
+
+		buf = g_string_append(buf, vcard);
+		buf = g_string_append(buf, "\r\n");
+		g_free(vcard);
+
+		g_object_unref(evcard);
+		data->contacts = g_slist_delete_link(data->contacts,
+								data->contacts);
+	}
+
+	DBG("sending %d vcards", count);
+
+	data->contacts_cb(buf->str, buf->len, count, 0,
+					data->contacts == NULL, data->user_data);
+
+	g_string_free(buf, TRUE);
+}
+
+static gboolean send_next_part(void *user_data)
+{
+	struct query_context *data = user_data;
+
+	data->part_id = 0;
+
+	send_pull_part(data);
+
+	return FALSE;
+}
+
 static void ebookpull_cb(EBook *book, const GError *gerr, GList *contacts,
 							void *user_data)
 {
@@ -189,19 +236,15 @@ static void ebookpull_cb(EBook *book, const GError *gerr, GList *contacts,
 
 	l = g_list_nth(contacts, data->params->liststartoffset);
 
+	/*
+	 * Contacts are only serialized when the PBAP core asks for them,
+	 * VCARDS_PART_COUNT at a time, so the vCards for the whole
+	 * phonebook never have to be held in memory at once.
+	 */
 	for (count = 0; l && count + data->count < maxcount; l = g_list_next(l),
-								count++) {
-		EContact *contact = E_CONTACT(l->data);
-		EVCard *evcard = E_VCARD(contact);
-		char *vcard;
-
-		vcard = evcard_to_string(evcard, EVC_FORMAT_VCARD_30,
-						data->params->filter);
-
-		data->buf = g_string_append(data->buf, vcard);
-		data->buf = g_string_append(data->buf, "\r\n");
-		g_free(vcard);
-	}
+								count++)
+		data->contacts = g_slist_prepend(data->contacts,
+						g_object_ref(l->data));
 
 	DBG("collected %d vcards", count);
 
@@ -211,14 +254,13 @@ static void ebookpull_cb(EBook *book, const GError *gerr, GList *contacts,
 
 done:
 	if (data->queued_calls == 0) {
-		GString *buf = data->buf;
-		data->buf = NULL;
-
-		data->contacts_cb(buf->str, buf->len, data->count,
-						0, TRUE, data->user_data);
-
-		g_string_free(buf, TRUE);
+		data->contacts = g_slist_reverse(data->contacts);
 
+		if (data->params->maxlistcount == 0)
+			data->contacts_cb(NULL, 0, data->count, 0, TRUE,
+							data->user_data);
+		else
+			send_pull_part(data);
 	}
 
 	return;
@@ -559,7 +601,6 @@ void *phonebook_pull(const char *name, const struct apparam_field *params,
 	data->contacts_cb = cb;
 	data->params = params;
 	data->user_data = user_data;
-	data->buf = g_string_new("");
 	data->query = e_book_query_any_field_contains("");
 	data->ebooks = open_ebooks();
 
@@ -577,6 +618,14 @@ int phonebook_pull_read(void *request)
 	if (!data)
 		return -ENOENT;
 
+	/* Contacts already fetched, only the next part is pending */
+	if (data->contacts != NULL) {
+		if (data->part_id == 0)
+			data->part_id = g_idle_add(send_next_part, data);
+
+		return 0;
+	}
+
 	for (l = data->ebooks; l != NULL; l = g_slist_next(l)) {
 		EBook *ebook = l->data;
 
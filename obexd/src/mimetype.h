@@ -24,6 +24,8 @@
 typedef gboolean (*obex_object_io_func) (void *object, int flags, int err,
 							void *user_data);
 
+typedef void (*obex_action_complete_func) (int err, void *user_data);
+
 struct obex_mime_type_driver {
 	const uint8_t *target;
 	unsigned int target_size;
@@ -38,8 +40,14 @@ struct obex_mime_type_driver {
 	ssize_t (*read) (void *object, void *buf, size_t count);
 	ssize_t (*write) (void *object, const void *buf, size_t count);
 	int (*flush) (void *object);
-	int (*copy) (const char *name, const char *destname);
-	int (*move) (const char *name, const char *destname);
+	/*
+	 * Returning -EINPROGRESS means the action goes on in the background
+	 * and func is called once with its result.
+	 */
+	int (*copy) (const char *name, const char *destname,
+			obex_action_complete_func func, void *user_data);
+	int (*move) (const char *name, const char *destname,
+			obex_action_complete_func func, void *user_data);
 	int (*remove) (const char *name);
 	int (*set_io_watch) (void *object, obex_object_io_func func,
 				void *user_data);
@@ -202,6 +202,13 @@ static void os_reset_session(struct obex_session *os)
 			os->driver->remove(os->path);
 	}
 
+	/* Removing the destination cancels a copy still in progress */
+	if (os->action_pending) {
+		os->action_pending = FALSE;
+		if (os->path && os->driver && os->driver->remove)
+			os->driver->remove(os->path);
+	}
+
 	if (os->service && os->service->reset)
 		os->service->reset(os, os->service_data);
 
@@ -1061,6 +1068,12 @@ static void cmd_action(GObex *obex, GObexPacket *req, gpointer user_data)
 	}
 
 	err = os->service->action(os, os->service_data);
+	if (err == -EINPROGRESS) {
+		/* Answered from action_complete() */
+		os->action_pending = TRUE;
+		return;
+	}
+
 done:
 	os_set_response(os, err);
 }
@@ -1180,26 +1193,75 @@ int obex_remove(struct obex_session *os, const char *path)
 	return os->driver->remove(path);
 }
 
+static void action_complete(int err, void *user_data)
+{
+	uint32_t id = GPOINTER_TO_UINT(user_data);
+	GSList *l;
+
+	for (l = sessions; l; l = l->next) {
+		struct obex_session *os = l->data;
+
+		if (os->id != id)
+			continue;
+
+		/* Aborted sessions have already been answered */
+		if (!os->action_pending)
+			return;
+
+		DBG("err %d", err);
+
+		os->action_pending = FALSE;
+		g_free(os->path);
+		os->path = NULL;
+
+		os_set_response(os, err);
+		return;
+	}
+}
+
+static int action_start(struct obex_session *os, const char *destination,
+									int err)
+{
+	if (err != -EINPROGRESS)
+		return err;
+
+	/* Kept so that the copy can be cancelled by removing it */
+	g_free(os->path);
+	os->path = g_strdup(destination);
+
+	return err;
+}
+
 int obex_copy(struct obex_session *os, const char *source,
 						const char *destination)
 {
+	int err;
+
 	if (os->driver == NULL || os->driver->copy == NULL)
 		return -ENOSYS;
 
 	DBG("%s %s", source, destination);
 
-	return os->driver->copy(source, destination);
+	err = os->driver->copy(source, destination, action_complete,
+						GUINT_TO_POINTER(os->id));
+
+	return action_start(os, destination, err);
 }
 
 int obex_move(struct obex_session *os, const char *source,
 						const char *destination)
 {
+	int err;
+
 	if (os->driver == NULL || os->driver->move == NULL)
 		return -ENOSYS;
 
 	DBG("%s %s", source, destination);
 
-	return os->driver->move(source, destination);
+	err = os->driver->move(source, destination, action_complete,
+						GUINT_TO_POINTER(os->id));
+
+	return action_start(os, destination, err);
 }
 
 uint8_t obex_get_action_id(struct obex_session *os)
@@ -395,10 +395,8 @@ static int hidp_add_connection(struct input_device *idev)
 	filename[PATH_MAX] = '\0';
 	sprintf(handle, "0x%8.8X", idev->handle);
 
-	key_file = g_key_file_new();
-	g_key_file_load_from_file(key_file, filename, 0, NULL);
+	key_file = storage_get(filename);
 	str = g_key_file_get_string(key_file, "ServiceRecords", handle, NULL);
-	g_key_file_free(key_file);
 
 	if (!str) {
 		error("Rejected connection from unknown device %s", dst_addr);
@@ -157,7 +157,7 @@ struct btd_adapter {
 	uint8_t discovery_enable;	/* discovery enabled/disabled */
 	bool discovery_suspended;	/* discovery has been suspended */
 	GSList *discovery_list;		/* list of discovery clients */
-	GSList *discovery_found;	/* list of found devices */
+	GHashTable *discovery_found;	/* found devices and last reports */
 	guint discovery_idle_timeout;	/* timeout between discovery runs */
 	guint passive_scan_timeout;	/* timeout between passive scans */
 	guint temp_devices_timeout;	/* timeout for temporary devices */
@@ -168,6 +168,8 @@ struct btd_adapter {
 	bool pincode_requested;		/* PIN requested during last bonding */
 	GSList *connections;		/* Connected devices */
 	GSList *devices;		/* Devices structure pointers */
+	GHashTable *devices_by_addr;	/* Devices indexed by address */
+	GHashTable *devices_by_path;	/* Devices indexed by object path */
 	GSList *connect_list;		/* Devices to connect when found */
 	struct btd_device *connect_le;	/* LE device waiting to be connected */
 	sdp_list_t *services;		/* Services associated to adapter */
@@ -691,25 +693,37 @@ int adapter_set_name(struct btd_adapter *adapter, const char *name)
 	return set_name(adapter, name);
 }
 
+static guint bdaddr_hash(gconstpointer key)
+{
+	const uint8_t *b = ((const bdaddr_t *) key)->b;
+
+	return (b[0] | b[1] << 8 | b[2] << 16 | (guint) b[3] << 24) ^
+							(b[4] | b[5] << 8);
+}
+
+static gboolean bdaddr_equal(gconstpointer a, gconstpointer b)
+{
+	return bacmp(a, b) == 0;
+}
+
 struct btd_device *adapter_find_device(struct btd_adapter *adapter,
 							const bdaddr_t *dst)
 {
-	struct btd_device *device;
-	char addr[18];
-	GSList *list;
-
 	if (!adapter)
 		return NULL;
 
-	ba2str(dst, addr);
-
-	list = g_slist_find_custom(adapter->devices, addr, device_address_cmp);
-	if (!list)
-		return NULL;
+	return g_hash_table_lookup(adapter->devices_by_addr, dst);
+}
 
-	device = list->data;
+static void adapter_add_device(struct btd_adapter *adapter,
+						struct btd_device *device)
+{
+	adapter->devices = g_slist_append(adapter->devices, device);
 
-	return device;
+	g_hash_table_insert(adapter->devices_by_addr,
+				(gpointer) device_get_address(device), device);
+	g_hash_table_insert(adapter->devices_by_path,
+				(gpointer) device_get_path(device), device);
 }
 
 static void uuid_to_uuid128(uuid_t *uuid128, const uuid_t *uuid)
@@ -1015,7 +1029,7 @@ static struct btd_device *adapter_create_device(struct btd_adapter *adapter,
 
 	device_set_temporary(device, TRUE);
 
-	adapter->devices = g_slist_append(adapter->devices, device);
+	adapter_add_device(adapter, device);
 
 	return device;
 }
@@ -1045,9 +1059,10 @@ static void adapter_remove_device(struct btd_adapter *adapter,
 	adapter->connect_list = g_slist_remove(adapter->connect_list, dev);
 
 	adapter->devices = g_slist_remove(adapter->devices, dev);
+	g_hash_table_remove(adapter->devices_by_addr, device_get_address(dev));
+	g_hash_table_remove(adapter->devices_by_path, device_get_path(dev));
 
-	adapter->discovery_found = g_slist_remove(adapter->discovery_found,
-									dev);
+	g_hash_table_remove(adapter->discovery_found, dev);
 
 	adapter->connections = g_slist_remove(adapter->connections, dev);
 
@@ -1504,17 +1519,17 @@ static int compare_sender(gconstpointer a, gconstpointer b)
 	return g_strcmp0(client->owner, sender);
 }
 
-static void invalidate_rssi(gpointer a)
+static void invalidate_rssi(gpointer key, gpointer value, gpointer user_data)
 {
-	struct btd_device *dev = a;
+	struct btd_device *dev = key;
 
 	device_set_rssi(dev, 0);
 }
 
 static void discovery_cleanup(struct btd_adapter *adapter)
 {
-	g_slist_free_full(adapter->discovery_found, invalidate_rssi);
-	adapter->discovery_found = NULL;
+	g_hash_table_foreach(adapter->discovery_found, invalidate_rssi, NULL);
+	g_hash_table_remove_all(adapter->discovery_found);
 }
 
 static gboolean remove_temp_devices(gpointer user_data)
@@ -2127,36 +2142,24 @@ static gboolean property_get_modalias(const GDBusPropertyTable *property,
 	return TRUE;
 }
 
-static int device_path_cmp(gconstpointer a, gconstpointer b)
-{
-	const struct btd_device *device = a;
-	const char *path = b;
-	const char *dev_path = device_get_path(device);
-
-	return strcasecmp(dev_path, path);
-}
-
 static DBusMessage *remove_device(DBusConnection *conn,
 					DBusMessage *msg, void *user_data)
 {
 	struct btd_adapter *adapter = user_data;
 	struct btd_device *device;
 	const char *path;
-	GSList *list;
 
 	if (dbus_message_get_args(msg, NULL, DBUS_TYPE_OBJECT_PATH, &path,
 						DBUS_TYPE_INVALID) == FALSE)
 		return btd_error_invalid_args(msg);
 
-	list = g_slist_find_custom(adapter->devices, path, device_path_cmp);
-	if (!list)
+	device = g_hash_table_lookup(adapter->devices_by_path, path);
+	if (!device)
 		return btd_error_does_not_exist(msg);
 
 	if (!(adapter->current_settings & MGMT_SETTING_POWERED))
 		return btd_error_not_ready(msg);
 
-	device = list->data;
-
 	device_set_temporary(device, TRUE);
 
 	if (!device_is_connected(device)) {
@@ -2502,7 +2505,7 @@ static void load_devices(struct btd_adapter *adapter)
 		GKeyFile *key_file;
 		struct link_key_info *key_info;
 		struct smp_ltk_info *ltk_info;
-		GSList *list;
+		bdaddr_t bdaddr;
 
 		if (entry->d_type != DT_DIR || bachk(entry->d_name) < 0)
 			continue;
@@ -2510,8 +2513,7 @@ static void load_devices(struct btd_adapter *adapter)
 		snprintf(filename, PATH_MAX, STORAGEDIR "/%s/%s/info", srcaddr,
 				entry->d_name);
 
-		key_file = g_key_file_new();
-		g_key_file_load_from_file(key_file, filename, 0, NULL);
+		key_file = storage_get(filename);
 
 		key_info = get_key_info(key_file, entry->d_name);
 		if (key_info)
@@ -2521,20 +2523,19 @@ static void load_devices(struct btd_adapter *adapter)
 		if (ltk_info)
 			ltks.keys = g_slist_append(ltks.keys, ltk_info);
 
-		list = g_slist_find_custom(adapter->devices, entry->d_name,
-							device_address_cmp);
-		if (list) {
-			device = list->data;
+		str2ba(entry->d_name, &bdaddr);
+
+		device = adapter_find_device(adapter, &bdaddr);
+		if (device)
 			goto device_exist;
-		}
 
 		device = device_create_from_storage(adapter, entry->d_name,
 							key_file);
 		if (!device)
-			goto free;
+			continue;
 
 		device_set_temporary(device, FALSE);
-		adapter->devices = g_slist_append(adapter->devices, device);
+		adapter_add_device(adapter, device);
 
 		/* TODO: register services from pre-loaded list of primaries */
 
@@ -2547,9 +2548,6 @@ device_exist:
 			device_set_paired(device, TRUE);
 			device_set_bonded(device, TRUE);
 		}
-
-free:
-		g_key_file_free(key_file);
 	}
 
 	closedir(dir);
@@ -2936,6 +2934,10 @@ static void adapter_free(gpointer user_data)
 	g_queue_foreach(adapter->auths, free_service_auth, NULL);
 	g_queue_free(adapter->auths);
 
+	g_hash_table_destroy(adapter->discovery_found);
+	g_hash_table_destroy(adapter->devices_by_addr);
+	g_hash_table_destroy(adapter->devices_by_path);
+
 	/*
 	 * Unregister all handlers for this specific index since
 	 * the adapter bound to them is no longer valid.
@@ -3946,6 +3948,11 @@ static struct btd_adapter *btd_adapter_new(uint16_t index)
 
 	adapter->auths = g_queue_new();
 
+	adapter->devices_by_addr = g_hash_table_new(bdaddr_hash, bdaddr_equal);
+	adapter->devices_by_path = g_hash_table_new(g_str_hash, g_str_equal);
+	adapter->discovery_found = g_hash_table_new_full(NULL, NULL, NULL,
+									g_free);
+
 	return btd_adapter_ref(adapter);
 }
 
@@ -3970,6 +3977,9 @@ static void adapter_remove(struct btd_adapter *adapter)
 	g_slist_free(adapter->connect_list);
 	adapter->connect_list = NULL;
 
+	g_hash_table_remove_all(adapter->devices_by_addr);
+	g_hash_table_remove_all(adapter->devices_by_path);
+
 	for (l = adapter->devices; l; l = l->next)
 		device_remove(l->data, FALSE);
 
@@ -4079,6 +4089,64 @@ static void confirm_name(struct btd_adapter *adapter, const bdaddr_t *bdaddr,
 						confirm_name_timeout, adapter);
 }
 
+struct found_report {
+	uint32_t hash;
+	uint8_t len;
+	uint8_t data[UINT8_MAX];
+	int8_t rssi;
+	gint64 time;
+};
+
+static uint32_t report_hash(const uint8_t *data, uint8_t len)
+{
+	uint32_t hash = 2166136261u;
+	uint8_t i;
+
+	for (i = 0; i < len; i++) {
+		hash ^= data[i];
+		hash *= 16777619u;
+	}
+
+	return hash;
+}
+
+static void set_found_report(struct found_report *report, int8_t rssi,
+					const uint8_t *data, uint8_t data_len)
+{
+	report->hash = report_hash(data, data_len);
+	report->len = data_len;
+	memcpy(report->data, data, data_len);
+	report->rssi = rssi;
+	report->time = g_get_monotonic_time();
+}
+
+/*
+ * Reports repeating the data of the last processed one are dropped unless
+ * the RSSI moved beyond the configured threshold and the minimum report
+ * interval has passed.
+ */
+static bool found_report_unchanged(const struct found_report *report,
+					int8_t rssi, const uint8_t *data,
+					uint8_t data_len)
+{
+	gint64 elapsed;
+
+	/* The hash only saves comparing reports that differ */
+	if (report->len != data_len ||
+				report->hash != report_hash(data, data_len))
+		return false;
+
+	if (memcmp(report->data, data, data_len))
+		return false;
+
+	if (abs(report->rssi - rssi) <= main_opts.rssi_threshold)
+		return true;
+
+	elapsed = g_get_monotonic_time() - report->time;
+
+	return elapsed < (gint64) main_opts.report_interval * 1000;
+}
+
 static void update_found_devices(struct btd_adapter *adapter,
 					const bdaddr_t *bdaddr,
 					uint8_t bdaddr_type, int8_t rssi,
@@ -4086,12 +4154,22 @@ static void update_found_devices(struct btd_adapter *adapter,
 					const uint8_t *data, uint8_t data_len)
 {
 	struct btd_device *dev;
+	struct found_report *report;
 	struct eir_data eir_data;
 	char addr[18];
 	int err;
-	GSList *list;
 	bool name_known;
 
+	dev = adapter_find_device(adapter, bdaddr);
+
+	/* Skip parsing and signalling for repeated reports */
+	if (dev && adapter->discovery_list) {
+		report = g_hash_table_lookup(adapter->discovery_found, dev);
+		if (report && found_report_unchanged(report, rssi, data,
+								data_len))
+			return;
+	}
+
 	memset(&eir_data, 0, sizeof(eir_data));
 	err = eir_parse(&eir_data, data, data_len);
 	if (err < 0) {
@@ -4108,8 +4186,7 @@ static void update_found_devices(struct btd_adapter *adapter,
 
 	ba2str(bdaddr, addr);
 
-	list = g_slist_find_custom(adapter->devices, bdaddr, device_bdaddr_cmp);
-	if (!list) {
+	if (!dev) {
 		/*
 		 * If no client has requested discovery, then do not
 		 * create new device objects.
@@ -4120,8 +4197,7 @@ static void update_found_devices(struct btd_adapter *adapter,
 		}
 
 		dev = adapter_create_device(adapter, bdaddr, bdaddr_type);
-	} else
-		dev = list->data;
+	}
 
 	if (!dev) {
 		error("Unable to create object for found device %s", addr);
@@ -4170,14 +4246,18 @@ static void update_found_devices(struct btd_adapter *adapter,
 	if (!adapter->discovery_list)
 		goto connect_le;
 
-	if (g_slist_find(adapter->discovery_found, dev))
+	report = g_hash_table_lookup(adapter->discovery_found, dev);
+	if (report) {
+		set_found_report(report, rssi, data, data_len);
 		return;
+	}
 
 	if (confirm)
 		confirm_name(adapter, bdaddr, bdaddr_type, name_known);
 
-	adapter->discovery_found = g_slist_prepend(adapter->discovery_found,
-									dev);
+	report = g_new0(struct found_report, 1);
+	set_found_report(report, rssi, data, data_len);
+	g_hash_table_insert(adapter->discovery_found, dev, report);
 
 	return;
 
@@ -5216,9 +5296,7 @@ static void store_link_key(struct btd_adapter *adapter,
 	char device_addr[18];
 	char filename[PATH_MAX + 1];
 	GKeyFile *key_file;
-	gsize length = 0;
 	char key_str[35];
-	char *str;
 	int i;
 
 	ba2str(adapter_get_address(adapter), adapter_addr);
@@ -5228,8 +5306,7 @@ static void store_link_key(struct btd_adapter *adapter,
 								device_addr);
 	filename[PATH_MAX] = '\0';
 
-	key_file = g_key_file_new();
-	g_key_file_load_from_file(key_file, filename, 0, NULL);
+	key_file = storage_get(filename);
 
 	key_str[0] = '0';
 	key_str[1] = 'x';
@@ -5241,13 +5318,7 @@ static void store_link_key(struct btd_adapter *adapter,
 	g_key_file_set_integer(key_file, "LinkKey", "Type", type);
 	g_key_file_set_integer(key_file, "LinkKey", "PINLength", pin_length);
 
-	create_file(filename, S_IRUSR | S_IWUSR);
-
-	str = g_key_file_to_data(key_file, &length, NULL);
-	g_file_set_contents(filename, str, length, NULL);
-	g_free(str);
-
-	g_key_file_free(key_file);
+	storage_commit(filename);
 }
 
 static void new_link_key_callback(uint16_t index, uint16_t length,
@@ -5308,8 +5379,6 @@ static void store_longtermkey(const bdaddr_t *local, const bdaddr_t *peer,
 	GKeyFile *key_file;
 	char key_str[35];
 	char rand_str[19];
-	gsize length = 0;
-	char *str;
 	int i;
 
 	ba2str(local, adapter_addr);
@@ -5319,8 +5388,7 @@ static void store_longtermkey(const bdaddr_t *local, const bdaddr_t *peer,
 								device_addr);
 	filename[PATH_MAX] = '\0';
 
-	key_file = g_key_file_new();
-	g_key_file_load_from_file(key_file, filename, 0, NULL);
+	key_file = storage_get(filename);
 
 	key_str[0] = '0';
 	key_str[1] = 'x';
@@ -5342,13 +5410,7 @@ static void store_longtermkey(const bdaddr_t *local, const bdaddr_t *peer,
 
 	g_key_file_set_string(key_file, "LongTermKey", "Rand", rand_str);
 
-	create_file(filename, S_IRUSR | S_IWUSR);
-
-	str = g_key_file_to_data(key_file, &length, NULL);
-	g_file_set_contents(filename, str, length, NULL);
-	g_free(str);
-
-	g_key_file_free(key_file);
+	storage_commit(filename);
 }
 
 static void new_long_term_key_callback(uint16_t index, uint16_t length,
@@ -62,7 +62,8 @@ struct gatt_server {
 	GIOChannel *le_io;
 	uint32_t gatt_sdp_handle;
 	uint32_t gap_sdp_handle;
-	GList *database;
+	GPtrArray *database;		/* Attributes sorted by handle */
+	GHashTable *responses;		/* Cached discovery responses */
 	GSList *clients;
 	uint16_t name_handle;
 	uint16_t appearance_handle;
@@ -81,11 +82,13 @@ struct gatt_channel {
 	struct btd_device *device;
 };
 
-struct group_elem {
-	uint16_t handle;
-	uint16_t end;
-	uint8_t *data;
+/* Cached responses are dropped all at once beyond this */
+#define MAX_CACHED_RESPONSES	64
+
+struct cached_response {
+	gint64 key;
 	uint16_t len;
+	uint8_t pdu[0];
 };
 
 static bt_uuid_t prim_uuid = {
@@ -109,6 +112,54 @@ static void attrib_free(void *data)
 	g_free(a);
 }
 
+static gint64 response_key(uint8_t opcode, uint16_t start, uint16_t end,
+					const bt_uuid_t *uuid, size_t len)
+{
+	gint64 key;
+
+	key = (gint64) opcode << 48 | (gint64) start << 32 |
+					(gint64) end << 16 | MIN(len, 0xffff);
+
+	/* Only primary and secondary service groups are ever cached */
+	if (uuid && bt_uuid_cmp(uuid, &snd_uuid) == 0)
+		key |= (gint64) 1 << 56;
+
+	return key;
+}
+
+static uint16_t get_cached_response(struct gatt_server *server, gint64 key,
+						uint8_t *pdu, size_t len)
+{
+	struct cached_response *rsp;
+
+	rsp = g_hash_table_lookup(server->responses, &key);
+	if (rsp == NULL || rsp->len > len)
+		return 0;
+
+	memcpy(pdu, rsp->pdu, rsp->len);
+
+	return rsp->len;
+}
+
+static void cache_response(struct gatt_server *server, gint64 key,
+					const uint8_t *pdu, uint16_t len)
+{
+	struct cached_response *rsp;
+
+	if (len == 0)
+		return;
+
+	if (g_hash_table_size(server->responses) >= MAX_CACHED_RESPONSES)
+		g_hash_table_remove_all(server->responses);
+
+	rsp = g_malloc(sizeof(*rsp) + len);
+	rsp->key = key;
+	rsp->len = len;
+	memcpy(rsp->pdu, pdu, len);
+
+	g_hash_table_replace(server->responses, &rsp->key, rsp);
+}
+
 static void channel_free(struct gatt_channel *channel)
 {
 
@@ -124,7 +175,8 @@ static void channel_free(struct gatt_channel *channel)
 
 static void gatt_server_free(struct gatt_server *server)
 {
-	g_list_free_full(server->database, attrib_free);
+	g_ptr_array_free(server->database, TRUE);
+	g_hash_table_destroy(server->responses);
 
 	if (server->l2cap_io != NULL) {
 		g_io_channel_shutdown(server->l2cap_io, FALSE, NULL);
@@ -241,50 +293,72 @@ static sdp_record_t *server_record_new(uuid_t *uuid, uint16_t start, uint16_t en
 	return record;
 }
 
-static int handle_cmp(gconstpointer a, gconstpointer b)
+/* Index of the first attribute with a handle greater or equal to handle */
+static guint db_lower_bound(GPtrArray *database, uint16_t handle)
 {
-	const struct attribute *attrib = a;
-	uint16_t handle = GPOINTER_TO_UINT(b);
+	guint low = 0, high = database->len;
 
-	return attrib->handle - handle;
+	while (low < high) {
+		guint mid = low + (high - low) / 2;
+		struct attribute *a = g_ptr_array_index(database, mid);
+
+		if (a->handle < handle)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+
+	return low;
 }
 
-static int attribute_cmp(gconstpointer a1, gconstpointer a2)
+static struct attribute *find_attribute(GPtrArray *database, uint16_t handle,
+								guint *index)
 {
-	const struct attribute *attrib1 = a1;
-	const struct attribute *attrib2 = a2;
+	struct attribute *a;
+	guint i;
+
+	i = db_lower_bound(database, handle);
+	if (i == database->len)
+		return NULL;
+
+	a = g_ptr_array_index(database, i);
+	if (a->handle != handle)
+		return NULL;
 
-	return attrib1->handle - attrib2->handle;
+	if (index)
+		*index = i;
+
+	return a;
+}
+
+static gboolean is_service(struct attribute *a)
+{
+	return bt_uuid_cmp(&a->uuid, &prim_uuid) == 0 ||
+					bt_uuid_cmp(&a->uuid, &snd_uuid) == 0;
 }
 
 static struct attribute *find_svc_range(struct gatt_server *server,
 					uint16_t start, uint16_t *end)
 {
 	struct attribute *attrib;
-	guint h = start;
-	GList *l;
+	guint i;
 
 	if (end == NULL)
 		return NULL;
 
-	l = g_list_find_custom(server->database, GUINT_TO_POINTER(h),
-								handle_cmp);
-	if (!l)
+	attrib = find_attribute(server->database, start, &i);
+	if (!attrib)
 		return NULL;
 
-	attrib = l->data;
-
-	if (bt_uuid_cmp(&attrib->uuid, &prim_uuid) != 0 &&
-			bt_uuid_cmp(&attrib->uuid, &snd_uuid) != 0)
+	if (!is_service(attrib))
 		return NULL;
 
 	*end = start;
 
-	for (l = l->next; l; l = l->next) {
-		struct attribute *a = l->data;
+	for (i++; i < server->database->len; i++) {
+		struct attribute *a = g_ptr_array_index(server->database, i);
 
-		if (bt_uuid_cmp(&a->uuid, &prim_uuid) == 0 ||
-				bt_uuid_cmp(&a->uuid, &snd_uuid) == 0)
+		if (is_service(a))
 			break;
 
 		*end = a->handle;
@@ -339,14 +413,18 @@ static struct attribute *attrib_db_add_new(struct gatt_server *server,
 				int read_req, int write_req,
 				const uint8_t *value, size_t len)
 {
+	GPtrArray *database = server->database;
 	struct attribute *a;
-	guint h = handle;
+	guint i;
 
 	DBG("handle=0x%04x", handle);
 
-	if (g_list_find_custom(server->database, GUINT_TO_POINTER(h),
-								handle_cmp))
-		return NULL;
+	i = db_lower_bound(database, handle);
+	if (i < database->len) {
+		a = g_ptr_array_index(database, i);
+		if (a->handle == handle)
+			return NULL;
+	}
 
 	a = g_new0(struct attribute, 1);
 	a->len = len;
@@ -356,8 +434,13 @@ static struct attribute *attrib_db_add_new(struct gatt_server *server,
 	a->read_req = read_req;
 	a->write_req = write_req;
 
-	server->database = g_list_insert_sorted(server->database, a,
-								attribute_cmp);
+	/* Make room at the insertion point to keep the array sorted */
+	g_ptr_array_add(database, NULL);
+	memmove(&database->pdata[i + 1], &database->pdata[i],
+				(database->len - i - 1) * sizeof(gpointer));
+	database->pdata[i] = a;
+
+	g_hash_table_remove_all(server->responses);
 
 	return a;
 }
@@ -400,14 +483,15 @@ static uint16_t read_by_group(struct gatt_channel *channel, uint16_t start,
 						uint16_t end, bt_uuid_t *uuid,
 						uint8_t *pdu, size_t len)
 {
-	struct att_data_list *adl;
+	struct att_writer writer;
 	struct attribute *a;
-	struct group_elem *cur, *old = NULL;
-	GSList *l, *groups;
-	GList *dl, *database;
-	uint16_t length, last_handle, last_size = 0;
+	uint8_t *cur = NULL, *old = NULL;
+	GPtrArray *database;
+	uint16_t length, last_handle;
+	gboolean cacheable = TRUE;
 	uint8_t status;
-	int i;
+	gint64 key;
+	guint idx;
 
 	if (start > end || start == 0x0000)
 		return enc_error_resp(ATT_OP_READ_BY_GROUP_REQ, start,
@@ -423,22 +507,25 @@ static uint16_t read_by_group(struct gatt_channel *channel, uint16_t start,
 		return enc_error_resp(ATT_OP_READ_BY_GROUP_REQ, 0x0000,
 					ATT_ECODE_UNSUPP_GRP_TYPE, pdu, len);
 
+	key = response_key(ATT_OP_READ_BY_GROUP_REQ, start, end, uuid, len);
+	length = get_cached_response(channel->server, key, pdu, len);
+	if (length > 0)
+		return length;
+
 	last_handle = end;
 	database = channel->server->database;
-	for (dl = database, groups = NULL, cur = NULL; dl; dl = dl->next) {
-
-		a = dl->data;
+	idx = db_lower_bound(database, start);
+	for (; idx < database->len; idx++) {
+		uint8_t *entry;
 
-		if (a->handle < start)
-			continue;
+		a = g_ptr_array_index(database, idx);
 
 		if (a->handle >= end)
 			break;
 
 		/* The old group ends when a new one starts */
-		if (old && (bt_uuid_cmp(&a->uuid, &prim_uuid) == 0 ||
-				bt_uuid_cmp(&a->uuid, &snd_uuid) == 0)) {
-			old->end = last_handle;
+		if (old && is_service(a)) {
+			att_put_u16(last_handle, &old[2]);
 			old = NULL;
 		}
 
@@ -449,7 +536,16 @@ static uint16_t read_by_group(struct gatt_channel *channel, uint16_t start,
 			continue;
 		}
 
-		if (last_size && (last_size != a->len))
+		if (cur == NULL) {
+			if (!enc_read_by_grp_resp_init(&writer, a->len + 4,
+								pdu, len))
+				return 0;
+		} else if (writer.elen != a->len + 4)
+			break;
+
+		/* No more groups fit, only the end of the last one matters */
+		entry = att_writer_next(&writer);
+		if (entry == NULL)
 			break;
 
 		status = att_check_reqs(channel, ATT_OP_READ_BY_GROUP_REQ,
@@ -459,60 +555,36 @@ static uint16_t read_by_group(struct gatt_channel *channel, uint16_t start,
 			status = a->read_cb(a, channel->device,
 							a->cb_user_data);
 
-		if (status) {
-			g_slist_free_full(groups, g_free);
+		if (status)
 			return enc_error_resp(ATT_OP_READ_BY_GROUP_REQ,
 						a->handle, status, pdu, len);
-		}
 
-		cur = g_new0(struct group_elem, 1);
-		cur->handle = a->handle;
-		cur->data = a->data;
-		cur->len = a->len;
+		/* Only responses that don't depend on the client are kept */
+		if (a->read_req != ATT_NONE || a->read_cb)
+			cacheable = FALSE;
 
 		/* Attribute Grouping Type found */
-		groups = g_slist_append(groups, cur);
+		att_put_u16(a->handle, entry);
+		att_put_u16(a->handle, &entry[2]);
+		memcpy(&entry[4], a->data, a->len);
 
-		last_size = a->len;
-		old = cur;
-		last_handle = cur->handle;
+		old = cur = entry;
+		last_handle = a->handle;
 	}
 
-	if (groups == NULL)
+	if (cur == NULL)
 		return enc_error_resp(ATT_OP_READ_BY_GROUP_REQ, start,
 					ATT_ECODE_ATTR_NOT_FOUND, pdu, len);
 
-	if (dl == NULL)
-		cur->end = a->handle;
+	if (idx == database->len)
+		att_put_u16(a->handle, &cur[2]);
 	else
-		cur->end = last_handle;
+		att_put_u16(last_handle, &cur[2]);
 
-	length = g_slist_length(groups);
+	length = writer.offset;
 
-	adl = att_data_list_alloc(length, last_size + 4);
-	if (adl == NULL) {
-		g_slist_free_full(groups, g_free);
-		return enc_error_resp(ATT_OP_READ_BY_GROUP_REQ, start,
-					ATT_ECODE_UNLIKELY, pdu, len);
-	}
-
-	for (i = 0, l = groups; l; l = l->next, i++) {
-		uint8_t *value;
-
-		cur = l->data;
-
-		value = (void *) adl->data[i];
-
-		att_put_u16(cur->handle, value);
-		att_put_u16(cur->end, &value[2]);
-		/* Attribute Value */
-		memcpy(&value[4], cur->data, cur->len);
-	}
-
-	length = enc_read_by_grp_resp(adl, pdu, len);
-
-	att_data_list_free(adl);
-	g_slist_free_full(groups, g_free);
+	if (cacheable)
+		cache_response(channel->server, key, pdu, length);
 
 	return length;
 }
@@ -521,25 +593,24 @@ static uint16_t read_by_type(struct gatt_channel *channel, uint16_t start,
 						uint16_t end, bt_uuid_t *uuid,
 						uint8_t *pdu, size_t len)
 {
-	struct att_data_list *adl;
-	GSList *l, *types;
-	GList *dl, *database;
+	struct att_writer writer;
+	GPtrArray *database;
 	struct attribute *a;
-	uint16_t num, length;
+	uint16_t length = 0;
+	gboolean found = FALSE;
 	uint8_t status;
-	int i;
+	guint idx;
 
 	if (start > end || start == 0x0000)
 		return enc_error_resp(ATT_OP_READ_BY_TYPE_REQ, start,
 					ATT_ECODE_INVALID_HANDLE, pdu, len);
 
 	database = channel->server->database;
-	for (dl = database, length = 0, types = NULL; dl; dl = dl->next) {
-
-		a = dl->data;
+	idx = db_lower_bound(database, start);
+	for (; idx < database->len; idx++) {
+		uint8_t *entry;
 
-		if (a->handle < start)
-			continue;
+		a = g_ptr_array_index(database, idx);
 
 		if (a->handle > end)
 			break;
@@ -554,134 +625,105 @@ static uint16_t read_by_type(struct gatt_channel *channel, uint16_t start,
 			status = a->read_cb(a, channel->device,
 							a->cb_user_data);
 
-		if (status) {
-			g_slist_free(types);
+		if (status)
 			return enc_error_resp(ATT_OP_READ_BY_TYPE_REQ,
 						a->handle, status, pdu, len);
-		}
 
 		/* All elements must have the same length */
-		if (length == 0)
+		if (!found) {
+			/* Handle length plus attribute value length */
+			if (!enc_read_by_type_resp_init(&writer, a->len + 2,
+								pdu, len))
+				return 0;
+
 			length = a->len;
-		else if (a->len != length)
+			found = TRUE;
+		} else if (a->len != length)
 			break;
 
-		types = g_slist_append(types, a);
-	}
-
-	if (types == NULL)
-		return enc_error_resp(ATT_OP_READ_BY_TYPE_REQ, start,
-					ATT_ECODE_ATTR_NOT_FOUND, pdu, len);
-
-	num = g_slist_length(types);
-
-	/* Handle length plus attribute value length */
-	length += 2;
-
-	adl = att_data_list_alloc(num, length);
-	if (adl == NULL) {
-		g_slist_free(types);
-		return enc_error_resp(ATT_OP_READ_BY_TYPE_REQ, start,
-					ATT_ECODE_UNLIKELY, pdu, len);
-	}
-
-	for (i = 0, l = types; l; i++, l = l->next) {
-		uint8_t *value;
-
-		a = l->data;
-
-		value = (void *) adl->data[i];
+		/* Stop once the response is full */
+		entry = att_writer_next(&writer);
+		if (entry == NULL)
+			break;
 
-		att_put_u16(a->handle, value);
+		att_put_u16(a->handle, entry);
 
 		/* Attribute Value */
-		memcpy(&value[2], a->data, a->len);
+		memcpy(&entry[2], a->data, writer.elen - 2);
 	}
 
-	length = enc_read_by_type_resp(adl, pdu, len);
-
-	att_data_list_free(adl);
-	g_slist_free(types);
+	if (!found)
+		return enc_error_resp(ATT_OP_READ_BY_TYPE_REQ, start,
+					ATT_ECODE_ATTR_NOT_FOUND, pdu, len);
 
-	return length;
+	return writer.offset;
 }
 
 static uint16_t find_info(struct gatt_channel *channel, uint16_t start,
 				uint16_t end, uint8_t *pdu, size_t len)
 {
+	struct att_writer writer;
 	struct attribute *a;
-	struct att_data_list *adl;
-	GSList *l, *info;
-	GList *dl, *database;
+	GPtrArray *database;
 	uint8_t format, last_type = BT_UUID_UNSPEC;
-	uint16_t length, num;
-	int i;
+	uint16_t length;
+	guint idx;
+	gint64 key;
 
 	if (start > end || start == 0x0000)
 		return enc_error_resp(ATT_OP_FIND_INFO_REQ, start,
 					ATT_ECODE_INVALID_HANDLE, pdu, len);
 
+	key = response_key(ATT_OP_FIND_INFO_REQ, start, end, NULL, len);
+	length = get_cached_response(channel->server, key, pdu, len);
+	if (length > 0)
+		return length;
+
 	database = channel->server->database;
-	for (dl = database, info = NULL, num = 0; dl; dl = dl->next) {
-		a = dl->data;
+	idx = db_lower_bound(database, start);
+	for (; idx < database->len; idx++) {
+		uint8_t *entry;
 
-		if (a->handle < start)
-			continue;
+		a = g_ptr_array_index(database, idx);
 
 		if (a->handle > end)
 			break;
 
-		if (last_type == BT_UUID_UNSPEC)
+		if (last_type == BT_UUID_UNSPEC) {
 			last_type = a->uuid.type;
 
+			if (last_type == BT_UUID16)
+				format = ATT_FIND_INFO_RESP_FMT_16BIT;
+			else if (last_type == BT_UUID128)
+				format = ATT_FIND_INFO_RESP_FMT_128BIT;
+			else
+				return 0;
+
+			if (!enc_find_info_resp_init(&writer, format, pdu, len))
+				return 0;
+		}
+
 		if (a->uuid.type != last_type)
 			break;
 
-		info = g_slist_append(info, a);
-		num++;
-
-		last_type = a->uuid.type;
-	}
+		/* Stop once the response is full */
+		entry = att_writer_next(&writer);
+		if (entry == NULL)
+			break;
 
-	if (info == NULL)
-		return enc_error_resp(ATT_OP_FIND_INFO_REQ, start,
-					ATT_ECODE_ATTR_NOT_FOUND, pdu, len);
+		att_put_u16(a->handle, entry);
 
-	if (last_type == BT_UUID16) {
-		length = 2;
-		format = 0x01;
-	} else if (last_type == BT_UUID128) {
-		length = 16;
-		format = 0x02;
-	} else {
-		g_slist_free(info);
-		return 0;
+		/* Attribute Value */
+		att_put_uuid(a->uuid, &entry[2]);
 	}
 
-	adl = att_data_list_alloc(num, length + 2);
-	if (adl == NULL) {
-		g_slist_free(info);
+	if (last_type == BT_UUID_UNSPEC)
 		return enc_error_resp(ATT_OP_FIND_INFO_REQ, start,
-					ATT_ECODE_UNLIKELY, pdu, len);
-	}
-
-	for (i = 0, l = info; l; i++, l = l->next) {
-		uint8_t *value;
-
-		a = l->data;
-
-		value = (void *) adl->data[i];
-
-		att_put_u16(a->handle, value);
-
-		/* Attribute Value */
-		att_put_uuid(a->uuid, &value[2]);
-	}
+					ATT_ECODE_ATTR_NOT_FOUND, pdu, len);
 
-	length = enc_find_info_resp(format, adl, pdu, len);
+	length = writer.offset;
 
-	att_data_list_free(adl);
-	g_slist_free(info);
+	cache_response(channel->server, key, pdu, length);
 
 	return length;
 }
@@ -691,23 +733,25 @@ static uint16_t find_by_type(struct gatt_channel *channel, uint16_t start,
 				const uint8_t *value, size_t vlen,
 				uint8_t *opdu, size_t mtu)
 {
+	struct att_writer writer;
 	struct attribute *a;
-	struct att_range *range;
-	GSList *matches;
-	GList *dl, *database;
-	uint16_t len;
+	GPtrArray *database;
+	uint8_t *range;
+	gboolean found = FALSE;
+	guint idx;
 
 	if (start > end || start == 0x0000)
 		return enc_error_resp(ATT_OP_FIND_BY_TYPE_REQ, start,
 					ATT_ECODE_INVALID_HANDLE, opdu, mtu);
 
+	if (!enc_find_by_type_resp_init(&writer, opdu, mtu))
+		return 0;
+
 	/* Searching first requested handle number */
 	database = channel->server->database;
-	for (dl = database, matches = NULL, range = NULL; dl; dl = dl->next) {
-		a = dl->data;
-
-		if (a->handle < start)
-			continue;
+	idx = db_lower_bound(database, start);
+	for (range = NULL; idx < database->len; idx++) {
+		a = g_ptr_array_index(database, idx);
 
 		if (a->handle > end)
 			break;
@@ -716,34 +760,33 @@ static uint16_t find_by_type(struct gatt_channel *channel, uint16_t start,
 		if ((bt_uuid_cmp(&a->uuid, uuid) == 0) && (a->len == vlen) &&
 					(memcmp(a->data, value, vlen) == 0)) {
 
-			range = g_new0(struct att_range, 1);
-			range->start = a->handle;
+			/* Stop once the response is full */
+			range = att_writer_next(&writer);
+			if (range == NULL)
+				break;
+
+			found = TRUE;
+
+			att_put_u16(a->handle, range);
 			/* It is allowed to have end group handle the same as
 			 * start handle, for groups with only one attribute. */
-			range->end = a->handle;
-
-			matches = g_slist_append(matches, range);
+			att_put_u16(a->handle, &range[2]);
 		} else if (range) {
 			/* Update the last found handle or reset the pointer
 			 * to track that a new group started: Primary or
 			 * Secondary service. */
-			if (bt_uuid_cmp(&a->uuid, &prim_uuid) == 0 ||
-					bt_uuid_cmp(&a->uuid, &snd_uuid) == 0)
+			if (is_service(a))
 				range = NULL;
 			else
-				range->end = a->handle;
+				att_put_u16(a->handle, &range[2]);
 		}
 	}
 
-	if (matches == NULL)
+	if (!found)
 		return enc_error_resp(ATT_OP_FIND_BY_TYPE_REQ, start,
 				ATT_ECODE_ATTR_NOT_FOUND, opdu, mtu);
 
-	len = enc_find_by_type_resp(matches, opdu, mtu);
-
-	g_slist_free_full(matches, g_free);
-
-	return len;
+	return writer.offset;
 }
 
 static int read_device_ccc(struct btd_device *device, uint16_t handle,
@@ -785,18 +828,13 @@ static uint16_t read_value(struct gatt_channel *channel, uint16_t handle,
 {
 	struct attribute *a;
 	uint8_t status;
-	GList *l;
 	uint16_t cccval;
-	guint h = handle;
 
-	l = g_list_find_custom(channel->server->database,
-					GUINT_TO_POINTER(h), handle_cmp);
-	if (!l)
+	a = find_attribute(channel->server->database, handle, NULL);
+	if (!a)
 		return enc_error_resp(ATT_OP_READ_REQ, handle,
 					ATT_ECODE_INVALID_HANDLE, pdu, len);
 
-	a = l->data;
-
 	if (bt_uuid_cmp(&ccc_uuid, &a->uuid) == 0 &&
 		read_device_ccc(channel->device, handle, &cccval) == 0) {
 		uint8_t config[2];
@@ -822,18 +860,13 @@ static uint16_t read_blob(struct gatt_channel *channel, uint16_t handle,
 {
 	struct attribute *a;
 	uint8_t status;
-	GList *l;
 	uint16_t cccval;
-	guint h = handle;
 
-	l = g_list_find_custom(channel->server->database,
-					GUINT_TO_POINTER(h), handle_cmp);
-	if (!l)
+	a = find_attribute(channel->server->database, handle, NULL);
+	if (!a)
 		return enc_error_resp(ATT_OP_READ_BLOB_REQ, handle,
 					ATT_ECODE_INVALID_HANDLE, pdu, len);
 
-	a = l->data;
-
 	if (a->len <= offset)
 		return enc_error_resp(ATT_OP_READ_BLOB_REQ, handle,
 					ATT_ECODE_INVALID_OFFSET, pdu, len);
@@ -865,17 +898,12 @@ static uint16_t write_value(struct gatt_channel *channel, uint16_t handle,
 {
 	struct attribute *a;
 	uint8_t status;
-	GList *l;
-	guint h = handle;
 
-	l = g_list_find_custom(channel->server->database,
-					GUINT_TO_POINTER(h), handle_cmp);
-	if (!l)
+	a = find_attribute(channel->server->database, handle, NULL);
+	if (!a)
 		return enc_error_resp(ATT_OP_WRITE_REQ, handle,
 				ATT_ECODE_INVALID_HANDLE, pdu, len);
 
-	a = l->data;
-
 	status = att_check_reqs(channel, ATT_OP_WRITE_REQ, a->write_req);
 	if (status)
 		return enc_error_resp(ATT_OP_WRITE_REQ, handle, status, pdu,
@@ -1309,6 +1337,9 @@ int btd_adapter_gatt_server_start(struct btd_adapter *adapter)
 
 	server = g_new0(struct gatt_server, 1);
 	server->adapter = btd_adapter_ref(adapter);
+	server->database = g_ptr_array_new_with_free_func(attrib_free);
+	server->responses = g_hash_table_new_full(g_int64_hash, g_int64_equal,
+								NULL, g_free);
 
 	addr = adapter_get_address(server->adapter);
 
@@ -1388,27 +1419,24 @@ static uint16_t find_uuid16_avail(struct btd_adapter *adapter, uint16_t nitems)
 	struct gatt_server *server;
 	uint16_t handle;
 	GSList *l;
-	GList *dl;
+	guint i;
 
 	l = g_slist_find_custom(servers, adapter, adapter_cmp);
 	if (l == NULL)
 		return 0;
 
 	server = l->data;
-	if (server->database == NULL)
+	if (server->database->len == 0)
 		return 0x0001;
 
-	for (dl = server->database, handle = 0x0001; dl; dl = dl->next) {
-		struct attribute *a = dl->data;
+	for (i = 0, handle = 0x0001; i < server->database->len; i++) {
+		struct attribute *a = g_ptr_array_index(server->database, i);
 
-		if ((bt_uuid_cmp(&a->uuid, &prim_uuid) == 0 ||
-				bt_uuid_cmp(&a->uuid, &snd_uuid) == 0) &&
-				a->handle - handle >= nitems)
+		if (is_service(a) && a->handle - handle >= nitems)
 			/* Note: the range above excludes the current handle */
 			return handle;
 
-		if (a->len == 16 && (bt_uuid_cmp(&a->uuid, &prim_uuid) == 0 ||
-				bt_uuid_cmp(&a->uuid, &snd_uuid) == 0)) {
+		if (a->len == 16 && is_service(a)) {
 			/* 128 bit UUID service definition */
 			return 0;
 		}
@@ -1429,25 +1457,25 @@ static uint16_t find_uuid128_avail(struct btd_adapter *adapter, uint16_t nitems)
 {
 	uint16_t handle = 0, end = 0xffff;
 	struct gatt_server *server;
-	GList *dl;
 	GSList *l;
+	guint i;
 
 	l = g_slist_find_custom(servers, adapter, adapter_cmp);
 	if (l == NULL)
 		return 0;
 
 	server = l->data;
-	if (server->database == NULL)
+	if (server->database->len == 0)
 		return 0xffff - nitems + 1;
 
-	for (dl = g_list_last(server->database); dl; dl = dl->prev) {
-		struct attribute *a = dl->data;
+	for (i = server->database->len; i > 0; i--) {
+		struct attribute *a = g_ptr_array_index(server->database,
+									i - 1);
 
 		if (handle == 0)
 			handle = a->handle;
 
-		if (bt_uuid_cmp(&a->uuid, &prim_uuid) != 0 &&
-				bt_uuid_cmp(&a->uuid, &snd_uuid) != 0)
+		if (!is_service(a))
 			continue;
 
 		if (end - handle >= nitems)
@@ -1512,8 +1540,6 @@ int attrib_db_update(struct btd_adapter *adapter, uint16_t handle,
 	struct gatt_server *server;
 	struct attribute *a;
 	GSList *l;
-	GList *dl;
-	guint h = handle;
 
 	l = g_slist_find_custom(servers, adapter, adapter_cmp);
 	if (l == NULL)
@@ -1523,13 +1549,10 @@ int attrib_db_update(struct btd_adapter *adapter, uint16_t handle,
 
 	DBG("handle=0x%04x", handle);
 
-	dl = g_list_find_custom(server->database, GUINT_TO_POINTER(h),
-								handle_cmp);
-	if (dl == NULL)
+	a = find_attribute(server->database, handle, NULL);
+	if (a == NULL)
 		return -ENOENT;
 
-	a = dl->data;
-
 	a->data = g_try_realloc(a->data, len);
 	if (len && a->data == NULL)
 		return -ENOMEM;
@@ -1537,6 +1560,10 @@ int attrib_db_update(struct btd_adapter *adapter, uint16_t handle,
 	a->len = len;
 	memcpy(a->data, value, len);
 
+	/* Cached responses only contain service values and types */
+	if (uuid != NULL || is_service(a))
+		g_hash_table_remove_all(server->responses);
+
 	if (uuid != NULL)
 		a->uuid = *uuid;
 
@@ -1549,10 +1576,8 @@ int attrib_db_update(struct btd_adapter *adapter, uint16_t handle,
 int attrib_db_del(struct btd_adapter *adapter, uint16_t handle)
 {
 	struct gatt_server *server;
-	struct attribute *a;
 	GSList *l;
-	GList *dl;
-	guint h = handle;
+	guint i;
 
 	l = g_slist_find_custom(servers, adapter, adapter_cmp);
 	if (l == NULL)
@@ -1562,15 +1587,12 @@ int attrib_db_del(struct btd_adapter *adapter, uint16_t handle)
 
 	DBG("handle=0x%04x", handle);
 
-	dl = g_list_find_custom(server->database, GUINT_TO_POINTER(h),
-								handle_cmp);
-	if (dl == NULL)
+	if (find_attribute(server->database, handle, &i) == NULL)
 		return -ENOENT;
 
-	a = dl->data;
-	server->database = g_list_remove(server->database, a);
-	g_free(a->data);
-	g_free(a);
+	g_ptr_array_remove_index(server->database, i);
+
+	g_hash_table_remove_all(server->responses);
 
 	return 0;
 }
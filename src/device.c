@@ -120,6 +120,7 @@ struct browse_req {
 	sdp_list_t *records;
 	int search_uuid;
 	int reconnect_attempt;
+	bool db_state_stored;
 	guint listener_id;
 };
 
@@ -259,10 +260,8 @@ static gboolean store_device_info_cb(gpointer user_data)
 	char filename[PATH_MAX + 1];
 	char adapter_addr[18];
 	char device_addr[18];
-	char *str;
 	char class[9];
 	char **uuids = NULL;
-	gsize length = 0;
 
 	device->store_id = 0;
 
@@ -272,8 +271,7 @@ static gboolean store_device_info_cb(gpointer user_data)
 			device_addr);
 	filename[PATH_MAX] = '\0';
 
-	key_file = g_key_file_new();
-	g_key_file_load_from_file(key_file, filename, 0, NULL);
+	key_file = storage_get(filename);
 
 	g_key_file_set_string(key_file, "General", "Name", device->name);
 
@@ -358,13 +356,8 @@ static gboolean store_device_info_cb(gpointer user_data)
 		g_key_file_remove_group(key_file, "DeviceID", NULL);
 	}
 
-	create_file(filename, S_IRUSR | S_IWUSR);
-
-	str = g_key_file_to_data(key_file, &length, NULL);
-	g_file_set_contents(filename, str, length, NULL);
-	g_free(str);
+	storage_commit(filename);
 
-	g_key_file_free(key_file);
 	g_free(uuids);
 
 	return FALSE;
@@ -403,8 +396,6 @@ void device_store_cached_name(struct btd_device *dev, const char *name)
 	char filename[PATH_MAX + 1];
 	char s_addr[18], d_addr[18];
 	GKeyFile *key_file;
-	char *data;
-	gsize length = 0;
 
 	if (device_address_is_private(dev)) {
 		warn("Can't store name for private addressed device %s",
@@ -416,17 +407,11 @@ void device_store_cached_name(struct btd_device *dev, const char *name)
 	ba2str(&dev->bdaddr, d_addr);
 	snprintf(filename, PATH_MAX, STORAGEDIR "/%s/cache/%s", s_addr, d_addr);
 	filename[PATH_MAX] = '\0';
-	create_file(filename, S_IRUSR | S_IWUSR);
 
-	key_file = g_key_file_new();
-	g_key_file_load_from_file(key_file, filename, 0, NULL);
+	key_file = storage_get(filename);
 	g_key_file_set_string(key_file, "General", "Name", name);
 
-	data = g_key_file_to_data(key_file, &length, NULL);
-	g_file_set_contents(filename, data, length, NULL);
-	g_free(data);
-
-	g_key_file_free(key_file);
+	storage_commit(filename);
 }
 
 static void browse_request_free(struct browse_req *req)
@@ -1877,16 +1862,13 @@ static char *load_cached_name(struct btd_device *device, const char *local,
 {
 	char filename[PATH_MAX + 1];
 	GKeyFile *key_file;
-	char *str = NULL;
+	char *str;
 	int len;
 
 	snprintf(filename, PATH_MAX, STORAGEDIR "/%s/cache/%s", local, peer);
 	filename[PATH_MAX] = '\0';
 
-	key_file = g_key_file_new();
-
-	if (!g_key_file_load_from_file(key_file, filename, 0, NULL))
-		goto failed;
+	key_file = storage_get(filename);
 
 	str = g_key_file_get_string(key_file, "General", "Name", NULL);
 	if (str) {
@@ -1895,9 +1877,6 @@ static char *load_cached_name(struct btd_device *device, const char *local,
 			str[HCI_MAX_NAME_LENGTH] = '\0';
 	}
 
-failed:
-	g_key_file_free(key_file);
-
 	return str;
 }
 
@@ -2056,8 +2035,7 @@ static void load_att_info(struct btd_device *device, const char *local,
 			peer);
 	filename[PATH_MAX] = '\0';
 
-	key_file = g_key_file_new();
-	g_key_file_load_from_file(key_file, filename, 0, NULL);
+	key_file = storage_get(filename);
 	groups = g_key_file_get_groups(key_file, NULL);
 
 	for (handle = groups; *handle; handle++) {
@@ -2122,7 +2100,6 @@ static void load_att_info(struct btd_device *device, const char *local,
 	}
 
 	g_strfreev(groups);
-	g_key_file_free(key_file);
 	g_free(prim_uuid);
 }
 
@@ -2340,8 +2317,6 @@ static void device_remove_stored(struct btd_device *device)
 	char device_addr[18];
 	char filename[PATH_MAX + 1];
 	GKeyFile *key_file;
-	char *data;
-	gsize length = 0;
 
 	if (device_is_bonded(device)) {
 		device_set_bonded(device, FALSE);
@@ -2359,24 +2334,18 @@ static void device_remove_stored(struct btd_device *device)
 	snprintf(filename, PATH_MAX, STORAGEDIR "/%s/%s", adapter_addr,
 			device_addr);
 	filename[PATH_MAX] = '\0';
+	storage_remove(filename);
 	delete_folder_tree(filename);
 
 	snprintf(filename, PATH_MAX, STORAGEDIR "/%s/cache/%s", adapter_addr,
 			device_addr);
 	filename[PATH_MAX] = '\0';
 
-	key_file = g_key_file_new();
-	g_key_file_load_from_file(key_file, filename, 0, NULL);
+	key_file = storage_get(filename);
 	g_key_file_remove_group(key_file, "ServiceRecords", NULL);
+	g_key_file_remove_group(key_file, "ServiceDatabase", NULL);
 
-	data = g_key_file_to_data(key_file, &length, NULL);
-	if (length > 0) {
-		create_file(filename, S_IRUSR | S_IWUSR);
-		g_file_set_contents(filename, data, length, NULL);
-	}
-
-	g_free(data);
-	g_key_file_free(key_file);
+	storage_commit(filename);
 }
 
 void device_remove(struct btd_device *device, gboolean remove_stored)
@@ -2616,6 +2585,22 @@ static void store_sdp_record(GKeyFile *key_file, sdp_record_t *rec)
 	g_free(str);
 }
 
+static bool store_sdp_db_state(GKeyFile *key_file, const sdp_record_t *rec)
+{
+	sdp_data_t *d;
+	char str[11];
+
+	d = sdp_data_get(rec, SDP_ATTR_SVCDB_STATE);
+	if (!d || d->dtd != SDP_UINT32)
+		return false;
+
+	sprintf(str, "0x%8.8X", d->val.uint32);
+
+	g_key_file_set_string(key_file, "ServiceDatabase", "State", str);
+
+	return true;
+}
+
 static void store_primaries_from_sdp_record(GKeyFile *key_file,
 						sdp_record_t *rec)
 {
@@ -2706,8 +2691,6 @@ static void update_bredr_services(struct browse_req *req, sdp_list_t *recs)
 	char att_file[PATH_MAX + 1];
 	GKeyFile *sdp_key_file = NULL;
 	GKeyFile *att_key_file = NULL;
-	char *data;
-	gsize length = 0;
 
 	ba2str(adapter_get_address(device->adapter), srcaddr);
 	ba2str(&device->bdaddr, dstaddr);
@@ -2717,15 +2700,13 @@ static void update_bredr_services(struct browse_req *req, sdp_list_t *recs)
 							srcaddr, dstaddr);
 		sdp_file[PATH_MAX] = '\0';
 
-		sdp_key_file = g_key_file_new();
-		g_key_file_load_from_file(sdp_key_file, sdp_file, 0, NULL);
+		sdp_key_file = storage_get(sdp_file);
 
 		snprintf(att_file, PATH_MAX, STORAGEDIR "/%s/%s/attributes",
 							srcaddr, dstaddr);
 		att_file[PATH_MAX] = '\0';
 
-		att_key_file = g_key_file_new();
-		g_key_file_load_from_file(att_key_file, att_file, 0, NULL);
+		att_key_file = storage_get(att_file);
 	}
 
 	for (seq = recs; seq; seq = seq->next) {
@@ -2736,6 +2717,10 @@ static void update_bredr_services(struct browse_req *req, sdp_list_t *recs)
 		if (!rec)
 			break;
 
+		if (sdp_key_file && rec->handle == 0x00000000 &&
+					store_sdp_db_state(sdp_key_file, rec))
+			req->db_state_stored = true;
+
 		if (sdp_get_service_classes(rec, &svcclass) < 0)
 			continue;
 
@@ -2787,27 +2772,11 @@ next:
 		sdp_list_free(svcclass, free);
 	}
 
-	if (sdp_key_file) {
-		data = g_key_file_to_data(sdp_key_file, &length, NULL);
-		if (length > 0) {
-			create_file(sdp_file, S_IRUSR | S_IWUSR);
-			g_file_set_contents(sdp_file, data, length, NULL);
-		}
-
-		g_free(data);
-		g_key_file_free(sdp_key_file);
-	}
-
-	if (att_key_file) {
-		data = g_key_file_to_data(att_key_file, &length, NULL);
-		if (length > 0) {
-			create_file(att_file, S_IRUSR | S_IWUSR);
-			g_file_set_contents(att_file, data, length, NULL);
-		}
+	if (sdp_key_file)
+		storage_commit(sdp_file);
 
-		g_free(data);
-		g_key_file_free(att_key_file);
-	}
+	if (att_key_file)
+		storage_commit(att_file);
 }
 
 static int primary_cmp(gconstpointer a, gconstpointer b)
@@ -2931,6 +2900,34 @@ send_reply:
 	browse_request_free(req);
 }
 
+static void db_state_cb(sdp_list_t *recs, int err, gpointer user_data)
+{
+	struct browse_req *req = user_data;
+	struct btd_device *device = req->device;
+	char srcaddr[18], dstaddr[18];
+	char filename[PATH_MAX + 1];
+	GKeyFile *key_file;
+
+	if (err < 0 || !recs || !recs->data)
+		goto done;
+
+	ba2str(adapter_get_address(device->adapter), srcaddr);
+	ba2str(&device->bdaddr, dstaddr);
+
+	snprintf(filename, PATH_MAX, STORAGEDIR "/%s/cache/%s", srcaddr,
+								dstaddr);
+	filename[PATH_MAX] = '\0';
+
+	key_file = storage_get(filename);
+
+	if (store_sdp_db_state(key_file, recs->data))
+		storage_commit(filename);
+
+done:
+	/* The browse itself has already succeeded */
+	search_cb(NULL, 0, req);
+}
+
 static void browse_cb(sdp_list_t *recs, int err, gpointer user_data)
 {
 	struct browse_req *req = user_data;
@@ -2960,6 +2957,23 @@ static void browse_cb(sdp_list_t *recs, int err, gpointer user_data)
 	}
 
 done:
+	/*
+	 * The SDP server record is only part of the browse results when it
+	 * matches one of the searched UUIDs. Otherwise fetch its
+	 * ServiceDatabaseState over the still cached session, so that the
+	 * next connection can skip the browse.
+	 */
+	if (err == 0 && !device->temporary && !req->db_state_stored) {
+		update_bredr_services(req, recs);
+
+		if (bt_search_service_state(adapter_get_address(adapter),
+						&device->bdaddr, db_state_cb,
+						req, NULL) == 0)
+			return;
+
+		recs = NULL;
+	}
+
 	search_cb(recs, err, user_data);
 }
 
@@ -2971,9 +2985,8 @@ static void store_services(struct btd_device *device)
 	uuid_t uuid;
 	char *prim_uuid;
 	GKeyFile *key_file;
+	char **groups, **group;
 	GSList *l;
-	char *data;
-	gsize length = 0;
 
 	if (device_address_is_private(device)) {
 		warn("Can't store services for private addressed device %s",
@@ -2993,7 +3006,12 @@ static void store_services(struct btd_device *device)
 								dst_addr);
 	filename[PATH_MAX] = '\0';
 
-	key_file = g_key_file_new();
+	key_file = storage_get(filename);
+
+	groups = g_key_file_get_groups(key_file, NULL);
+	for (group = groups; *group; group++)
+		g_key_file_remove_group(key_file, *group, NULL);
+	g_strfreev(groups);
 
 	for (l = device->primaries; l; l = l->next) {
 		struct gatt_primary *primary = l->data;
@@ -3027,15 +3045,9 @@ static void store_services(struct btd_device *device)
 					primary->range.end);
 	}
 
-	data = g_key_file_to_data(key_file, &length, NULL);
-	if (length > 0) {
-		create_file(filename, S_IRUSR | S_IWUSR);
-		g_file_set_contents(filename, data, length, NULL);
-	}
+	storage_commit(filename);
 
 	g_free(prim_uuid);
-	g_free(data);
-	g_key_file_free(key_file);
 }
 
 static bool device_get_auto_connect(struct btd_device *device)
@@ -3476,10 +3488,74 @@ done:
 	return 0;
 }
 
+static bool read_sdp_db_state(struct btd_device *device, uint32_t *state)
+{
+	char local[18], peer[18];
+	char filename[PATH_MAX + 1];
+	GKeyFile *key_file;
+	char *str;
+
+	ba2str(adapter_get_address(device->adapter), local);
+	ba2str(&device->bdaddr, peer);
+
+	snprintf(filename, PATH_MAX, STORAGEDIR "/%s/cache/%s", local, peer);
+	filename[PATH_MAX] = '\0';
+
+	key_file = storage_get(filename);
+
+	if (!g_key_file_has_group(key_file, "ServiceRecords"))
+		return false;
+
+	str = g_key_file_get_string(key_file, "ServiceDatabase", "State",
+									NULL);
+	if (!str)
+		return false;
+
+	*state = strtoul(str, NULL, 16);
+	g_free(str);
+
+	return true;
+}
+
+static void state_cb(sdp_list_t *recs, int err, gpointer user_data)
+{
+	struct browse_req *req = user_data;
+	struct btd_device *device = req->device;
+	sdp_record_t *rec = recs ? recs->data : NULL;
+	sdp_data_t *d = NULL;
+	uint32_t state;
+	uuid_t uuid;
+	char addr[18];
+
+	ba2str(&device->bdaddr, addr);
+
+	if (err == 0 && rec)
+		d = sdp_data_get(rec, SDP_ATTR_SVCDB_STATE);
+
+	if (d && d->dtd == SDP_UINT32 && read_sdp_db_state(device, &state) &&
+						d->val.uint32 == state) {
+		DBG("%s: service database unchanged (0x%8.8X)", addr, state);
+		device_svc_resolved(device, 0);
+		browse_request_free(req);
+		return;
+	}
+
+	DBG("%s: service database changed, browsing", addr);
+
+	sdp_uuid16_create(&uuid, uuid_list[req->search_uuid++]);
+
+	err = bt_search_service(adapter_get_address(device->adapter),
+					&device->bdaddr, &uuid, browse_cb,
+					req, NULL);
+	if (err < 0)
+		search_cb(NULL, err, req);
+}
+
 static int device_browse_sdp(struct btd_device *device, DBusMessage *msg)
 {
 	struct btd_adapter *adapter = device->adapter;
 	struct browse_req *req;
+	uint32_t state;
 	uuid_t uuid;
 	int err;
 
@@ -3488,10 +3564,24 @@ static int device_browse_sdp(struct btd_device *device, DBusMessage *msg)
 
 	req = g_new0(struct browse_req, 1);
 	req->device = device;
-	sdp_uuid16_create(&uuid, uuid_list[req->search_uuid++]);
 
-	err = bt_search_service(adapter_get_address(adapter), &device->bdaddr,
-						&uuid, browse_cb, req, NULL);
+	/*
+	 * Records of a known device are kept in the cache file together
+	 * with the ServiceDatabaseState of the remote SDP server. Check
+	 * that attribute first and only browse again when it has changed.
+	 */
+	if (!device->temporary && read_sdp_db_state(device, &state))
+		err = bt_search_service_state(adapter_get_address(adapter),
+						&device->bdaddr, state_cb,
+						req, NULL);
+	else {
+		sdp_uuid16_create(&uuid, uuid_list[req->search_uuid++]);
+
+		err = bt_search_service(adapter_get_address(adapter),
+						&device->bdaddr, &uuid,
+						browse_cb, req, NULL);
+	}
+
 	if (err < 0) {
 		browse_request_free(req);
 		return err;
@@ -4277,8 +4367,7 @@ static sdp_list_t *read_device_records(struct btd_device *device)
 	snprintf(filename, PATH_MAX, STORAGEDIR "/%s/cache/%s", local, peer);
 	filename[PATH_MAX] = '\0';
 
-	key_file = g_key_file_new();
-	g_key_file_load_from_file(key_file, filename, 0, NULL);
+	key_file = storage_get(filename);
 	keys = g_key_file_get_keys(key_file, "ServiceRecords", NULL, NULL);
 
 	for (handle = keys; handle && *handle; handle++) {
@@ -4293,7 +4382,6 @@ static sdp_list_t *read_device_records(struct btd_device *device)
 	}
 
 	g_strfreev(keys);
-	g_key_file_free(key_file);
 
 	return recs;
 }
@@ -33,6 +33,9 @@ struct main_opts {
 	gboolean	name_resolv;
 	gboolean	debug_keys;
 
+	uint8_t		rssi_threshold;
+	uint32_t	report_interval;
+
 	uint16_t	did_source;
 	uint16_t	did_vendor;
 	uint16_t	did_product;
@@ -56,6 +56,7 @@
 #include "agent.h"
 #include "profile.h"
 #include "systemd.h"
+#include "storage.h"
 
 #define BLUEZ_NAME "org.bluez"
 
@@ -64,6 +65,9 @@
 
 #define SHUTDOWN_GRACE_SECONDS 10
 
+/* Minimum time between two RSSI change signals of a device, in ms */
+#define RSSI_MIN_INTERVAL 500
+
 struct main_opts main_opts;
 
 static const char * const supported_options[] = {
@@ -76,6 +80,8 @@ static const char * const supported_options[] = {
 	"ReverseServiceDiscovery",
 	"NameResolving",
 	"DebugKeys",
+	"RSSIThreshold",
+	"ReportInterval",
 };
 
 static GKeyFile *load_config(const char *file)
@@ -263,6 +269,25 @@ static void parse_config(GKeyFile *config)
 		g_clear_error(&err);
 	else
 		main_opts.debug_keys = boolean;
+
+	val = g_key_file_get_integer(config, "General", "RSSIThreshold", &err);
+	if (err) {
+		DBG("%s", err->message);
+		g_clear_error(&err);
+	} else {
+		DBG("rssi_threshold=%d", val);
+		main_opts.rssi_threshold = CLAMP(val, 0, 127);
+	}
+
+	val = g_key_file_get_integer(config, "General", "ReportInterval",
+									&err);
+	if (err) {
+		DBG("%s", err->message);
+		g_clear_error(&err);
+	} else {
+		DBG("report_interval=%d", val);
+		main_opts.report_interval = MAX(val, 0);
+	}
 }
 
 static void init_defaults(void)
@@ -439,6 +464,10 @@ static int connect_dbus(void)
 	g_dbus_set_disconnect_function(conn, disconnected_dbus, NULL, NULL);
 	g_dbus_attach_object_manager(conn);
 
+	/* Don't flood clients with RSSI updates during discovery */
+	g_dbus_set_property_interval(DEVICE_INTERFACE, "RSSI",
+							RSSI_MIN_INTERVAL);
+
 	return 0;
 }
 
@@ -598,6 +627,8 @@ int main(int argc, char *argv[])
 
 	adapter_cleanup();
 
+	storage_cleanup();
+
 	rfkill_exit();
 
 	stop_sdp_server();
@@ -124,6 +124,7 @@ struct search_context {
 	bt_destroy_t		destroy;
 	gpointer		user_data;
 	uuid_t			uuid;
+	uint32_t		range;
 	guint			io_id;
 };
 
@@ -227,7 +228,6 @@ static gboolean connect_watch(GIOChannel *chan, GIOCondition cond,
 {
 	struct search_context *ctxt = user_data;
 	sdp_list_t *search, *attrids;
-	uint32_t range = 0x0000ffff;
 	socklen_t len;
 	int sk, err, sk_err = 0;
 
@@ -249,7 +249,7 @@ static gboolean connect_watch(GIOChannel *chan, GIOCondition cond,
 	}
 
 	search = sdp_list_append(NULL, &ctxt->uuid);
-	attrids = sdp_list_append(NULL, &range);
+	attrids = sdp_list_append(NULL, &ctxt->range);
 	if (sdp_service_search_attr_async(ctxt->session,
 				search, SDP_ATTR_REQ_RANGE, attrids) < 0) {
 		sdp_list_free(attrids, NULL);
@@ -282,7 +282,7 @@ failed:
 static int create_search_context(struct search_context **ctxt,
 					const bdaddr_t *src,
 					const bdaddr_t *dst,
-					uuid_t *uuid)
+					uuid_t *uuid, uint32_t range)
 {
 	sdp_session_t *s;
 	GIOChannel *chan;
@@ -306,6 +306,7 @@ static int create_search_context(struct search_context **ctxt,
 	bacpy(&(*ctxt)->dst, dst);
 	(*ctxt)->session = s;
 	(*ctxt)->uuid = *uuid;
+	(*ctxt)->range = range;
 
 	sk = sdp_get_socket(s);
 	/* Set low priority for the SDP connection not to interfere with
@@ -324,9 +325,9 @@ static int create_search_context(struct search_context **ctxt,
 	return 0;
 }
 
-int bt_search_service(const bdaddr_t *src, const bdaddr_t *dst,
-			uuid_t *uuid, bt_callback_t cb, void *user_data,
-			bt_destroy_t destroy)
+static int search_service(const bdaddr_t *src, const bdaddr_t *dst,
+			uuid_t *uuid, uint32_t range, bt_callback_t cb,
+			void *user_data, bt_destroy_t destroy)
 {
 	struct search_context *ctxt = NULL;
 	int err;
@@ -334,7 +335,7 @@ int bt_search_service(const bdaddr_t *src, const bdaddr_t *dst,
 	if (!cb)
 		return -EINVAL;
 
-	err = create_search_context(&ctxt, src, dst, uuid);
+	err = create_search_context(&ctxt, src, dst, uuid, range);
 	if (err < 0)
 		return err;
 
@@ -347,6 +348,32 @@ int bt_search_service(const bdaddr_t *src, const bdaddr_t *dst,
 	return 0;
 }
 
+int bt_search_service(const bdaddr_t *src, const bdaddr_t *dst,
+			uuid_t *uuid, bt_callback_t cb, void *user_data,
+			bt_destroy_t destroy)
+{
+	return search_service(src, dst, uuid, 0x0000ffff, cb, user_data,
+								destroy);
+}
+
+/*
+ * Only fetch the ServiceDatabaseState attribute of the remote SDP server
+ * record. Its value changes whenever a record is added, removed or
+ * modified, so it tells whether previously discovered records are still
+ * valid without browsing them all again.
+ */
+int bt_search_service_state(const bdaddr_t *src, const bdaddr_t *dst,
+			bt_callback_t cb, void *user_data,
+			bt_destroy_t destroy)
+{
+	uint32_t range = SDP_ATTR_SVCDB_STATE << 16 | SDP_ATTR_SVCDB_STATE;
+	uuid_t uuid;
+
+	sdp_uuid16_create(&uuid, SDP_SERVER_SVCLASS_ID);
+
+	return search_service(src, dst, &uuid, range, cb, user_data, destroy);
+}
+
 static int find_by_bdaddr(gconstpointer data, gconstpointer user_data)
 {
 	const struct search_context *ctxt = data, *search = user_data;
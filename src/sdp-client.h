@@ -27,5 +27,8 @@ typedef void (*bt_destroy_t) (gpointer user_data);
 int bt_search_service(const bdaddr_t *src, const bdaddr_t *dst,
 			uuid_t *uuid, bt_callback_t cb, void *user_data,
 			bt_destroy_t destroy);
+int bt_search_service_state(const bdaddr_t *src, const bdaddr_t *dst,
+			bt_callback_t cb, void *user_data,
+			bt_destroy_t destroy);
 int bt_cancel_discovery(const bdaddr_t *src, const bdaddr_t *dst);
 void bt_clear_cached_session(const bdaddr_t *src, const bdaddr_t *dst);
@@ -28,6 +28,7 @@
 #include <config.h>
 #endif
 
+#include <errno.h>
 #include <stdlib.h>
 
 #include <bluetooth/bluetooth.h>
@@ -40,6 +41,27 @@
 static sdp_list_t *service_db;
 static sdp_list_t *access_db;
 
+/*
+ * Inverted index from 128-bit UUID to the records whose pattern
+ * contains it. It is rebuilt on the first search after the database
+ * changed, since records get their attributes after being added.
+ */
+typedef struct {
+	uint128_t uuid;
+	sdp_record_t **records;		/* sorted by handle */
+	int count;
+} sdp_uuid_index_t;
+
+static sdp_uuid_index_t *uuid_index;
+static sdp_record_t **uuid_index_records;
+static int uuid_index_len;
+static int uuid_index_valid;
+
+#define RECORD_PDU_HASH_SIZE	64
+
+/* Encoded records, generated on first use and dropped on any change */
+static sdp_record_pdu_t *record_pdus[RECORD_PDU_HASH_SIZE];
+
 typedef struct {
 	uint32_t handle;
 	bdaddr_t device;
@@ -86,6 +108,8 @@ static void access_free(void *p)
  */
 void sdp_svcdb_reset(void)
 {
+	sdp_svcdb_invalidate();
+
 	sdp_list_free(service_db, (sdp_free_func_t) sdp_record_free);
 	service_db = NULL;
 
@@ -172,6 +196,8 @@ void sdp_record_add(const bdaddr_t *device, sdp_record_t *rec)
 	SDPDBG("Adding rec : 0x%lx", (long) rec);
 	SDPDBG("with handle : 0x%x", rec->handle);
 
+	sdp_svcdb_invalidate();
+
 	service_db = sdp_list_insert_sorted(service_db, rec, record_sort);
 
 	dev = malloc(sizeof(*dev));
@@ -247,6 +273,8 @@ int sdp_record_remove(uint32_t handle)
 	if (r)
 		service_db = sdp_list_remove(service_db, r);
 
+	sdp_svcdb_invalidate();
+
 	p = access_locate(handle);
 	if (p == NULL || p->data == NULL)
 		return 0;
@@ -267,6 +295,250 @@ sdp_list_t *sdp_get_record_list(void)
 	return service_db;
 }
 
+static void record_pdu_free(sdp_record_pdu_t *pdu)
+{
+	free(pdu->ids);
+	free(pdu->offsets);
+	free(pdu->buf.data);
+	free(pdu);
+}
+
+/*
+ * Drop the UUID index and the encoded records, needs to be called
+ * whenever a registered record changes
+ */
+void sdp_svcdb_invalidate(void)
+{
+	int i;
+
+	free(uuid_index);
+	free(uuid_index_records);
+
+	uuid_index = NULL;
+	uuid_index_records = NULL;
+	uuid_index_len = 0;
+	uuid_index_valid = 0;
+
+	for (i = 0; i < RECORD_PDU_HASH_SIZE; i++) {
+		while (record_pdus[i]) {
+			sdp_record_pdu_t *pdu = record_pdus[i];
+
+			record_pdus[i] = pdu->next;
+			record_pdu_free(pdu);
+		}
+	}
+}
+
+typedef struct {
+	const uint128_t *uuid;
+	sdp_record_t *record;
+} sdp_uuid_ref_t;
+
+static int uuid_ref_sort(const void *r1, const void *r2)
+{
+	const sdp_uuid_ref_t *ref1 = r1;
+	const sdp_uuid_ref_t *ref2 = r2;
+	int ret;
+
+	ret = memcmp(ref1->uuid, ref2->uuid, sizeof(uint128_t));
+	if (ret)
+		return ret;
+
+	if (ref1->record->handle < ref2->record->handle)
+		return -1;
+
+	return ref1->record->handle > ref2->record->handle;
+}
+
+static void uuid_to_uint128(const uuid_t *uuid, uint128_t *u128)
+{
+	uuid_t tmp;
+
+	switch (uuid->type) {
+	case SDP_UUID16:
+		sdp_uuid16_to_uuid128(&tmp, uuid);
+		break;
+	case SDP_UUID32:
+		sdp_uuid32_to_uuid128(&tmp, uuid);
+		break;
+	default:
+		tmp = *uuid;
+		break;
+	}
+
+	*u128 = tmp.value.uuid128;
+}
+
+static int uuid_index_build(void)
+{
+	sdp_uuid_ref_t *refs;
+	sdp_list_t *p, *q;
+	int i, n = 0;
+
+	for (p = service_db; p; p = p->next) {
+		sdp_record_t *rec = p->data;
+
+		n += sdp_list_len(rec->pattern);
+	}
+
+	refs = malloc(n * sizeof(*refs) + 1);
+	uuid_index = malloc(n * sizeof(*uuid_index) + 1);
+	uuid_index_records = malloc(n * sizeof(sdp_record_t *) + 1);
+	if (!refs || !uuid_index || !uuid_index_records) {
+		free(refs);
+		sdp_svcdb_invalidate();
+		return -ENOMEM;
+	}
+
+	n = 0;
+	for (p = service_db; p; p = p->next) {
+		sdp_record_t *rec = p->data;
+
+		for (q = rec->pattern; q; q = q->next) {
+			uuid_t *uuid = q->data;
+
+			/* Patterns only hold 128-bit UUIDs */
+			if (uuid->type != SDP_UUID128)
+				continue;
+
+			refs[n].uuid = &uuid->value.uuid128;
+			refs[n].record = rec;
+			n++;
+		}
+	}
+
+	qsort(refs, n, sizeof(*refs), uuid_ref_sort);
+
+	uuid_index_len = 0;
+	for (i = 0; i < n; i++) {
+		sdp_uuid_index_t *entry = NULL;
+
+		if (uuid_index_len > 0)
+			entry = &uuid_index[uuid_index_len - 1];
+
+		if (entry == NULL || memcmp(&entry->uuid, refs[i].uuid,
+						sizeof(uint128_t)) != 0) {
+			entry = &uuid_index[uuid_index_len++];
+			entry->uuid = *refs[i].uuid;
+			entry->records = &uuid_index_records[i];
+			entry->count = 0;
+		}
+
+		/* The same UUID may be listed twice in one pattern */
+		if (entry->count > 0 &&
+				entry->records[entry->count - 1] == refs[i].record)
+			continue;
+
+		entry->records[entry->count++] = refs[i].record;
+	}
+
+	free(refs);
+
+	uuid_index_valid = 1;
+
+	return 0;
+}
+
+static sdp_uuid_index_t *uuid_index_find(const uuid_t *uuid)
+{
+	uint128_t u128;
+	int lo = 0, hi = uuid_index_len;
+
+	uuid_to_uint128(uuid, &u128);
+
+	while (lo < hi) {
+		int mid = (lo + hi) / 2;
+		int ret = memcmp(&uuid_index[mid].uuid, &u128, sizeof(u128));
+
+		if (ret == 0)
+			return &uuid_index[mid];
+
+		if (ret < 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return NULL;
+}
+
+static int uuid_index_contains(sdp_uuid_index_t *entry, uint32_t handle)
+{
+	int lo = 0, hi = entry->count;
+
+	while (lo < hi) {
+		int mid = (lo + hi) / 2;
+		uint32_t h = entry->records[mid]->handle;
+
+		if (h == handle)
+			return 1;
+
+		if (h < handle)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return 0;
+}
+
+/*
+ * Find the records whose pattern contains every UUID of the search
+ * list. The matches are returned in handle order in a newly allocated
+ * array, which the caller needs to free.
+ */
+int sdp_svcdb_search(sdp_list_t *search, sdp_record_t ***records)
+{
+	sdp_uuid_index_t *entry, *base = NULL;
+	sdp_list_t *p;
+	int i, n, count;
+
+	*records = NULL;
+
+	if (!uuid_index_valid && uuid_index_build() < 0)
+		return -ENOMEM;
+
+	/* Start from the UUID with the fewest records */
+	for (p = search, n = 0; p; p = p->next, n++) {
+		if (p->data == NULL)
+			return 0;
+
+		entry = uuid_index_find(p->data);
+		if (entry == NULL)
+			return 0;
+
+		if (base == NULL || entry->count < base->count)
+			base = entry;
+	}
+
+	if (base == NULL)
+		return 0;
+
+	*records = malloc(base->count * sizeof(sdp_record_t *));
+	if (*records == NULL)
+		return -ENOMEM;
+
+	for (i = 0, count = 0; i < base->count; i++) {
+		sdp_record_t *rec = base->records[i];
+
+		/* A pattern can't match more UUIDs than it holds */
+		if (sdp_list_len(rec->pattern) < n)
+			continue;
+
+		for (p = search; p; p = p->next) {
+			entry = uuid_index_find(p->data);
+			if (entry != base &&
+				!uuid_index_contains(entry, rec->handle))
+				break;
+		}
+
+		if (p == NULL)
+			(*records)[count++] = rec;
+	}
+
+	return count;
+}
+
 int sdp_check_access(uint32_t handle, bdaddr_t *device)
 {
 	sdp_list_t *p = access_locate(handle);
@@ -296,3 +568,136 @@ uint32_t sdp_next_handle(void)
 
 	return handle;
 }
+
+/* Size of the data element at the start of the buffer */
+static int element_size(const uint8_t *p, uint32_t len)
+{
+	uint32_t size;
+
+	if (len < 1)
+		return -1;
+
+	if (*p == SDP_DATA_NIL)
+		return 1;
+
+	switch (*p & 0x07) {
+	case 0:
+	case 1:
+	case 2:
+	case 3:
+	case 4:
+		size = 1 + (1 << (*p & 0x07));
+		break;
+	case 5:
+		if (len < 2)
+			return -1;
+		size = 2 + p[1];
+		break;
+	case 6:
+		if (len < 3)
+			return -1;
+		size = 3 + bt_get_be16(p + 1);
+		break;
+	default:
+		if (len < 5)
+			return -1;
+		size = 5 + bt_get_be32(p + 1);
+		break;
+	}
+
+	if (size > len)
+		return -1;
+
+	return size;
+}
+
+static sdp_record_pdu_t *record_pdu_build(const sdp_record_t *rec)
+{
+	sdp_record_pdu_t *pdu;
+	uint32_t offset = 0;
+	uint8_t dtd;
+	int i, size, count;
+
+	pdu = malloc(sizeof(*pdu));
+	if (!pdu)
+		return NULL;
+
+	memset(pdu, 0, sizeof(*pdu));
+
+	count = sdp_list_len(rec->attrlist);
+
+	/* An empty record only needs the end offset */
+	if (count > 0) {
+		pdu->ids = malloc(count * sizeof(uint16_t));
+		if (!pdu->ids)
+			goto failed;
+	}
+
+	pdu->offsets = malloc((count + 1) * sizeof(uint32_t));
+	if (!pdu->offsets)
+		goto failed;
+
+	if (sdp_gen_record_pdu(rec, &pdu->buf) < 0)
+		goto failed;
+
+	/* Skip the sequence header, only the attributes get indexed */
+	if (count > 0) {
+		offset = sdp_extract_seqtype(pdu->buf.data,
+					pdu->buf.data_size, &dtd, &size);
+		if (offset == 0)
+			goto failed;
+	}
+
+	/* Each entry is an attribute ID followed by its value */
+	for (i = 0; i < count; i++) {
+		const uint8_t *p = pdu->buf.data + offset;
+		uint32_t left = pdu->buf.data_size - offset;
+		int len;
+
+		if (left < 3 || p[0] != SDP_UINT16)
+			goto failed;
+
+		len = element_size(p + 3, left - 3);
+		if (len < 0)
+			goto failed;
+
+		pdu->ids[i] = bt_get_be16(p + 1);
+		pdu->offsets[i] = offset;
+
+		offset += 3 + len;
+	}
+
+	pdu->offsets[count] = offset;
+	pdu->count = count;
+	pdu->handle = rec->handle;
+
+	return pdu;
+
+failed:
+	error("Unable to encode record 0x%x", rec->handle);
+	record_pdu_free(pdu);
+	return NULL;
+}
+
+/*
+ * Return the encoded form of a registered record, generating it on
+ * first use
+ */
+const sdp_record_pdu_t *sdp_record_get_pdu(const sdp_record_t *rec)
+{
+	sdp_record_pdu_t *pdu;
+	int bucket = rec->handle % RECORD_PDU_HASH_SIZE;
+
+	for (pdu = record_pdus[bucket]; pdu; pdu = pdu->next)
+		if (pdu->handle == rec->handle)
+			return pdu;
+
+	pdu = record_pdu_build(rec);
+	if (!pdu)
+		return NULL;
+
+	pdu->next = record_pdus[bucket];
+	record_pdus[bucket] = pdu;
+
+	return pdu;
+}
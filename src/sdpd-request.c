@@ -52,41 +52,188 @@ typedef struct {
 
 #define MIN(x, y) ((x) < (y)) ? (x): (y)
 
+/* Cached responses unused for this long (in seconds) are dropped */
+#define SDP_CSTATE_TTL		30
+
+/* Upper bound for the memory held by all cached responses */
+#define SDP_CSTATE_MAX_BYTES	(256 * 1024)
+
+#define SDP_CSTATE_HASH_SIZE	64
+
 typedef struct _sdp_cstate_list sdp_cstate_list_t;
 
 struct _sdp_cstate_list {
-	sdp_cstate_list_t *next;
+	sdp_cstate_list_t *next;	/* least recently used first */
+	sdp_cstate_list_t *prev;
+	sdp_cstate_list_t *hnext;	/* hash bucket chain */
+	int sock;
+	uint32_t id;
 	uint32_t timestamp;
 	sdp_buf_t buf;
 };
 
-static sdp_cstate_list_t *cstates;
+static sdp_cstate_list_t *cstates_head, *cstates_tail;
+static sdp_cstate_list_t *cstates_hash[SDP_CSTATE_HASH_SIZE];
+static size_t cstates_size;
+static uint32_t cstates_id;
 
-/* FIXME: should probably remove it when it's found */
-static sdp_buf_t *sdp_get_cached_rsp(sdp_cont_state_t *cstate)
+static sdp_cstate_list_t *sdp_cstate_find(uint32_t id)
 {
 	sdp_cstate_list_t *p;
 
-	for (p = cstates; p; p = p->next)
-		if (p->timestamp == cstate->timestamp)
-			return &p->buf;
-	return 0;
+	for (p = cstates_hash[id % SDP_CSTATE_HASH_SIZE]; p; p = p->hnext)
+		if (p->id == id)
+			return p;
+
+	return NULL;
+}
+
+static void sdp_cstate_append(sdp_cstate_list_t *cstate)
+{
+	cstate->next = NULL;
+	cstate->prev = cstates_tail;
+
+	if (cstates_tail)
+		cstates_tail->next = cstate;
+	else
+		cstates_head = cstate;
+
+	cstates_tail = cstate;
+}
+
+static void sdp_cstate_unlink(sdp_cstate_list_t *cstate)
+{
+	if (cstate->prev)
+		cstate->prev->next = cstate->next;
+	else
+		cstates_head = cstate->next;
+
+	if (cstate->next)
+		cstate->next->prev = cstate->prev;
+	else
+		cstates_tail = cstate->prev;
 }
 
-static uint32_t sdp_cstate_alloc_buf(sdp_buf_t *buf)
+static void sdp_cstate_free(sdp_cstate_list_t *cstate)
 {
-	sdp_cstate_list_t *cstate = malloc(sizeof(sdp_cstate_list_t));
-	uint8_t *data = malloc(buf->data_size);
+	sdp_cstate_list_t **p;
+
+	for (p = &cstates_hash[cstate->id % SDP_CSTATE_HASH_SIZE]; *p;
+							p = &(*p)->hnext) {
+		if (*p == cstate) {
+			*p = cstate->hnext;
+			break;
+		}
+	}
+
+	sdp_cstate_unlink(cstate);
+
+	cstates_size -= cstate->buf.data_size;
+
+	free(cstate->buf.data);
+	free(cstate);
+}
+
+static void sdp_cstate_expire(void)
+{
+	uint32_t now = sdp_get_time();
+
+	while (cstates_head && now - cstates_head->timestamp >= SDP_CSTATE_TTL)
+		sdp_cstate_free(cstates_head);
+}
+
+static sdp_buf_t *sdp_get_cached_rsp(int sock, sdp_cont_state_t *cstate)
+{
+	sdp_cstate_list_t *p;
+
+	sdp_cstate_expire();
+
+	p = sdp_cstate_find(cstate->timestamp);
+
+	/* Continuation states can only be used by the client they belong to */
+	if (p == NULL || p->sock != sock)
+		return NULL;
+
+	p->timestamp = sdp_get_time();
+
+	sdp_cstate_unlink(p);
+	sdp_cstate_append(p);
+
+	return &p->buf;
+}
+
+/* The last fragment of the cached response has been sent */
+static void sdp_cstate_release(uint32_t id)
+{
+	sdp_cstate_list_t *p;
+
+	p = sdp_cstate_find(id);
+	if (p)
+		sdp_cstate_free(p);
+}
+
+static uint32_t sdp_cstate_alloc_buf(int sock, sdp_buf_t *buf)
+{
+	sdp_cstate_list_t *cstate;
+	uint8_t *data;
+
+	sdp_cstate_expire();
+
+	/* Make room by dropping the least recently used responses */
+	while (cstates_head &&
+			cstates_size + buf->data_size > SDP_CSTATE_MAX_BYTES)
+		sdp_cstate_free(cstates_head);
+
+	cstate = malloc(sizeof(sdp_cstate_list_t));
+	if (!cstate)
+		return 0;
+
+	data = malloc(buf->data_size);
+	if (!data) {
+		free(cstate);
+		return 0;
+	}
+
+	if (cstates_id == 0)
+		cstates_id = sdp_get_time();
+
+	/* Zero is never handed out, callers use it as "no state" */
+	do {
+		cstates_id++;
+	} while (cstates_id == 0 || sdp_cstate_find(cstates_id));
 
 	memcpy(data, buf->data, buf->data_size);
 	memset((char *)cstate, 0, sizeof(sdp_cstate_list_t));
 	cstate->buf.data = data;
 	cstate->buf.data_size = buf->data_size;
 	cstate->buf.buf_size = buf->data_size;
+	cstate->sock = sock;
+	cstate->id = cstates_id;
 	cstate->timestamp = sdp_get_time();
-	cstate->next = cstates;
-	cstates = cstate;
-	return cstate->timestamp;
+
+	cstate->hnext = cstates_hash[cstate->id % SDP_CSTATE_HASH_SIZE];
+	cstates_hash[cstate->id % SDP_CSTATE_HASH_SIZE] = cstate;
+	sdp_cstate_append(cstate);
+
+	cstates_size += buf->data_size;
+
+	return cstate->id;
+}
+
+/*
+ * Drop the continuation states of a client when its connection
+ * goes away
+ */
+void sdp_cstate_cleanup(int sock)
+{
+	sdp_cstate_list_t *p, *next;
+
+	for (p = cstates_head; p; p = next) {
+		next = p->next;
+
+		if (p->sock == sock)
+			sdp_cstate_free(p);
+	}
 }
 
 /* Additional values for checking datatype (not in spec) */
@@ -312,45 +459,6 @@ static int sdp_cstate_get(uint8_t *buffer, size_t len,
 	return 0;
 }
 
-/*
- * The matching process is defined as "each and every UUID
- * specified in the "search pattern" must be present in the
- * "target pattern". Here "search pattern" is the set of UUIDs
- * specified by the service discovery client and "target pattern"
- * is the set of UUIDs present in a service record.
- *
- * Return 1 if each and every UUID in the search
- * pattern exists in the target pattern, 0 if the
- * match succeeds and -1 on error.
- */
-static int sdp_match_uuid(sdp_list_t *search, sdp_list_t *pattern)
-{
-	/*
-	 * The target is a sorted list, so we need not look
-	 * at all elements to confirm existence of an element
-	 * from the search pattern
-	 */
-	int patlen = sdp_list_len(pattern);
-
-	if (patlen < sdp_list_len(search))
-		return -1;
-	for (; search; search = search->next) {
-		uuid_t *uuid128;
-		void *data = search->data;
-		sdp_list_t *list;
-		if (data == NULL)
-			return -1;
-
-		/* create 128-bit form of the search UUID */
-		uuid128 = sdp_uuid_to_uuid128((uuid_t *)data);
-		list = sdp_list_find(pattern, uuid128, sdp_uuid128_cmp);
-		bt_free(uuid128);
-		if (!list)
-			return 0;
-	}
-	return 1;
-}
-
 /*
  * Service search request PDU. This method extracts the search pattern
  * (a sequence of UUIDs) and calls the matching function
@@ -428,17 +536,19 @@ static int service_search_req(sdp_req_t *req, sdp_buf_t *buf)
 	buf->data_size += sizeof(uint16_t);
 
 	if (cstate == NULL) {
-		/* for every record in the DB, do a pattern search */
-		sdp_list_t *list = sdp_get_record_list();
+		sdp_record_t **recs;
+		int count;
+
+		/* look up the records holding every UUID of the pattern */
+		count = sdp_svcdb_search(pattern, &recs);
 
 		handleSize = 0;
-		for (; list && rsp_count < expected; list = list->next) {
-			sdp_record_t *rec = list->data;
+		for (i = 0; i < count && rsp_count < expected; i++) {
+			sdp_record_t *rec = recs[i];
 
 			SDPDBG("Checking svcRec : 0x%x", rec->handle);
 
-			if (sdp_match_uuid(pattern, rec->pattern) > 0 &&
-					sdp_check_access(rec->handle, &req->device)) {
+			if (sdp_check_access(rec->handle, &req->device)) {
 				rsp_count++;
 				bt_put_be32(rec->handle, pdata);
 				pdata += sizeof(uint32_t);
@@ -446,6 +556,8 @@ static int service_search_req(sdp_req_t *req, sdp_buf_t *buf)
 			}
 		}
 
+		free(recs);
+
 		SDPDBG("Match count: %d", rsp_count);
 
 		buf->data_size += handleSize;
@@ -454,7 +566,7 @@ static int service_search_req(sdp_req_t *req, sdp_buf_t *buf)
 
 		if (rsp_count > actual) {
 			/* cache the rsp and generate a continuation state */
-			cStateId = sdp_cstate_alloc_buf(buf);
+			cStateId = sdp_cstate_alloc_buf(req->sock, buf);
 			/*
 			 * subtract handleSize since we now send only
 			 * a subset of handles
@@ -475,7 +587,7 @@ static int service_search_req(sdp_req_t *req, sdp_buf_t *buf)
 			 * Get the previous sdp_cont_state_t and obtain
 			 * the cached rsp
 			 */
-			sdp_buf_t *pCache = sdp_get_cached_rsp(cstate);
+			sdp_buf_t *pCache = sdp_get_cached_rsp(req->sock, cstate);
 			if (pCache) {
 				pCacheBuffer = pCache->data;
 				/* get the rsp_count from the cached buffer */
@@ -521,6 +633,9 @@ static int service_search_req(sdp_req_t *req, sdp_buf_t *buf)
 		if (i == rsp_count) {
 			/* set "null" continuationState */
 			sdp_set_cstate_pdu(buf, NULL);
+
+			if (cstate)
+				sdp_cstate_release(cstate->timestamp);
 		} else {
 			/*
 			 * there's more: set lastIndexSent to
@@ -556,9 +671,26 @@ done:
  * requested identifiers are present in the PDU form of
  * the request
  */
+/* Index of the first attribute with an ID not lower than id */
+static int record_pdu_lookup(const sdp_record_pdu_t *pdu, uint32_t id)
+{
+	int lo = 0, hi = pdu->count;
+
+	while (lo < hi) {
+		int mid = (lo + hi) / 2;
+
+		if (pdu->ids[mid] < id)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return lo;
+}
+
 static int extract_attrs(sdp_record_t *rec, sdp_list_t *seq, sdp_buf_t *buf)
 {
-	sdp_buf_t pdu;
+	const sdp_record_pdu_t *pdu;
 
 	if (!rec)
 		return SDP_INVALID_RECORD_HANDLE;
@@ -570,53 +702,57 @@ static int extract_attrs(sdp_record_t *rec, sdp_list_t *seq, sdp_buf_t *buf)
 
 	SDPDBG("Entries in attr seq : %d", sdp_list_len(seq));
 
-	sdp_gen_record_pdu(rec, &pdu);
+	pdu = sdp_record_get_pdu(rec);
+	if (!pdu)
+		return SDP_INSUFFICIENT_RESOURCES;
 
 	for (; seq; seq = seq->next) {
 		struct attrid *aid = seq->data;
+		uint16_t low, high;
+		int first, last;
 
 		SDPDBG("AttrDataType : %d", aid->dtd);
 
 		if (aid->dtd == SDP_UINT16) {
-			uint16_t attr = aid->uint16;
-			sdp_data_t *a = sdp_data_get(rec, attr);
-			if (a)
-				sdp_append_to_pdu(buf, a);
+			low = high = aid->uint16;
 		} else if (aid->dtd == SDP_UINT32) {
 			uint32_t range = aid->uint32;
-			uint16_t attr;
-			uint16_t low = (0xffff0000 & range) >> 16;
-			uint16_t high = 0x0000ffff & range;
-			sdp_data_t *data;
+
+			low = (0xffff0000 & range) >> 16;
+			high = 0x0000ffff & range;
 
 			SDPDBG("attr range : 0x%x", range);
 			SDPDBG("Low id : 0x%x", low);
 			SDPDBG("High id : 0x%x", high);
 
-			if (low == 0x0000 && high == 0xffff && pdu.data_size <= buf->buf_size) {
+			if (low == 0x0000 && high == 0xffff &&
+					pdu->buf.data_size <= buf->buf_size) {
 				/* copy it */
-				memcpy(buf->data, pdu.data, pdu.data_size);
-				buf->data_size = pdu.data_size;
+				memcpy(buf->data, pdu->buf.data,
+							pdu->buf.data_size);
+				buf->data_size = pdu->buf.data_size;
 				break;
 			}
-			/* (else) sub-range of attributes */
-			for (attr = low; attr < high; attr++) {
-				data = sdp_data_get(rec, attr);
-				if (data)
-					sdp_append_to_pdu(buf, data);
-			}
-			data = sdp_data_get(rec, high);
-			if (data)
-				sdp_append_to_pdu(buf, data);
+
+			/* An inverted range only ever returned its high ID */
+			if (low > high)
+				low = high;
 		} else {
 			error("Unexpected data type : 0x%x", aid->dtd);
 			error("Expect uint16_t or uint32_t");
-			free(pdu.data);
 			return SDP_INVALID_SYNTAX;
 		}
-	}
 
-	free(pdu.data);
+		/* Attributes are sorted, so any range is a single slice */
+		first = record_pdu_lookup(pdu, low);
+		last = record_pdu_lookup(pdu, high + 1);
+
+		if (first < last)
+			sdp_append_to_buf(buf, pdu->buf.data +
+						pdu->offsets[first],
+						pdu->offsets[last] -
+						pdu->offsets[first]);
+	}
 
 	return 0;
 }
@@ -716,11 +852,12 @@ static int service_attr_req(sdp_req_t *req, sdp_buf_t *buf)
 	buf->buf_size -= sizeof(uint16_t);
 
 	if (cstate) {
-		sdp_buf_t *pCache = sdp_get_cached_rsp(cstate);
+		sdp_buf_t *pCache = sdp_get_cached_rsp(req->sock, cstate);
 
 		SDPDBG("Obtained cached rsp : %p", pCache);
 
-		if (pCache) {
+		if (pCache && cstate->cStateValue.maxBytesSent <
+							pCache->data_size) {
 			short sent = MIN(max_rsp_size, pCache->data_size - cstate->cStateValue.maxBytesSent);
 			pResponse = pCache->data;
 			memcpy(buf->data, pResponse + cstate->cStateValue.maxBytesSent, sent);
@@ -729,9 +866,10 @@ static int service_attr_req(sdp_req_t *req, sdp_buf_t *buf)
 
 			SDPDBG("Response size : %d sending now : %d bytes sent so far : %d",
 				pCache->data_size, sent, cstate->cStateValue.maxBytesSent);
-			if (cstate->cStateValue.maxBytesSent == pCache->data_size)
+			if (cstate->cStateValue.maxBytesSent == pCache->data_size) {
 				cstate_size = sdp_set_cstate_pdu(buf, NULL);
-			else
+				sdp_cstate_release(cstate->timestamp);
+			} else
 				cstate_size = sdp_set_cstate_pdu(buf, cstate);
 		} else {
 			status = SDP_INVALID_CSTATE;
@@ -744,7 +882,7 @@ static int service_attr_req(sdp_req_t *req, sdp_buf_t *buf)
 			sdp_cont_state_t newState;
 
 			memset((char *)&newState, 0, sizeof(sdp_cont_state_t));
-			newState.timestamp = sdp_cstate_alloc_buf(buf);
+			newState.timestamp = sdp_cstate_alloc_buf(req->sock, buf);
 			/*
 			 * Reset the buffer size to the maximum expected and
 			 * set the sdp_cont_state_t
@@ -786,7 +924,7 @@ static int service_search_attr_req(sdp_req_t *req, sdp_buf_t *buf)
 	uint8_t *pdata, *pResponse = NULL;
 	unsigned int max;
 	int scanned, rsp_count = 0;
-	sdp_list_t *pattern = NULL, *seq = NULL, *svcList;
+	sdp_list_t *pattern = NULL, *seq = NULL;
 	sdp_cont_state_t *cstate = NULL;
 	short cstate_size = 0;
 	uint8_t dtd = 0;
@@ -852,8 +990,6 @@ static int service_search_attr_req(sdp_req_t *req, sdp_buf_t *buf)
 		goto done;
 	}
 
-	svcList = sdp_get_record_list();
-
 	tmpbuf.data = malloc(USHRT_MAX);
 	tmpbuf.data_size = 0;
 	tmpbuf.buf_size = USHRT_MAX;
@@ -871,11 +1007,14 @@ static int service_search_attr_req(sdp_req_t *req, sdp_buf_t *buf)
 
 	if (cstate == NULL) {
 		/* no continuation state -> create new response */
-		sdp_list_t *p;
-		for (p = svcList; p; p = p->next) {
-			sdp_record_t *rec = p->data;
-			if (sdp_match_uuid(pattern, rec->pattern) > 0 &&
-					sdp_check_access(rec->handle, &req->device)) {
+		sdp_record_t **recs;
+		int i, count;
+
+		count = sdp_svcdb_search(pattern, &recs);
+
+		for (i = 0; i < count; i++) {
+			sdp_record_t *rec = recs[i];
+			if (sdp_check_access(rec->handle, &req->device)) {
 				rsp_count++;
 				status = extract_attrs(rec, seq, &tmpbuf);
 
@@ -897,11 +1036,14 @@ static int service_search_attr_req(sdp_req_t *req, sdp_buf_t *buf)
 				SDPDBG("Net PDU size : %d", buf->data_size);
 			}
 		}
+
+		free(recs);
+
 		if (buf->data_size > max) {
 			sdp_cont_state_t newState;
 
 			memset((char *)&newState, 0, sizeof(sdp_cont_state_t));
-			newState.timestamp = sdp_cstate_alloc_buf(buf);
+			newState.timestamp = sdp_cstate_alloc_buf(req->sock, buf);
 			/*
 			 * Reset the buffer size to the maximum expected and
 			 * set the sdp_cont_state_t
@@ -913,16 +1055,18 @@ static int service_search_attr_req(sdp_req_t *req, sdp_buf_t *buf)
 			cstate_size = sdp_set_cstate_pdu(buf, NULL);
 	} else {
 		/* continuation State exists -> get from cache */
-		sdp_buf_t *pCache = sdp_get_cached_rsp(cstate);
-		if (pCache) {
+		sdp_buf_t *pCache = sdp_get_cached_rsp(req->sock, cstate);
+		if (pCache && cstate->cStateValue.maxBytesSent <
+							pCache->data_size) {
 			uint16_t sent = MIN(max, pCache->data_size - cstate->cStateValue.maxBytesSent);
 			pResponse = pCache->data;
 			memcpy(buf->data, pResponse + cstate->cStateValue.maxBytesSent, sent);
 			buf->data_size += sent;
 			cstate->cStateValue.maxBytesSent += sent;
-			if (cstate->cStateValue.maxBytesSent == pCache->data_size)
+			if (cstate->cStateValue.maxBytesSent == pCache->data_size) {
 				cstate_size = sdp_set_cstate_pdu(buf, NULL);
-			else
+				sdp_cstate_release(cstate->timestamp);
+			} else
 				cstate_size = sdp_set_cstate_pdu(buf, cstate);
 		} else {
 			status = SDP_INVALID_CSTATE;
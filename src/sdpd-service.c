@@ -82,6 +82,9 @@ uint32_t sdp_get_time(void)
  */
 static void update_db_timestamp(void)
 {
+	/* Called after every change to the registered records */
+	sdp_svcdb_invalidate();
+
 	if (fixed_dbts) {
 		sdp_data_t *d = sdp_data_alloc(SDP_UINT32, &fixed_dbts);
 		sdp_attr_replace(server, SDP_ATTR_SVCDB_STATE, d);
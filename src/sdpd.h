@@ -45,11 +45,24 @@ typedef struct request {
 	int      len;
 } sdp_req_t;
 
+typedef struct _sdp_record_pdu sdp_record_pdu_t;
+
+struct _sdp_record_pdu {
+	sdp_record_pdu_t *next;
+	uint32_t handle;
+	sdp_buf_t buf;		/* as generated by sdp_gen_record_pdu */
+	uint16_t *ids;		/* attribute IDs in ascending order */
+	uint32_t *offsets;	/* start of each attribute in buf, plus end */
+	int count;
+};
+
 void handle_internal_request(int sk, int mtu, void *data, int len);
 void handle_request(int sk, uint8_t *data, int len);
 
 void set_fixed_db_timestamp(uint32_t dbts);
 
+void sdp_cstate_cleanup(int sock);
+
 int service_register_req(sdp_req_t *req, sdp_buf_t *rsp);
 int service_update_req(sdp_req_t *req, sdp_buf_t *rsp);
 int service_remove_req(sdp_req_t *req, sdp_buf_t *rsp);
@@ -64,6 +77,9 @@ void sdp_svcdb_reset(void);
 void sdp_svcdb_collect_all(int sock);
 void sdp_svcdb_set_collectable(sdp_record_t *rec, int sock);
 void sdp_svcdb_collect(sdp_record_t *rec);
+void sdp_svcdb_invalidate(void);
+int sdp_svcdb_search(sdp_list_t *search, sdp_record_t ***records);
+const sdp_record_pdu_t *sdp_record_get_pdu(const sdp_record_t *rec);
 sdp_record_t *sdp_record_find(uint32_t handle);
 void sdp_record_add(const bdaddr_t *device, sdp_record_t *rec);
 int sdp_record_remove(uint32_t handle);
@@ -25,10 +25,14 @@
 #include <config.h>
 #endif
 
+#include <stdio.h>
+#include <errno.h>
 #include <fcntl.h>
 #include <unistd.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <arpa/inet.h>
 
 #include "btsnoop.h"
@@ -68,17 +72,109 @@ static const uint8_t btsnoop_id[] = { 0x62, 0x74, 0x73, 0x6e,
 
 static const uint32_t btsnoop_version = 1;
 
+/* Timestamp of 2000-01-01 00:00:00 UTC in btsnoop microseconds */
+#define BTSNOOP_EPOCH_DELTA	0x00E03AB44A676000ll
+
+struct btsnoop_index_hdr {
+	uint8_t		id[8];		/* Identification Pattern */
+	uint32_t	version;	/* Index Version = 1 */
+	uint32_t	count;		/* Number of records */
+	uint64_t	file_size;	/* Size of the indexed trace */
+	uint64_t	file_mtime;	/* Modification time of the trace */
+} __attribute__ ((packed));
+#define BTSNOOP_INDEX_HDR_SIZE (sizeof(struct btsnoop_index_hdr))
+
+struct btsnoop_index_entry {
+	uint64_t	offset;		/* Record offset in trace */
+	uint64_t	ts;		/* Highest timestamp seen so far */
+} __attribute__ ((packed));
+#define BTSNOOP_INDEX_ENTRY_SIZE (sizeof(struct btsnoop_index_entry))
+
+static const uint8_t btsnoop_index_id[] = { 0x62, 0x74, 0x73, 0x6e,
+					    0x69, 0x64, 0x78, 0x00 };
+
+static const uint32_t btsnoop_index_version = 1;
+
 struct btsnoop {
 	int ref_count;
 	int fd;
 	uint32_t type;
+	uint16_t index;
+	const uint8_t *map;
+	uint8_t *buf;
+	size_t size;
+	size_t offset;
+	uint64_t mtime;
+	struct btsnoop_index_entry *entries;
+	uint32_t count;
+	uint32_t current;
 };
 
+static bool read_full(int fd, void *buf, size_t len)
+{
+	uint8_t *ptr = buf;
+
+	while (len > 0) {
+		ssize_t ret = read(fd, ptr, len);
+
+		if (ret < 0 && errno == EINTR)
+			continue;
+
+		if (ret <= 0)
+			return false;
+
+		ptr += ret;
+		len -= ret;
+	}
+
+	return true;
+}
+
+static bool map_file(struct btsnoop *btsnoop, struct btsnoop_hdr *hdr)
+{
+	struct stat st;
+	void *map;
+
+	if (fstat(btsnoop->fd, &st) < 0 || !S_ISREG(st.st_mode))
+		return false;
+
+	if (st.st_size < (off_t) BTSNOOP_HDR_SIZE)
+		return false;
+
+	map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, btsnoop->fd, 0);
+	if (map == MAP_FAILED)
+		return false;
+
+	madvise(map, st.st_size, MADV_SEQUENTIAL);
+
+	btsnoop->map = map;
+	btsnoop->size = st.st_size;
+	btsnoop->offset = BTSNOOP_HDR_SIZE;
+	btsnoop->mtime = st.st_mtime;
+
+	memcpy(hdr, map, BTSNOOP_HDR_SIZE);
+
+	return true;
+}
+
+/*
+ * Pipes, FIFOs and character devices can't be mapped, so they are read
+ * sequentially into a buffer holding one record. Such a trace has no
+ * index and can't be seeked.
+ */
+static bool open_stream(struct btsnoop *btsnoop, struct btsnoop_hdr *hdr)
+{
+	btsnoop->buf = malloc(BTSNOOP_PKT_SIZE + UINT16_MAX);
+	if (!btsnoop->buf)
+		return false;
+
+	return read_full(btsnoop->fd, hdr, BTSNOOP_HDR_SIZE);
+}
+
 struct btsnoop *btsnoop_open(const char *path)
 {
 	struct btsnoop *btsnoop;
 	struct btsnoop_hdr hdr;
-	ssize_t len;
 
 	btsnoop = calloc(1, sizeof(*btsnoop));
 	if (!btsnoop)
@@ -90,8 +186,7 @@ struct btsnoop *btsnoop_open(const char *path)
 		return NULL;
 	}
 
-	len = read(btsnoop->fd, &hdr, BTSNOOP_HDR_SIZE);
-	if (len < 0 || len != BTSNOOP_HDR_SIZE)
+	if (!map_file(btsnoop, &hdr) && !open_stream(btsnoop, &hdr))
 		goto failed;
 
 	if (memcmp(hdr.id, btsnoop_id, sizeof(btsnoop_id)))
@@ -101,11 +196,16 @@ struct btsnoop *btsnoop_open(const char *path)
 		goto failed;
 
 	btsnoop->type = ntohl(hdr.type);
+	btsnoop->index = 0xffff;
 
 	return btsnoop_ref(btsnoop);
 
 failed:
+	if (btsnoop->map)
+		munmap((void *) btsnoop->map, btsnoop->size);
+
 	close(btsnoop->fd);
+	free(btsnoop->buf);
 	free(btsnoop);
 
 	return NULL;
@@ -129,6 +229,7 @@ struct btsnoop *btsnoop_create(const char *path, uint32_t type)
 	}
 
 	btsnoop->type = type;
+	btsnoop->index = 0xffff;
 
 	memcpy(hdr.id, btsnoop_id, sizeof(btsnoop_id));
 	hdr.version = htonl(btsnoop_version);
@@ -162,9 +263,14 @@ void btsnoop_unref(struct btsnoop *btsnoop)
 	if (__sync_sub_and_fetch(&btsnoop->ref_count, 1))
 		return;
 
+	if (btsnoop->map)
+		munmap((void *) btsnoop->map, btsnoop->size);
+
 	if (btsnoop->fd >= 0)
 		close(btsnoop->fd);
 
+	free(btsnoop->entries);
+	free(btsnoop->buf);
 	free(btsnoop);
 }
 
@@ -186,13 +292,16 @@ bool btsnoop_write(struct btsnoop *btsnoop, struct timeval *tv,
 	if (!btsnoop || !tv)
 		return false;
 
+	if (btsnoop->map || btsnoop->buf)
+		return false;
+
 	ts = (tv->tv_sec - 946684800ll) * 1000000ll + tv->tv_usec;
 
 	pkt.size  = htonl(size);
 	pkt.len   = htonl(size);
 	pkt.flags = htonl(flags);
 	pkt.drops = htonl(0);
-	pkt.ts    = hton64(ts + 0x00E03AB44A676000ll);
+	pkt.ts    = hton64(ts + BTSNOOP_EPOCH_DELTA);
 
 	written = write(btsnoop->fd, &pkt, BTSNOOP_PKT_SIZE);
 	if (written < 0)
@@ -207,6 +316,61 @@ bool btsnoop_write(struct btsnoop *btsnoop, struct timeval *tv,
 	return true;
 }
 
+static uint32_t get_flags_from_opcode(uint16_t opcode)
+{
+	switch (opcode) {
+	case BTSNOOP_OPCODE_NEW_INDEX:
+	case BTSNOOP_OPCODE_DEL_INDEX:
+		break;
+	case BTSNOOP_OPCODE_COMMAND_PKT:
+		return 0x02;
+	case BTSNOOP_OPCODE_EVENT_PKT:
+		return 0x03;
+	case BTSNOOP_OPCODE_ACL_TX_PKT:
+		return 0x00;
+	case BTSNOOP_OPCODE_ACL_RX_PKT:
+		return 0x01;
+	case BTSNOOP_OPCODE_SCO_TX_PKT:
+	case BTSNOOP_OPCODE_SCO_RX_PKT:
+		break;
+	}
+
+	return 0xff;
+}
+
+bool btsnoop_write_hci(struct btsnoop *btsnoop, struct timeval *tv,
+					uint16_t index, uint16_t opcode,
+					const void *data, uint16_t size)
+{
+	uint32_t flags;
+
+	if (!btsnoop)
+		return false;
+
+	switch (btsnoop->type) {
+	case BTSNOOP_TYPE_HCI:
+		if (btsnoop->index == 0xffff)
+			btsnoop->index = index;
+
+		if (index != btsnoop->index)
+			return false;
+
+		flags = get_flags_from_opcode(opcode);
+		if (flags == 0xff)
+			return false;
+		break;
+
+	case BTSNOOP_TYPE_MONITOR:
+		flags = (index << 16) | opcode;
+		break;
+
+	default:
+		return false;
+	}
+
+	return btsnoop_write(btsnoop, tv, flags, data, size);
+}
+
 bool btsnoop_write_phy(struct btsnoop *btsnoop, struct timeval *tv,
 			uint16_t frequency, const void *data, uint16_t size)
 {
@@ -226,3 +390,422 @@ bool btsnoop_write_phy(struct btsnoop *btsnoop, struct timeval *tv,
 
 	return btsnoop_write(btsnoop, tv, flags, data, size);
 }
+
+static const struct btsnoop_pkt *get_pkt(struct btsnoop *btsnoop,
+							size_t offset)
+{
+	const struct btsnoop_pkt *pkt;
+
+	if (btsnoop->size - offset < BTSNOOP_PKT_SIZE)
+		return NULL;
+
+	pkt = (const struct btsnoop_pkt *) (btsnoop->map + offset);
+
+	if (btsnoop->size - offset - BTSNOOP_PKT_SIZE < ntohl(pkt->len))
+		return NULL;
+
+	return pkt;
+}
+
+static const struct btsnoop_pkt *read_pkt(struct btsnoop *btsnoop)
+{
+	struct btsnoop_pkt *pkt = (struct btsnoop_pkt *) btsnoop->buf;
+	ssize_t len;
+
+	do {
+		len = read(btsnoop->fd, pkt, BTSNOOP_PKT_SIZE);
+	} while (len < 0 && errno == EINTR);
+
+	/* Clean end of the trace */
+	if (len == 0)
+		return NULL;
+
+	if (len < 0 || !read_full(btsnoop->fd, btsnoop->buf + len,
+						BTSNOOP_PKT_SIZE - len))
+		return NULL;
+
+	if (ntohl(pkt->len) > UINT16_MAX)
+		return NULL;
+
+	if (!read_full(btsnoop->fd, pkt->data, ntohl(pkt->len)))
+		return NULL;
+
+	return pkt;
+}
+
+static bool load_index(struct btsnoop *btsnoop, const char *path)
+{
+	struct btsnoop_index_hdr hdr;
+	struct btsnoop_index_entry *entries;
+	size_t size;
+	ssize_t len;
+	int fd;
+
+	fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return false;
+
+	len = read(fd, &hdr, BTSNOOP_INDEX_HDR_SIZE);
+	if (len < 0 || len != BTSNOOP_INDEX_HDR_SIZE)
+		goto failed;
+
+	if (memcmp(hdr.id, btsnoop_index_id, sizeof(btsnoop_index_id)))
+		goto failed;
+
+	if (ntohl(hdr.version) != btsnoop_index_version)
+		goto failed;
+
+	/* A stale index belongs to an older version of the trace */
+	if (ntoh64(hdr.file_size) != btsnoop->size ||
+				ntoh64(hdr.file_mtime) != btsnoop->mtime)
+		goto failed;
+
+	size = (size_t) ntohl(hdr.count) * BTSNOOP_INDEX_ENTRY_SIZE;
+
+	entries = malloc(size ? size : 1);
+	if (!entries)
+		goto failed;
+
+	len = read(fd, entries, size);
+	if (len < 0 || (size_t) len != size) {
+		free(entries);
+		goto failed;
+	}
+
+	close(fd);
+
+	free(btsnoop->entries);
+	btsnoop->entries = entries;
+	btsnoop->count = ntohl(hdr.count);
+
+	return true;
+
+failed:
+	close(fd);
+
+	return false;
+}
+
+static void save_index(struct btsnoop *btsnoop, const char *path)
+{
+	struct btsnoop_index_hdr hdr;
+	size_t size;
+	ssize_t written;
+	char *tmp;
+	int fd;
+
+	if (asprintf(&tmp, "%s.XXXXXX", path) < 0)
+		return;
+
+	fd = mkostemp(tmp, O_CLOEXEC);
+	if (fd < 0) {
+		free(tmp);
+		return;
+	}
+
+	fchmod(fd, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+
+	memcpy(hdr.id, btsnoop_index_id, sizeof(btsnoop_index_id));
+	hdr.version = htonl(btsnoop_index_version);
+	hdr.count = htonl(btsnoop->count);
+	hdr.file_size = hton64(btsnoop->size);
+	hdr.file_mtime = hton64(btsnoop->mtime);
+
+	written = write(fd, &hdr, BTSNOOP_INDEX_HDR_SIZE);
+	if (written < 0 || written != BTSNOOP_INDEX_HDR_SIZE)
+		goto failed;
+
+	size = (size_t) btsnoop->count * BTSNOOP_INDEX_ENTRY_SIZE;
+
+	written = write(fd, btsnoop->entries, size);
+	if (written < 0 || (size_t) written != size)
+		goto failed;
+
+	close(fd);
+
+	if (rename(tmp, path) < 0)
+		unlink(tmp);
+
+	free(tmp);
+	return;
+
+failed:
+	close(fd);
+	unlink(tmp);
+	free(tmp);
+}
+
+static bool build_index(struct btsnoop *btsnoop)
+{
+	struct btsnoop_index_entry *entries = NULL;
+	uint32_t count = 0, alloc = 0;
+	uint64_t max_ts = 0;
+	size_t offset = BTSNOOP_HDR_SIZE;
+
+	while (1) {
+		const struct btsnoop_pkt *pkt;
+		uint64_t ts;
+
+		pkt = get_pkt(btsnoop, offset);
+		if (!pkt)
+			break;
+
+		if (count == alloc) {
+			struct btsnoop_index_entry *tmp;
+
+			alloc = alloc ? alloc * 2 : 1024;
+
+			tmp = realloc(entries, alloc * BTSNOOP_INDEX_ENTRY_SIZE);
+			if (!tmp) {
+				free(entries);
+				return false;
+			}
+
+			entries = tmp;
+		}
+
+		/*
+		 * Merged traces are not strictly ordered, so store the
+		 * running maximum to keep the array sorted for lookups.
+		 */
+		ts = ntoh64(pkt->ts);
+		if (ts > max_ts)
+			max_ts = ts;
+
+		entries[count].offset = hton64(offset);
+		entries[count].ts = hton64(max_ts);
+		count++;
+
+		offset += BTSNOOP_PKT_SIZE + ntohl(pkt->len);
+	}
+
+	free(btsnoop->entries);
+	btsnoop->entries = entries;
+	btsnoop->count = count;
+
+	return true;
+}
+
+bool btsnoop_build_index(struct btsnoop *btsnoop, const char *path)
+{
+	if (!btsnoop || !btsnoop->map)
+		return false;
+
+	if (btsnoop->entries)
+		return true;
+
+	if (path && load_index(btsnoop, path))
+		return true;
+
+	if (!build_index(btsnoop))
+		return false;
+
+	if (path)
+		save_index(btsnoop, path);
+
+	return true;
+}
+
+uint32_t btsnoop_get_count(struct btsnoop *btsnoop)
+{
+	if (!btsnoop || !btsnoop_build_index(btsnoop, NULL))
+		return 0;
+
+	return btsnoop->count;
+}
+
+uint32_t btsnoop_tell(struct btsnoop *btsnoop)
+{
+	if (!btsnoop)
+		return 0;
+
+	return btsnoop->current;
+}
+
+bool btsnoop_seek(struct btsnoop *btsnoop, uint32_t num)
+{
+	if (!btsnoop || !btsnoop_build_index(btsnoop, NULL))
+		return false;
+
+	if (num > btsnoop->count)
+		return false;
+
+	btsnoop->current = num;
+
+	if (num == btsnoop->count)
+		btsnoop->offset = btsnoop->size;
+	else
+		btsnoop->offset = ntoh64(btsnoop->entries[num].offset);
+
+	return true;
+}
+
+bool btsnoop_seek_time(struct btsnoop *btsnoop, const struct timeval *tv)
+{
+	uint32_t low, high;
+	uint64_t ts;
+
+	if (!btsnoop || !tv)
+		return false;
+
+	if (!btsnoop_build_index(btsnoop, NULL))
+		return false;
+
+	ts = (tv->tv_sec - 946684800ll) * 1000000ll + tv->tv_usec;
+	ts += BTSNOOP_EPOCH_DELTA;
+
+	/* Find the first record not older than the requested time */
+	low = 0;
+	high = btsnoop->count;
+
+	while (low < high) {
+		uint32_t mid = low + (high - low) / 2;
+
+		if (ntoh64(btsnoop->entries[mid].ts) < ts)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+
+	return btsnoop_seek(btsnoop, low);
+}
+
+bool btsnoop_read(struct btsnoop *btsnoop, struct timeval *tv,
+			uint32_t *flags, const void **data, uint16_t *size)
+{
+	const struct btsnoop_pkt *pkt;
+	uint64_t ts;
+	uint32_t len;
+
+	if (!btsnoop)
+		return false;
+
+	if (btsnoop->map)
+		pkt = get_pkt(btsnoop, btsnoop->offset);
+	else if (btsnoop->buf)
+		pkt = read_pkt(btsnoop);
+	else
+		return false;
+
+	if (!pkt)
+		return false;
+
+	len = ntohl(pkt->len);
+	if (len > UINT16_MAX)
+		return false;
+
+	ts = ntoh64(pkt->ts) - BTSNOOP_EPOCH_DELTA;
+
+	if (tv) {
+		tv->tv_sec = (ts / 1000000ll) + 946684800ll;
+		tv->tv_usec = ts % 1000000ll;
+	}
+
+	if (flags)
+		*flags = ntohl(pkt->flags);
+
+	*data = pkt->data;
+	*size = len;
+
+	btsnoop->offset += BTSNOOP_PKT_SIZE + len;
+	btsnoop->current++;
+
+	return true;
+}
+
+static uint16_t get_opcode_from_flags(uint8_t type, uint32_t flags)
+{
+	switch (type) {
+	case 0x01:
+		return BTSNOOP_OPCODE_COMMAND_PKT;
+	case 0x02:
+		if (flags & 0x01)
+			return BTSNOOP_OPCODE_ACL_RX_PKT;
+		else
+			return BTSNOOP_OPCODE_ACL_TX_PKT;
+	case 0x03:
+		if (flags & 0x01)
+			return BTSNOOP_OPCODE_SCO_RX_PKT;
+		else
+			return BTSNOOP_OPCODE_SCO_TX_PKT;
+	case 0x04:
+		return BTSNOOP_OPCODE_EVENT_PKT;
+	case 0xff:
+		if (flags & 0x02) {
+			if (flags & 0x01)
+				return BTSNOOP_OPCODE_EVENT_PKT;
+			else
+				return BTSNOOP_OPCODE_COMMAND_PKT;
+		} else {
+			if (flags & 0x01)
+				return BTSNOOP_OPCODE_ACL_RX_PKT;
+			else
+				return BTSNOOP_OPCODE_ACL_TX_PKT;
+		}
+		break;
+	}
+
+	return 0xff;
+}
+
+bool btsnoop_read_hci(struct btsnoop *btsnoop, struct timeval *tv,
+					uint16_t *index, uint16_t *opcode,
+					const void **data, uint16_t *size)
+{
+	const uint8_t *buf;
+	uint32_t flags;
+
+	while (1) {
+		if (!btsnoop_read(btsnoop, tv, &flags, data, size))
+			return false;
+
+		buf = *data;
+
+		switch (btsnoop->type) {
+		case BTSNOOP_TYPE_HCI:
+			*index = 0;
+			*opcode = get_opcode_from_flags(0xff, flags);
+			return true;
+
+		case BTSNOOP_TYPE_UART:
+			/* Skip records without an H:4 packet type */
+			if (*size < 1)
+				continue;
+
+			*index = 0;
+			*opcode = get_opcode_from_flags(buf[0], flags);
+			*data = buf + 1;
+			*size -= 1;
+			return true;
+
+		case BTSNOOP_TYPE_MONITOR:
+			*index = flags >> 16;
+			*opcode = flags & 0xffff;
+			return true;
+
+		default:
+			return false;
+		}
+	}
+}
+
+bool btsnoop_read_phy(struct btsnoop *btsnoop, struct timeval *tv,
+					uint16_t *frequency,
+					const void **data, uint16_t *size)
+{
+	uint32_t flags;
+
+	if (!btsnoop || btsnoop->type != BTSNOOP_TYPE_SIMULATOR)
+		return false;
+
+	while (1) {
+		if (!btsnoop_read(btsnoop, tv, &flags, data, size))
+			return false;
+
+		if ((flags >> 16) != 1)
+			continue;
+
+		*frequency = flags & 0xffff;
+		return true;
+	}
+}
@@ -54,5 +54,23 @@ uint32_t btsnoop_get_type(struct btsnoop *btsnoop);
 
 bool btsnoop_write(struct btsnoop *btsnoop, struct timeval *tv,
 			uint32_t flags, const void *data, uint16_t size);
+bool btsnoop_write_hci(struct btsnoop *btsnoop, struct timeval *tv,
+					uint16_t index, uint16_t opcode,
+					const void *data, uint16_t size);
 bool btsnoop_write_phy(struct btsnoop *btsnoop, struct timeval *tv,
 			uint16_t frequency, const void *data, uint16_t size);
+
+bool btsnoop_build_index(struct btsnoop *btsnoop, const char *path);
+uint32_t btsnoop_get_count(struct btsnoop *btsnoop);
+uint32_t btsnoop_tell(struct btsnoop *btsnoop);
+bool btsnoop_seek(struct btsnoop *btsnoop, uint32_t num);
+bool btsnoop_seek_time(struct btsnoop *btsnoop, const struct timeval *tv);
+
+bool btsnoop_read(struct btsnoop *btsnoop, struct timeval *tv,
+			uint32_t *flags, const void **data, uint16_t *size);
+bool btsnoop_read_hci(struct btsnoop *btsnoop, struct timeval *tv,
+					uint16_t *index, uint16_t *opcode,
+					const void **data, uint16_t *size);
+bool btsnoop_read_phy(struct btsnoop *btsnoop, struct timeval *tv,
+					uint16_t *frequency,
+					const void **data, uint16_t *size);
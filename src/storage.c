@@ -33,6 +33,7 @@
 #include <unistd.h>
 #include <stdlib.h>
 #include <time.h>
+#include <string.h>
 #include <sys/file.h>
 #include <sys/stat.h>
 
@@ -45,8 +46,27 @@
 #include "lib/uuid.h"
 #include "textfile.h"
 #include "glib-helper.h"
+#include "log.h"
 #include "storage.h"
 
+/* Seconds to collect updates before writing dirty key files back */
+#define STORAGE_SYNC_DELAY	2
+
+/* Seconds before retrying key files that failed to be written */
+#define STORAGE_RETRY_DELAY	30
+
+/* Clean key files are dropped once the cache grows beyond this */
+#define STORAGE_CACHE_MAX	256
+
+struct storage_file {
+	char *filename;
+	GKeyFile *key_file;
+	gboolean dirty;
+};
+
+static GHashTable *storage_cache = NULL;
+static guint storage_sync_id = 0;
+
 /* When all services should trust a remote device */
 #define GLOBAL_TRUST "[all]"
 
@@ -196,3 +216,245 @@ sdp_record_t *find_record_in_list(sdp_list_t *recs, const char *uuid)
 	}
 	return NULL;
 }
+
+static void storage_file_free(gpointer data)
+{
+	struct storage_file *file = data;
+
+	g_key_file_free(file->key_file);
+	g_free(file->filename);
+	g_free(file);
+}
+
+static int write_file(const char *filename, const char *data, gsize length)
+{
+	char *tmpname;
+	ssize_t written;
+	int fd, err = 0;
+
+	create_file(filename, S_IRUSR | S_IWUSR);
+
+	tmpname = g_strdup_printf("%s.XXXXXX", filename);
+
+	fd = g_mkstemp_full(tmpname, O_WRONLY | O_CLOEXEC, S_IRUSR | S_IWUSR);
+	if (fd < 0) {
+		err = -errno;
+		goto failed;
+	}
+
+	while (length > 0) {
+		written = write(fd, data, length);
+		if (written < 0) {
+			if (errno == EINTR)
+				continue;
+
+			err = -errno;
+			break;
+		}
+
+		data += written;
+		length -= written;
+	}
+
+	if (!err && fdatasync(fd) < 0)
+		err = -errno;
+
+	close(fd);
+
+	if (!err && rename(tmpname, filename) < 0)
+		err = -errno;
+
+	if (err < 0)
+		unlink(tmpname);
+
+failed:
+	if (err < 0)
+		error("Unable to write %s: %s (%d)", filename, strerror(-err),
+									-err);
+
+	g_free(tmpname);
+
+	return err;
+}
+
+static void sync_dir(gpointer key, gpointer value, gpointer user_data)
+{
+	const char *dirname = key;
+	int fd;
+
+	fd = open(dirname, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	if (fd < 0)
+		return;
+
+	fsync(fd);
+	close(fd);
+}
+
+static void sync_file(gpointer key, gpointer value, gpointer user_data)
+{
+	struct storage_file *file = value;
+	GHashTable *dirs = user_data;
+	struct stat st;
+	char *data;
+	gsize length = 0;
+
+	if (!file->dirty)
+		return;
+
+	data = g_key_file_to_data(file->key_file, &length, NULL);
+
+	/* Don't leave empty files behind for entries never stored before */
+	if (length == 0 && stat(file->filename, &st) < 0)
+		goto done;
+
+	/* Keep the entry dirty so that the write gets retried */
+	if (write_file(file->filename, data, length) < 0) {
+		g_free(data);
+		return;
+	}
+
+	g_hash_table_insert(dirs, g_path_get_dirname(file->filename), NULL);
+
+done:
+	file->dirty = FALSE;
+	g_free(data);
+}
+
+static gboolean is_clean(gpointer key, gpointer value, gpointer user_data)
+{
+	struct storage_file *file = value;
+
+	return !file->dirty;
+}
+
+static gboolean is_dirty(gpointer key, gpointer value, gpointer user_data)
+{
+	struct storage_file *file = value;
+
+	return file->dirty;
+}
+
+static void schedule_sync(guint delay);
+
+void storage_sync(void)
+{
+	GHashTable *dirs;
+
+	if (storage_sync_id > 0) {
+		g_source_remove(storage_sync_id);
+		storage_sync_id = 0;
+	}
+
+	if (!storage_cache)
+		return;
+
+	dirs = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+
+	g_hash_table_foreach(storage_cache, sync_file, dirs);
+
+	/* Make the renames durable with a single fsync per directory */
+	g_hash_table_foreach(dirs, sync_dir, NULL);
+
+	g_hash_table_destroy(dirs);
+
+	if (g_hash_table_size(storage_cache) > STORAGE_CACHE_MAX)
+		g_hash_table_foreach_remove(storage_cache, is_clean, NULL);
+
+	if (g_hash_table_find(storage_cache, is_dirty, NULL))
+		schedule_sync(STORAGE_RETRY_DELAY);
+}
+
+static gboolean storage_sync_cb(gpointer user_data)
+{
+	storage_sync_id = 0;
+
+	storage_sync();
+
+	return FALSE;
+}
+
+static void schedule_sync(guint delay)
+{
+	if (storage_sync_id > 0)
+		return;
+
+	storage_sync_id = g_timeout_add_seconds(delay, storage_sync_cb, NULL);
+}
+
+GKeyFile *storage_get(const char *filename)
+{
+	struct storage_file *file;
+
+	if (!storage_cache)
+		storage_cache = g_hash_table_new_full(g_str_hash, g_str_equal,
+						NULL, storage_file_free);
+
+	file = g_hash_table_lookup(storage_cache, filename);
+	if (file)
+		return file->key_file;
+
+	file = g_new0(struct storage_file, 1);
+	file->filename = g_strdup(filename);
+	file->key_file = g_key_file_new();
+	g_key_file_load_from_file(file->key_file, filename, 0, NULL);
+
+	g_hash_table_insert(storage_cache, file->filename, file);
+
+	/* Trimming is deferred so that returned key files stay valid */
+	if (g_hash_table_size(storage_cache) > STORAGE_CACHE_MAX)
+		schedule_sync(STORAGE_SYNC_DELAY);
+
+	return file->key_file;
+}
+
+void storage_commit(const char *filename)
+{
+	struct storage_file *file;
+
+	if (!storage_cache)
+		return;
+
+	file = g_hash_table_lookup(storage_cache, filename);
+	if (!file)
+		return;
+
+	file->dirty = TRUE;
+
+	schedule_sync(STORAGE_SYNC_DELAY);
+}
+
+static gboolean match_path(gpointer key, gpointer value, gpointer user_data)
+{
+	const char *filename = key;
+	const char *path = user_data;
+	size_t len = strlen(path);
+
+	if (strncmp(filename, path, len))
+		return FALSE;
+
+	return filename[len] == '\0' || filename[len] == '/';
+}
+
+void storage_remove(const char *path)
+{
+	if (!storage_cache)
+		return;
+
+	g_hash_table_foreach_remove(storage_cache, match_path, (gpointer) path);
+}
+
+void storage_cleanup(void)
+{
+	storage_sync();
+
+	if (!storage_cache)
+		return;
+
+	g_hash_table_destroy(storage_cache);
+	storage_cache = NULL;
+
+	if (storage_sync_id > 0) {
+		g_source_remove(storage_sync_id);
+		storage_sync_id = 0;
+	}
+}
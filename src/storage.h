@@ -29,3 +29,9 @@ int read_on_mode(const char *src, char *mode, int length);
 int read_local_name(const bdaddr_t *bdaddr, char *name);
 sdp_record_t *record_from_string(const char *str);
 sdp_record_t *find_record_in_list(sdp_list_t *recs, const char *uuid);
+
+GKeyFile *storage_get(const char *filename);
+void storage_commit(const char *filename);
+void storage_remove(const char *path);
+void storage_sync(void);
+void storage_cleanup(void);
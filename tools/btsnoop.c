@@ -37,8 +37,9 @@
 #include <getopt.h>
 #include <arpa/inet.h>
 #include <sys/stat.h>
+#include <sys/time.h>
 
-#include "monitor/btsnoop.h"
+#include "src/shared/btsnoop.h"
 
 static inline uint64_t ntoh64(uint64_t n)
 {
@@ -283,46 +284,97 @@ close_input:
 		close(input_fd[i]);
 }
 
-static void command_extract_eir(const char *input)
+/* Time window to extract from, as offsets from the first record */
+struct window {
+	const struct timeval *begin;
+	const struct timeval *end;
+	struct timeval limit;
+};
+
+static bool seek_window(struct btsnoop *btsnoop, struct window *window)
 {
-	struct btsnoop_pkt pkt;
-	unsigned char buf[2048];
-	ssize_t len;
-	uint32_t type, toread, flags;
-	uint16_t opcode;
-	int fd, count = 0;
+	struct timeval first, tv;
+	const void *data;
+	uint16_t size;
 
-	fd = open_btsnoop(input, &type);
-	if (fd < 0)
-		return;
+	if (!window->begin && !window->end)
+		return true;
 
-	if (type != 2001) {
-		fprintf(stderr, "unsupported link data type %u\n", type);
-		close(fd);
-		return;
+	if (!btsnoop_read(btsnoop, &first, NULL, &data, &size))
+		return false;
+
+	if (window->end)
+		timeradd(&first, window->end, &window->limit);
+
+	if (!window->begin)
+		return btsnoop_seek(btsnoop, 0);
+
+	timeradd(&first, window->begin, &tv);
+
+	return btsnoop_seek_time(btsnoop, &tv);
+}
+
+static bool window_passed(const struct window *window,
+						const struct timeval *tv)
+{
+	return window->end && timercmp(tv, &window->limit, >);
+}
+
+static struct btsnoop *open_input(const char *input, uint32_t type,
+						struct window *window)
+{
+	struct btsnoop *btsnoop;
+
+	btsnoop = btsnoop_open(input);
+	if (!btsnoop) {
+		fprintf(stderr, "failed to open btsnoop file\n");
+		return NULL;
 	}
 
-next_packet:
-	len = read(fd, &pkt, BTSNOOP_PKT_SIZE);
-	if (len < 0 || len != BTSNOOP_PKT_SIZE)
-		goto close_input;
+	if (btsnoop_get_type(btsnoop) != type) {
+		fprintf(stderr, "unsupported link data type %u\n",
+						btsnoop_get_type(btsnoop));
+		btsnoop_unref(btsnoop);
+		return NULL;
+	}
 
-	toread = ntohl(pkt.size);
-	flags = ntohl(pkt.flags);
+	if (!seek_window(btsnoop, window)) {
+		fprintf(stderr, "failed to seek in btsnoop file\n");
+		btsnoop_unref(btsnoop);
+		return NULL;
+	}
 
-	opcode = flags & 0x00ff;
+	return btsnoop;
+}
 
-	len = read(fd, buf, toread);
-	if (len < 0 || len != (ssize_t) toread) {
-		fprintf(stderr, "failed to read packet data\n");
+static void command_extract_eir(const char *input, struct window *window)
+{
+	struct btsnoop *btsnoop;
+	struct timeval tv;
+	const uint8_t *buf;
+	const void *data;
+	uint16_t size, index, opcode;
+	int count = 0;
+
+	btsnoop = open_input(input, BTSNOOP_TYPE_MONITOR, window);
+	if (!btsnoop)
+		return;
+
+next_packet:
+	if (!btsnoop_read_hci(btsnoop, &tv, &index, &opcode, &data, &size))
 		goto close_input;
-	}
+
+	if (window_passed(window, &tv))
+		goto close_input;
+
+	buf = data;
 
 	switch (opcode) {
 	case BTSNOOP_OPCODE_EVENT_PKT:
 		/* extended inquiry result event */
 		if (buf[0] == 0x2f) {
-			uint8_t *eir_ptr, eir_len, i;
+			const uint8_t *eir_ptr;
+			uint8_t eir_len, i;
 
 			eir_len = buf[1] - 15;
 			eir_ptr = buf + 17;
@@ -353,49 +405,37 @@ next_packet:
 	goto next_packet;
 
 close_input:
-	close(fd);
+	btsnoop_unref(btsnoop);
 }
 
-static void command_extract_ad(const char *input)
+static void command_extract_ad(const char *input, struct window *window)
 {
-	struct btsnoop_pkt pkt;
-	unsigned char buf[2048];
-	ssize_t len;
-	uint32_t type, toread, flags;
-	uint16_t opcode;
-	int fd, count = 0;
-
-	fd = open_btsnoop(input, &type);
-	if (fd < 0)
+	struct btsnoop *btsnoop;
+	struct timeval tv;
+	const uint8_t *buf;
+	const void *data;
+	uint16_t size, index, opcode;
+	int count = 0;
+
+	btsnoop = open_input(input, BTSNOOP_TYPE_MONITOR, window);
+	if (!btsnoop)
 		return;
 
-	if (type != 2001) {
-		fprintf(stderr, "unsupported link data type %u\n", type);
-		close(fd);
-		return;
-	}
-
 next_packet:
-	len = read(fd, &pkt, BTSNOOP_PKT_SIZE);
-	if (len < 0 || len != BTSNOOP_PKT_SIZE)
+	if (!btsnoop_read_hci(btsnoop, &tv, &index, &opcode, &data, &size))
 		goto close_input;
 
-	toread = ntohl(pkt.size);
-	flags = ntohl(pkt.flags);
-
-	opcode = flags & 0x00ff;
-
-	len = read(fd, buf, toread);
-	if (len < 0 || len != (ssize_t) toread) {
-		fprintf(stderr, "failed to read packet data\n");
+	if (window_passed(window, &tv))
 		goto close_input;
-	}
+
+	buf = data;
 
 	switch (opcode) {
 	case BTSNOOP_OPCODE_EVENT_PKT:
 		/* advertising report */
 		if (buf[0] == 0x3e && buf[2] == 0x02) {
-			uint8_t *ad_ptr, ad_len, i;
+			const uint8_t *ad_ptr;
+			uint8_t ad_len, i;
 
 			ad_len = buf[12];
 			ad_ptr = buf + 13;
@@ -425,45 +465,37 @@ next_packet:
 	goto next_packet;
 
 close_input:
-	close(fd);
+	btsnoop_unref(btsnoop);
 }
+
 static const uint8_t conn_complete[] = { 0x04, 0x03, 0x0B, 0x00 };
 static const uint8_t disc_complete[] = { 0x04, 0x05, 0x04, 0x00 };
 
-static void command_extract_sdp(const char *input)
+static void command_extract_sdp(const char *input, struct window *window)
 {
-	struct btsnoop_pkt pkt;
-	unsigned char buf[2048];
-	ssize_t len;
-	uint32_t type, toread;
+	struct btsnoop *btsnoop;
+	struct timeval tv;
+	const uint8_t *buf;
+	const void *data;
+	uint16_t len;
 	uint16_t current_cid = 0x0000;
 	uint8_t pdu_buf[512];
 	uint16_t pdu_len = 0;
 	bool pdu_first = false;
-	int fd, count = 0;
+	int count = 0;
 
-	fd = open_btsnoop(input, &type);
-	if (fd < 0)
+	btsnoop = open_input(input, BTSNOOP_TYPE_UART, window);
+	if (!btsnoop)
 		return;
 
-	if (type != 1002) {
-		fprintf(stderr, "unsupported link data type %u\n", type);
-		close(fd);
-		return;
-	}
-
 next_packet:
-	len = read(fd, &pkt, BTSNOOP_PKT_SIZE);
-	if (len < 0 || len != BTSNOOP_PKT_SIZE)
+	if (!btsnoop_read(btsnoop, &tv, NULL, &data, &len))
 		goto close_input;
 
-	toread = ntohl(pkt.size);
-
-	len = read(fd, buf, toread);
-	if (len < 0 || len != (ssize_t) toread) {
-		fprintf(stderr, "failed to read packet data\n");
+	if (window_passed(window, &tv))
 		goto close_input;
-	}
+
+	buf = data;
 
 	if (buf[0] == 0x02) {
 		uint8_t acl_flags;
@@ -518,7 +550,245 @@ next_packet:
 	goto next_packet;
 
 close_input:
-	close(fd);
+	btsnoop_unref(btsnoop);
+}
+
+#define GENERATE_CONTROLLERS	4
+#define GENERATE_MAX_HANDLES	0x0eff
+
+struct generator {
+	uint32_t seed;
+	unsigned int handles;
+	/* Fragment bytes left per controller, handle and direction */
+	uint16_t *pending;
+};
+
+/*
+ * Fixed-seed generator, so the same trace is produced on every run and
+ * decoding times can be compared across machines.
+ */
+static uint32_t generate_rand(uint32_t *seed)
+{
+	*seed = *seed * 1103515245 + 12345;
+
+	return *seed >> 16;
+}
+
+static bool generate_record(struct btsnoop *btsnoop, struct timeval *tv,
+					uint16_t index, struct generator *gen)
+{
+	static const uint8_t read_version[] = { 0x01, 0x10, 0x00 };
+	static const uint8_t version_complete[] = {
+				0x0e, 0x0c, 0x01, 0x01, 0x10, 0x00, 0x06,
+				0x00, 0x00, 0x06, 0x0f, 0x00, 0x00, 0x00 };
+	static const uint8_t adv_report[] = {
+				0x3e, 0x1b, 0x02, 0x01, 0x00, 0x00,
+				0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x0f,
+				0x02, 0x01, 0x06, 0x05, 0x03, 0x0a, 0x18,
+				0x0d, 0x18, 0x05, 0x09, 0x54, 0x65, 0x73,
+				0x74, 0xc4 };
+	uint32_t *seed = &gen->seed;
+	uint8_t buf[32];
+	uint16_t handle = 1 + generate_rand(seed) % gen->handles;
+
+	tv->tv_usec += 1 + generate_rand(seed) % 5000;
+	if (tv->tv_usec >= 1000000) {
+		tv->tv_sec++;
+		tv->tv_usec -= 1000000;
+	}
+
+	switch (generate_rand(seed) % 5) {
+	case 0:
+		return btsnoop_write_hci(btsnoop, tv, index,
+					BTSNOOP_OPCODE_COMMAND_PKT,
+					read_version, sizeof(read_version));
+	case 1:
+		return btsnoop_write_hci(btsnoop, tv, index,
+					BTSNOOP_OPCODE_EVENT_PKT,
+					version_complete,
+					sizeof(version_complete));
+	case 2:
+		return btsnoop_write_hci(btsnoop, tv, index,
+					BTSNOOP_OPCODE_EVENT_PKT,
+					adv_report, sizeof(adv_report));
+	case 3:
+		/* Connection Complete */
+		memset(buf, 0, 13);
+		buf[0] = 0x03;
+		buf[1] = 11;
+		buf[3] = handle & 0xff;
+		buf[4] = handle >> 8;
+		buf[11] = 0x01;
+		return btsnoop_write_hci(btsnoop, tv, index,
+					BTSNOOP_OPCODE_EVENT_PKT, buf, 13);
+	default:
+		/* L2CAP Connection Request on the signaling channel */
+		buf[0] = handle & 0xff;
+		buf[1] = (handle >> 8) | 0x20;
+		buf[2] = 12;
+		buf[3] = 0;
+		buf[4] = 8;
+		buf[5] = 0;
+		buf[6] = 0x01;
+		buf[7] = 0x00;
+		buf[8] = 0x02;
+		buf[9] = 1 + generate_rand(seed) % 200;
+		buf[10] = 4;
+		buf[11] = 0;
+		buf[12] = 0x01;
+		buf[13] = 0x00;
+		buf[14] = 0x40;
+		buf[15] = 0x00;
+		return btsnoop_write_hci(btsnoop, tv, index,
+					BTSNOOP_OPCODE_ACL_RX_PKT, buf, 16);
+	}
+}
+
+/*
+ * Interleave fragmented L2CAP Echo Requests in both directions across all
+ * links, and disconnect links while a PDU is still in flight so the handle
+ * gets reused with stale fragments pending.  Decoding the result must not
+ * report any fragment errors.
+ */
+static bool generate_fragment(struct btsnoop *btsnoop, struct timeval *tv,
+					uint16_t index, struct generator *gen)
+{
+	uint32_t *seed = &gen->seed;
+	uint16_t handle = 1 + generate_rand(seed) % gen->handles;
+	bool in = generate_rand(seed) % 2;
+	uint16_t *link, *left;
+	uint16_t opcode, len, size;
+	uint8_t buf[256];
+
+	link = &gen->pending[(index * gen->handles + handle - 1) * 2];
+	left = &link[in];
+
+	tv->tv_usec += 1 + generate_rand(seed) % 5000;
+	if (tv->tv_usec >= 1000000) {
+		tv->tv_sec++;
+		tv->tv_usec -= 1000000;
+	}
+
+	if (generate_rand(seed) % 64 == 0) {
+		/* Disconnection Complete */
+		buf[0] = 0x05;
+		buf[1] = 4;
+		buf[2] = 0x00;
+		buf[3] = handle & 0xff;
+		buf[4] = handle >> 8;
+		buf[5] = 0x13;
+
+		link[0] = 0;
+		link[1] = 0;
+
+		return btsnoop_write_hci(btsnoop, tv, index,
+					BTSNOOP_OPCODE_EVENT_PKT, buf, 6);
+	}
+
+	opcode = in ? BTSNOOP_OPCODE_ACL_RX_PKT : BTSNOOP_OPCODE_ACL_TX_PKT;
+
+	buf[0] = handle & 0xff;
+
+	if (*left) {
+		/* continuing fragment */
+		size = 1 + generate_rand(seed) % 27;
+		if (size > *left)
+			size = *left;
+
+		*left -= size;
+
+		buf[1] = (handle >> 8) | 0x10;
+		buf[2] = size & 0xff;
+		buf[3] = size >> 8;
+		memset(buf + 4, 0xa5, size);
+
+		return btsnoop_write_hci(btsnoop, tv, index, opcode,
+							buf, 4 + size);
+	}
+
+	/* start of an Echo Request split over several fragments */
+	len = 8 + generate_rand(seed) % 200;
+	size = 1 + generate_rand(seed) % len;
+
+	*left = len - size;
+
+	buf[1] = (handle >> 8) | 0x20;
+	buf[2] = (8 + size) & 0xff;
+	buf[3] = (8 + size) >> 8;
+	buf[4] = (4 + len) & 0xff;
+	buf[5] = (4 + len) >> 8;
+	buf[6] = 0x01;
+	buf[7] = 0x00;
+	buf[8] = 0x08;
+	buf[9] = 1 + generate_rand(seed) % 200;
+	buf[10] = len & 0xff;
+	buf[11] = len >> 8;
+	memset(buf + 12, 0xa5, size);
+
+	return btsnoop_write_hci(btsnoop, tv, index, opcode, buf, 12 + size);
+}
+
+static void command_generate(const char *output, unsigned int count,
+					unsigned int handles, bool fragment)
+{
+	struct btsnoop *btsnoop;
+	struct generator gen;
+	struct timeval tv;
+	uint16_t index;
+	unsigned int i;
+	bool ret;
+
+	if (handles < 1 || handles > GENERATE_MAX_HANDLES) {
+		fprintf(stderr, "Handles must be between 1 and %u\n",
+							GENERATE_MAX_HANDLES);
+		return;
+	}
+
+	gen.seed = 1;
+	gen.handles = handles;
+	gen.pending = calloc(GENERATE_CONTROLLERS * handles * 2,
+							sizeof(uint16_t));
+	if (!gen.pending) {
+		fprintf(stderr, "Failed to allocate generator state\n");
+		return;
+	}
+
+	btsnoop = btsnoop_create(output, BTSNOOP_TYPE_MONITOR);
+	if (!btsnoop) {
+		fprintf(stderr, "Failed to create %s\n", output);
+		free(gen.pending);
+		return;
+	}
+
+	tv.tv_sec = 1000000000;
+	tv.tv_usec = 0;
+
+	for (index = 0; index < GENERATE_CONTROLLERS; index++) {
+		uint8_t new_index[16] = { 0x00, 0x01, index, 0x00, 0x00,
+						0x00, 0x00, 0xaa, 'h', 'c', 'i',
+						'0' + index };
+
+		btsnoop_write_hci(btsnoop, &tv, index,
+					BTSNOOP_OPCODE_NEW_INDEX,
+					new_index, sizeof(new_index));
+	}
+
+	for (i = 0; i < count; i++) {
+		index = generate_rand(&gen.seed) % GENERATE_CONTROLLERS;
+
+		if (fragment)
+			ret = generate_fragment(btsnoop, &tv, index, &gen);
+		else
+			ret = generate_record(btsnoop, &tv, index, &gen);
+
+		if (!ret) {
+			fprintf(stderr, "Failed to write %s\n", output);
+			break;
+		}
+	}
+
+	btsnoop_unref(btsnoop);
+	free(gen.pending);
 }
 
 static void usage(void)
@@ -527,33 +797,67 @@ static void usage(void)
 		"Usage:\n");
 	printf("\tbtsnoop <command> [files]\n");
 	printf("commands:\n"
-		"\t-m, --merge <output>   Merge multiple btsnoop files\n"
-		"\t-e, --extract <input>  Extract data from btsnoop file\n"
-		"\t-h, --help             Show help options\n");
+		"\t-m, --merge <output>    Merge multiple btsnoop files\n"
+		"\t-e, --extract <input>   Extract data from btsnoop file\n"
+		"\t-g, --generate <output> Generate synthetic trace file\n"
+		"\t-h, --help              Show help options\n");
+	printf("options:\n"
+		"\t-B, --begin <seconds>   Extract from time offset\n"
+		"\t-E, --end <seconds>     Extract up to time offset\n"
+		"\t-c, --count <records>   Records to generate (500000)\n"
+		"\t-H, --handles <num>     Links per controller (16)\n"
+		"\t-f, --fragment          Generate fragmented ACL traffic\n");
 }
 
 static const struct option main_options[] = {
 	{ "merge",   required_argument, NULL, 'm' },
 	{ "extract", required_argument, NULL, 'e' },
+	{ "generate", required_argument, NULL, 'g' },
+	{ "begin",   required_argument, NULL, 'B' },
+	{ "end",     required_argument, NULL, 'E' },
+	{ "count",   required_argument, NULL, 'c' },
+	{ "handles", required_argument, NULL, 'H' },
+	{ "fragment", no_argument,      NULL, 'f' },
 	{ "type",    required_argument, NULL, 't' },
 	{ "version", no_argument,       NULL, 'v' },
 	{ "help",    no_argument,       NULL, 'h' },
 	{ }
 };
 
-enum { INVALID, MERGE, EXTRACT };
+enum { INVALID, MERGE, EXTRACT, GENERATE };
+
+static bool parse_offset(const char *str, struct timeval *tv)
+{
+	char *end;
+	double secs;
+
+	secs = strtod(str, &end);
+	if (end == str || *end != '\0' || secs < 0)
+		return false;
+
+	tv->tv_sec = secs;
+	tv->tv_usec = (secs - tv->tv_sec) * 1000000;
+
+	return true;
+}
 
 int main(int argc, char *argv[])
 {
 	const char *output_path = NULL;
 	const char *input_path = NULL;
 	const char *type = NULL;
+	struct timeval begin, end;
+	struct window window = { };
+	unsigned int count = 500000;
+	unsigned int handles = 16;
+	bool fragment = false;
 	unsigned short command = INVALID;
 
 	for (;;) {
 		int opt;
 
-		opt = getopt_long(argc, argv, "m:e:t:vh", main_options, NULL);
+		opt = getopt_long(argc, argv, "m:e:g:B:E:c:H:ft:vh",
+						main_options, NULL);
 		if (opt < 0)
 			break;
 
@@ -566,6 +870,33 @@ int main(int argc, char *argv[])
 			command = EXTRACT;
 			input_path = optarg;
 			break;
+		case 'g':
+			command = GENERATE;
+			output_path = optarg;
+			break;
+		case 'B':
+			if (!parse_offset(optarg, &begin)) {
+				usage();
+				return EXIT_FAILURE;
+			}
+			window.begin = &begin;
+			break;
+		case 'E':
+			if (!parse_offset(optarg, &end)) {
+				usage();
+				return EXIT_FAILURE;
+			}
+			window.end = &end;
+			break;
+		case 'c':
+			count = atoi(optarg);
+			break;
+		case 'H':
+			handles = atoi(optarg);
+			break;
+		case 'f':
+			fragment = true;
+			break;
 		case 't':
 			type = optarg;
 			break;
@@ -602,15 +933,24 @@ int main(int argc, char *argv[])
 		}
 
 		if (!strcasecmp(type, "eir"))
-			command_extract_eir(input_path);
+			command_extract_eir(input_path, &window);
 		else if (!strcasecmp(type, "ad"))
-			command_extract_ad(input_path);
+			command_extract_ad(input_path, &window);
 		else if (!strcasecmp(type, "sdp"))
-			command_extract_sdp(input_path);
+			command_extract_sdp(input_path, &window);
 		else
 			fprintf(stderr, "extract type not supported\n");
 		break;
 
+	case GENERATE:
+		if (argc - optind > 0) {
+			fprintf(stderr, "extra arguments not allowed\n");
+			return EXIT_FAILURE;
+		}
+
+		command_generate(output_path, count, handles, fragment);
+		break;
+
 	default:
 		usage();
 		return EXIT_FAILURE;
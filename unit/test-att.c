@@ -0,0 +1,339 @@
+/*
+ *
+ *  BlueZ - Bluetooth protocol stack for Linux
+ *
+ *  Copyright (C) 2013  Intel Corporation. All rights reserved.
+ *
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <string.h>
+
+#include <glib.h>
+
+#include "lib/uuid.h"
+#include "attrib/att.h"
+
+#define ATT_MAX_MTU 517
+
+struct list_data {
+	uint8_t opcode;
+	uint16_t mtu;
+	uint16_t elen;
+	uint8_t format;
+	gboolean valid;
+	uint16_t expect_elen;
+	unsigned int entries;
+};
+
+static const struct list_data grp_mtu_23 = {
+	.opcode = ATT_OP_READ_BY_GROUP_RESP,
+	.mtu = 23,
+	.elen = 6,
+	.valid = TRUE,
+	.expect_elen = 6,
+	.entries = 3,
+};
+
+static const struct list_data grp_mtu_517 = {
+	.opcode = ATT_OP_READ_BY_GROUP_RESP,
+	.mtu = ATT_MAX_MTU,
+	.elen = 20,
+	.valid = TRUE,
+	.expect_elen = 20,
+	.entries = 25,
+};
+
+static const struct list_data grp_mtu_short = {
+	.opcode = ATT_OP_READ_BY_GROUP_RESP,
+	.mtu = 7,
+	.elen = 6,
+	.valid = FALSE,
+};
+
+static const struct list_data grp_elen_long = {
+	.opcode = ATT_OP_READ_BY_GROUP_RESP,
+	.mtu = ATT_MAX_MTU,
+	.elen = 300,
+	.valid = FALSE,
+};
+
+static const struct list_data type_mtu_23 = {
+	.opcode = ATT_OP_READ_BY_TYPE_RESP,
+	.mtu = 23,
+	.elen = 7,
+	.valid = TRUE,
+	.expect_elen = 7,
+	.entries = 3,
+};
+
+static const struct list_data type_truncated_23 = {
+	.opcode = ATT_OP_READ_BY_TYPE_RESP,
+	.mtu = 23,
+	.elen = 300,
+	.valid = TRUE,
+	.expect_elen = 21,
+	.entries = 1,
+};
+
+static const struct list_data type_truncated_517 = {
+	.opcode = ATT_OP_READ_BY_TYPE_RESP,
+	.mtu = ATT_MAX_MTU,
+	.elen = 300,
+	.valid = TRUE,
+	.expect_elen = 255,
+	.entries = 2,
+};
+
+static const struct list_data info_16_mtu_23 = {
+	.opcode = ATT_OP_FIND_INFO_RESP,
+	.mtu = 23,
+	.format = ATT_FIND_INFO_RESP_FMT_16BIT,
+	.valid = TRUE,
+	.expect_elen = 4,
+	.entries = 5,
+};
+
+static const struct list_data info_128_mtu_23 = {
+	.opcode = ATT_OP_FIND_INFO_RESP,
+	.mtu = 23,
+	.format = ATT_FIND_INFO_RESP_FMT_128BIT,
+	.valid = TRUE,
+	.expect_elen = 18,
+	.entries = 1,
+};
+
+static const struct list_data info_128_mtu_517 = {
+	.opcode = ATT_OP_FIND_INFO_RESP,
+	.mtu = ATT_MAX_MTU,
+	.format = ATT_FIND_INFO_RESP_FMT_128BIT,
+	.valid = TRUE,
+	.expect_elen = 18,
+	.entries = 28,
+};
+
+static const struct list_data info_bad_format = {
+	.opcode = ATT_OP_FIND_INFO_RESP,
+	.mtu = 23,
+	.format = 0x03,
+	.valid = FALSE,
+};
+
+static const struct list_data type_value_mtu_23 = {
+	.opcode = ATT_OP_FIND_BY_TYPE_RESP,
+	.mtu = 23,
+	.valid = TRUE,
+	.expect_elen = 4,
+	.entries = 5,
+};
+
+static const struct list_data type_value_mtu_517 = {
+	.opcode = ATT_OP_FIND_BY_TYPE_RESP,
+	.mtu = ATT_MAX_MTU,
+	.valid = TRUE,
+	.expect_elen = 4,
+	.entries = 129,
+};
+
+static gboolean writer_init(const struct list_data *data,
+				struct att_writer *writer, uint8_t *pdu)
+{
+	switch (data->opcode) {
+	case ATT_OP_READ_BY_GROUP_RESP:
+		return enc_read_by_grp_resp_init(writer, data->elen, pdu,
+								data->mtu);
+	case ATT_OP_READ_BY_TYPE_RESP:
+		return enc_read_by_type_resp_init(writer, data->elen, pdu,
+								data->mtu);
+	case ATT_OP_FIND_INFO_RESP:
+		return enc_find_info_resp_init(writer, data->format, pdu,
+								data->mtu);
+	case ATT_OP_FIND_BY_TYPE_RESP:
+		return enc_find_by_type_resp_init(writer, pdu, data->mtu);
+	}
+
+	return FALSE;
+}
+
+static gboolean iter_init(const struct list_data *data, const uint8_t *pdu,
+					size_t len, struct att_iter *iter)
+{
+	uint8_t format;
+	gboolean ret;
+
+	switch (data->opcode) {
+	case ATT_OP_READ_BY_GROUP_RESP:
+		return dec_read_by_grp_resp_iter(pdu, len, iter);
+	case ATT_OP_READ_BY_TYPE_RESP:
+		return dec_read_by_type_resp_iter(pdu, len, iter);
+	case ATT_OP_FIND_INFO_RESP:
+		ret = dec_find_info_resp_iter(pdu, len, &format, iter);
+		if (ret)
+			g_assert_cmpuint(format, ==, data->format);
+		return ret;
+	case ATT_OP_FIND_BY_TYPE_RESP:
+		return dec_find_by_type_resp_iter(pdu, len, iter);
+	}
+
+	return FALSE;
+}
+
+static unsigned int check_entries(const struct list_data *data,
+					const uint8_t *pdu, size_t len)
+{
+	struct att_iter iter;
+	const uint8_t *entry;
+	unsigned int count = 0;
+	uint16_t i;
+
+	g_assert(iter_init(data, pdu, len, &iter));
+
+	while (att_iter_next(&iter, &entry)) {
+		for (i = 0; i < data->expect_elen; i++)
+			g_assert_cmpuint(entry[i], ==, (count + i) & 0xff);
+
+		count++;
+	}
+
+	return count;
+}
+
+static void test_list(gconstpointer user_data)
+{
+	const struct list_data *data = user_data;
+	uint8_t pdu[ATT_MAX_MTU];
+	struct att_writer writer;
+	unsigned int count = 0;
+	uint8_t *entry;
+	uint16_t i;
+
+	memset(pdu, 0, sizeof(pdu));
+
+	if (!data->valid) {
+		g_assert(!writer_init(data, &writer, pdu));
+		return;
+	}
+
+	g_assert(writer_init(data, &writer, pdu));
+	g_assert_cmpuint(writer.elen, ==, data->expect_elen);
+
+	while ((entry = att_writer_next(&writer)) != NULL) {
+		for (i = 0; i < writer.elen; i++)
+			entry[i] = (count + i) & 0xff;
+
+		count++;
+	}
+
+	if (g_test_verbose())
+		g_print("MTU %u: %u entries of %u bytes in %zu bytes\n",
+				data->mtu, count, writer.elen, writer.offset);
+
+	/* The writer stops at the last entry that fits in the MTU */
+	g_assert_cmpuint(count, ==, data->entries);
+	g_assert_cmpuint(writer.offset, <=, data->mtu);
+	g_assert_cmpuint(writer.offset + writer.elen, >, data->mtu);
+	g_assert_cmpuint(pdu[0], ==, data->opcode);
+
+	g_assert_cmpuint(check_entries(data, pdu, writer.offset), ==, count);
+
+	/* A partial trailing entry is not handed out */
+	g_assert_cmpuint(check_entries(data, pdu, writer.offset - 1), ==,
+								count - 1);
+}
+
+static void test_list_perf(void)
+{
+	const struct list_data *data = &grp_mtu_517;
+	const int count = 1000000;
+	uint8_t pdu[ATT_MAX_MTU];
+	struct att_writer writer;
+	struct att_iter iter;
+	const uint8_t *rentry;
+	uint8_t *entry;
+	unsigned int entries = 0;
+	double elapsed;
+	int i;
+
+	if (!g_test_perf())
+		return;
+
+	g_test_timer_start();
+
+	for (i = 0; i < count; i++) {
+		writer_init(data, &writer, pdu);
+
+		while ((entry = att_writer_next(&writer)) != NULL) {
+			att_put_u16(i, entry);
+			att_put_u16(i + 1, &entry[2]);
+			memset(&entry[4], i & 0xff, writer.elen - 4);
+		}
+
+		dec_read_by_grp_resp_iter(pdu, writer.offset, &iter);
+
+		while (att_iter_next(&iter, &rentry))
+			entries += att_get_u16(rentry) == (i & 0xffff);
+	}
+
+	elapsed = g_test_timer_elapsed();
+
+	g_assert_cmpuint(entries, ==, count * data->entries);
+
+	g_test_minimized_result(elapsed, "Read By Group Type: %d responses "
+				"of %u entries in %.3f s (%.0f ns each)",
+				count, data->entries, elapsed,
+				elapsed * 1e9 / count);
+}
+
+int main(int argc, char *argv[])
+{
+	g_test_init(&argc, &argv, NULL);
+
+	g_test_add_data_func("/att/read_by_grp_resp/mtu_23", &grp_mtu_23,
+								test_list);
+	g_test_add_data_func("/att/read_by_grp_resp/mtu_517", &grp_mtu_517,
+								test_list);
+	g_test_add_data_func("/att/read_by_grp_resp/mtu_short",
+						&grp_mtu_short, test_list);
+	g_test_add_data_func("/att/read_by_grp_resp/elen_long",
+						&grp_elen_long, test_list);
+	g_test_add_data_func("/att/read_by_type_resp/mtu_23", &type_mtu_23,
+								test_list);
+	g_test_add_data_func("/att/read_by_type_resp/truncated_23",
+						&type_truncated_23, test_list);
+	g_test_add_data_func("/att/read_by_type_resp/truncated_517",
+						&type_truncated_517, test_list);
+	g_test_add_data_func("/att/find_info_resp/16bit_mtu_23",
+						&info_16_mtu_23, test_list);
+	g_test_add_data_func("/att/find_info_resp/128bit_mtu_23",
+						&info_128_mtu_23, test_list);
+	g_test_add_data_func("/att/find_info_resp/128bit_mtu_517",
+						&info_128_mtu_517, test_list);
+	g_test_add_data_func("/att/find_info_resp/bad_format",
+						&info_bad_format, test_list);
+	g_test_add_data_func("/att/find_by_type_resp/mtu_23",
+						&type_value_mtu_23, test_list);
+	g_test_add_data_func("/att/find_by_type_resp/mtu_517",
+						&type_value_mtu_517, test_list);
+
+	g_test_add_func("/att/perf/read_by_grp_resp", test_list_perf);
+
+	return g_test_run();
+}
@@ -0,0 +1,535 @@
+/*
+ *
+ *  BlueZ - Bluetooth protocol stack for Linux
+ *
+ *  Copyright (C) 2013  Intel Corporation. All rights reserved.
+ *
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <errno.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+#include <glib.h>
+
+#include "lib/bluetooth.h"
+#include "lib/sdp.h"
+#include "lib/sdp_lib.h"
+#include "lib/uuid.h"
+
+#include "btio/btio.h"
+#include "src/adapter.h"
+#include "src/device.h"
+#include "src/textfile.h"
+#include "attrib/att.h"
+#include "attrib/gattrib.h"
+#include "attrib/gatt.h"
+#include "attrib/att-database.h"
+#include "src/attrib-server.h"
+
+/*
+ * The attribute server runs against a fake adapter, device and GAttrib:
+ * requests are handed straight to the handler it registers and the last
+ * response it sends is kept for inspection.
+ */
+struct _GAttrib {
+	GIOChannel *io;
+	int ref_count;
+	GAttribNotifyFunc func;
+	gpointer user_data;
+	uint8_t buf[ATT_DEFAULT_LE_MTU];
+	uint8_t rsp[ATT_DEFAULT_LE_MTU];
+	uint16_t rsp_len;
+};
+
+struct btd_adapter {
+	bdaddr_t bdaddr;
+};
+
+struct btd_device {
+	bdaddr_t bdaddr;
+};
+
+static struct btd_adapter test_adapter = {
+	.bdaddr = { { 0x01, 0x00, 0x00, 0x00, 0x00, 0x00 } },
+};
+
+static struct btd_device test_device = {
+	.bdaddr = { { 0x02, 0x00, 0x00, 0x00, 0x00, 0x00 } },
+};
+
+static GSList *service_records = NULL;
+static uint32_t next_record_handle = 0x10000;
+
+uint16_t btd_adapter_get_index(struct btd_adapter *adapter)
+{
+	return 0;
+}
+
+struct btd_adapter *btd_adapter_ref(struct btd_adapter *adapter)
+{
+	return adapter;
+}
+
+void btd_adapter_unref(struct btd_adapter *adapter)
+{
+}
+
+const bdaddr_t *adapter_get_address(struct btd_adapter *adapter)
+{
+	return &adapter->bdaddr;
+}
+
+struct btd_device *adapter_find_device(struct btd_adapter *adapter,
+							const bdaddr_t *dst)
+{
+	if (bacmp(dst, &test_device.bdaddr))
+		return NULL;
+
+	return &test_device;
+}
+
+int adapter_service_add(struct btd_adapter *adapter, sdp_record_t *rec)
+{
+	rec->handle = next_record_handle++;
+	service_records = g_slist_append(service_records, rec);
+
+	return 0;
+}
+
+void adapter_service_remove(struct btd_adapter *adapter, uint32_t handle)
+{
+	GSList *l;
+
+	for (l = service_records; l; l = l->next) {
+		sdp_record_t *rec = l->data;
+
+		if (rec->handle != handle)
+			continue;
+
+		service_records = g_slist_remove(service_records, rec);
+		sdp_record_free(rec);
+		return;
+	}
+}
+
+struct btd_device *btd_device_ref(struct btd_device *device)
+{
+	return device;
+}
+
+void btd_device_unref(struct btd_device *device)
+{
+}
+
+gboolean device_is_bonded(struct btd_device *device)
+{
+	return TRUE;
+}
+
+char *btd_device_get_storage_path(struct btd_device *device,
+							const char *filename)
+{
+	return NULL;
+}
+
+int create_file(const char *filename, const mode_t mode)
+{
+	return -EIO;
+}
+
+GIOChannel *bt_io_listen(BtIOConnect connect, BtIOConfirm confirm,
+				gpointer user_data, GDestroyNotify destroy,
+				GError **err, BtIOOption opt1, ...)
+{
+	int sv[2];
+	GIOChannel *io;
+
+	if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, sv) < 0) {
+		g_set_error(err, bt_io_error_quark(), errno, "socketpair");
+		return NULL;
+	}
+
+	close(sv[1]);
+
+	io = g_io_channel_unix_new(sv[0]);
+	g_io_channel_set_close_on_unref(io, TRUE);
+
+	return io;
+}
+
+/* Every channel is an LE link from test_device to test_adapter */
+gboolean bt_io_get(GIOChannel *io, GError **err, BtIOOption opt1, ...)
+{
+	BtIOOption opt = opt1;
+	va_list args;
+
+	va_start(args, opt1);
+
+	while (opt != BT_IO_OPT_INVALID) {
+		switch (opt) {
+		case BT_IO_OPT_SOURCE_BDADDR:
+			bacpy(va_arg(args, bdaddr_t *), &test_adapter.bdaddr);
+			break;
+		case BT_IO_OPT_DEST_BDADDR:
+			bacpy(va_arg(args, bdaddr_t *), &test_device.bdaddr);
+			break;
+		case BT_IO_OPT_CID:
+			*(va_arg(args, uint16_t *)) = ATT_CID;
+			break;
+		case BT_IO_OPT_IMTU:
+			*(va_arg(args, uint16_t *)) = ATT_DEFAULT_LE_MTU;
+			break;
+		default:
+			g_assert_not_reached();
+		}
+
+		opt = va_arg(args, int);
+	}
+
+	va_end(args);
+
+	return TRUE;
+}
+
+GQuark bt_io_error_quark(void)
+{
+	return g_quark_from_static_string("bt-io-error-quark");
+}
+
+GAttrib *g_attrib_new(GIOChannel *io)
+{
+	GAttrib *attrib = g_new0(GAttrib, 1);
+
+	attrib->io = g_io_channel_ref(io);
+	attrib->ref_count = 1;
+
+	return attrib;
+}
+
+GAttrib *g_attrib_ref(GAttrib *attrib)
+{
+	attrib->ref_count++;
+
+	return attrib;
+}
+
+void g_attrib_unref(GAttrib *attrib)
+{
+	if (--attrib->ref_count > 0)
+		return;
+
+	g_io_channel_unref(attrib->io);
+	g_free(attrib);
+}
+
+GIOChannel *g_attrib_get_channel(GAttrib *attrib)
+{
+	return attrib->io;
+}
+
+guint g_attrib_send(GAttrib *attrib, guint id, const guint8 *pdu, guint16 len,
+				GAttribResultFunc func, gpointer user_data,
+				GDestroyNotify notify)
+{
+	g_assert(len <= sizeof(attrib->rsp));
+
+	memcpy(attrib->rsp, pdu, len);
+	attrib->rsp_len = len;
+
+	return 1;
+}
+
+guint g_attrib_register(GAttrib *attrib, guint8 opcode, guint16 handle,
+				GAttribNotifyFunc func, gpointer user_data,
+				GDestroyNotify notify)
+{
+	attrib->func = func;
+	attrib->user_data = user_data;
+
+	return 1;
+}
+
+gboolean g_attrib_unregister(GAttrib *attrib, guint id)
+{
+	attrib->func = NULL;
+
+	return TRUE;
+}
+
+gboolean g_attrib_is_encrypted(GAttrib *attrib)
+{
+	return FALSE;
+}
+
+uint8_t *g_attrib_get_buffer(GAttrib *attrib, size_t *len)
+{
+	*len = sizeof(attrib->buf);
+
+	return attrib->buf;
+}
+
+gboolean g_attrib_set_mtu(GAttrib *attrib, int mtu)
+{
+	return TRUE;
+}
+
+static void request(GAttrib *attrib, const uint8_t *pdu, uint16_t len)
+{
+	attrib->rsp_len = 0;
+	attrib->func(pdu, len, attrib->user_data);
+	g_assert(attrib->rsp_len > 0);
+}
+
+/*
+ * Add services made of a primary service declaration and three
+ * characteristics, each with a declaration, a value and a CCC descriptor.
+ */
+#define SERVICE_START		0x0100
+#define SERVICE_ATTRIBUTES	10
+
+static void add_services(int count)
+{
+	uint16_t handle = SERVICE_START;
+	uint8_t value[5];
+	bt_uuid_t uuid;
+	int i, c;
+
+	memset(value, 0, sizeof(value));
+
+	for (i = 0; i < count; i++) {
+		bt_uuid16_create(&uuid, GATT_PRIM_SVC_UUID);
+		att_put_u16(0x1800 + i, value);
+		g_assert(attrib_db_add(&test_adapter, handle++, &uuid,
+					ATT_NONE, ATT_NOT_PERMITTED,
+					value, 2) != NULL);
+
+		for (c = 0; c < 3; c++) {
+			bt_uuid16_create(&uuid, GATT_CHARAC_UUID);
+			value[0] = ATT_CHAR_PROPER_READ;
+			att_put_u16(handle + 1, &value[1]);
+			att_put_u16(0x2a00 + c, &value[3]);
+			g_assert(attrib_db_add(&test_adapter, handle++, &uuid,
+						ATT_NONE, ATT_NOT_PERMITTED,
+						value, 5) != NULL);
+
+			bt_uuid16_create(&uuid, 0x2a00 + c);
+			g_assert(attrib_db_add(&test_adapter, handle++, &uuid,
+						ATT_NONE, ATT_NOT_PERMITTED,
+						value, 4) != NULL);
+
+			bt_uuid16_create(&uuid, GATT_CLIENT_CHARAC_CFG_UUID);
+			g_assert(attrib_db_add(&test_adapter, handle++, &uuid,
+						ATT_NONE, ATT_NONE,
+						value, 2) != NULL);
+		}
+	}
+}
+
+struct discovery {
+	int requests;
+	int services;
+	int attributes;
+};
+
+/* Primary service discovery followed by Find Information over everything */
+static void discover(GAttrib *attrib, struct discovery *d)
+{
+	bt_uuid_t prim_uuid;
+	uint8_t pdu[ATT_DEFAULT_LE_MTU];
+	const uint8_t *rsp = attrib->rsp;
+	uint16_t start, last, len;
+	int count;
+
+	memset(d, 0, sizeof(*d));
+
+	bt_uuid16_create(&prim_uuid, GATT_PRIM_SVC_UUID);
+
+	for (start = 0x0001;; start = last + 1) {
+		len = enc_read_by_grp_req(start, 0xffff, &prim_uuid, pdu,
+								sizeof(pdu));
+		request(attrib, pdu, len);
+		d->requests++;
+
+		if (rsp[0] != ATT_OP_READ_BY_GROUP_RESP)
+			break;
+
+		count = (attrib->rsp_len - 2) / rsp[1];
+		d->services += count;
+
+		/* End group handle of the last entry */
+		last = att_get_u16(&rsp[2 + (count - 1) * rsp[1] + 2]);
+		if (last == 0xffff)
+			break;
+	}
+
+	g_assert_cmpuint(rsp[0], ==, ATT_OP_ERROR);
+
+	for (start = 0x0001;; start = last + 1) {
+		int entry;
+
+		len = enc_find_info_req(start, 0xffff, pdu, sizeof(pdu));
+		request(attrib, pdu, len);
+		d->requests++;
+
+		if (rsp[0] != ATT_OP_FIND_INFO_RESP)
+			break;
+
+		entry = rsp[1] == ATT_FIND_INFO_RESP_FMT_16BIT ? 4 : 18;
+		count = (attrib->rsp_len - 2) / entry;
+		d->attributes += count;
+
+		last = att_get_u16(&rsp[2 + (count - 1) * entry]);
+		if (last == 0xffff)
+			break;
+	}
+
+	g_assert_cmpuint(rsp[0], ==, ATT_OP_ERROR);
+}
+
+/* GAP and GATT services registered by the server itself */
+#define CORE_SERVICES		2
+#define CORE_ATTRIBUTES		6
+
+static GAttrib *attach(guint *id)
+{
+	GAttrib *attrib;
+	GIOChannel *io;
+	int sv[2];
+
+	g_assert(socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0,
+								sv) == 0);
+	close(sv[1]);
+
+	io = g_io_channel_unix_new(sv[0]);
+	g_io_channel_set_close_on_unref(io, TRUE);
+
+	attrib = g_attrib_new(io);
+	g_io_channel_unref(io);
+
+	*id = attrib_channel_attach(attrib);
+	g_assert(*id != 0);
+	g_assert(attrib->func != NULL);
+
+	return attrib;
+}
+
+static void detach(GAttrib *attrib, guint id)
+{
+	g_assert(attrib_channel_detach(attrib, id));
+	g_attrib_unref(attrib);
+}
+
+static void test_discover(void)
+{
+	struct discovery d;
+	GAttrib *attrib;
+	guint id;
+
+	g_assert(btd_adapter_gatt_server_start(&test_adapter) == 0);
+	add_services(10);
+
+	attrib = attach(&id);
+
+	discover(attrib, &d);
+	g_assert_cmpint(d.services, ==, CORE_SERVICES + 10);
+	g_assert_cmpint(d.attributes, ==,
+				CORE_ATTRIBUTES + 10 * SERVICE_ATTRIBUTES);
+
+	/* Answers from the response cache must match */
+	discover(attrib, &d);
+	g_assert_cmpint(d.services, ==, CORE_SERVICES + 10);
+	g_assert_cmpint(d.attributes, ==,
+				CORE_ATTRIBUTES + 10 * SERVICE_ATTRIBUTES);
+
+	detach(attrib, id);
+	btd_adapter_gatt_server_stop(&test_adapter);
+
+	g_assert(service_records == NULL);
+}
+
+static void test_discover_perf(void)
+{
+	const int services = 100, count = 1000;
+	struct discovery d;
+	GAttrib *attrib;
+	uint8_t value[2];
+	double elapsed;
+	guint id;
+	int i;
+
+	if (!g_test_perf())
+		return;
+
+	g_assert(btd_adapter_gatt_server_start(&test_adapter) == 0);
+	add_services(services);
+
+	attrib = attach(&id);
+
+	g_test_timer_start();
+
+	/* Changing a service declaration drops all cached responses */
+	for (i = 0; i < count; i++) {
+		att_put_u16(0x1800, value);
+		g_assert(attrib_db_update(&test_adapter, SERVICE_START, NULL,
+						value, 2, NULL) == 0);
+
+		discover(attrib, &d);
+	}
+
+	elapsed = g_test_timer_elapsed();
+
+	g_assert_cmpint(d.services, ==, CORE_SERVICES + services);
+	g_assert_cmpint(d.attributes, ==,
+				CORE_ATTRIBUTES + services * SERVICE_ATTRIBUTES);
+
+	g_test_minimized_result(elapsed, "Discovery of %d attributes: "
+				"%d requests, %.1f us per discovery",
+				d.attributes, d.requests,
+				elapsed * 1000000 / count);
+
+	g_test_timer_start();
+
+	for (i = 0; i < count; i++)
+		discover(attrib, &d);
+
+	elapsed = g_test_timer_elapsed();
+
+	g_test_minimized_result(elapsed, "Repeated discovery of %d "
+				"attributes: %.1f us per discovery",
+				d.attributes, elapsed * 1000000 / count);
+
+	detach(attrib, id);
+	btd_adapter_gatt_server_stop(&test_adapter);
+}
+
+int main(int argc, char *argv[])
+{
+	g_test_init(&argc, &argv, NULL);
+
+	g_test_add_func("/attrib-server/discover", test_discover);
+	g_test_add_func("/attrib-server/perf/discover", test_discover_perf);
+
+	return g_test_run();
+}
@@ -25,6 +25,9 @@
 #include <config.h>
 #endif
 
+#include <stdio.h>
+#include <string.h>
+
 #include <glib.h>
 #include <gdbus.h>
 
@@ -959,6 +962,478 @@ static void client_force_disconnect(void)
 	destroy_context(context);
 }
 
+static dbus_uint32_t counter_value;
+static int counter_changes;
+static gint64 counter_changed_time;
+static unsigned int counter_emitted, counter_suppressed;
+
+static gboolean get_counter(const GDBusPropertyTable *property,
+					DBusMessageIter *iter, void *data)
+{
+	dbus_message_iter_append_basic(iter, DBUS_TYPE_UINT32, &counter_value);
+
+	return TRUE;
+}
+
+static gboolean emit_counter_burst(void *user_data)
+{
+	struct context *context = user_data;
+	int i;
+
+	for (i = 0; i < 10; i++) {
+		counter_value++;
+		g_dbus_emit_property_changed(context->dbus_conn, SERVICE_PATH,
+						SERVICE_NAME, "Counter");
+	}
+
+	return FALSE;
+}
+
+static void proxy_counter(GDBusProxy *proxy, void *user_data)
+{
+	struct context *context = user_data;
+
+	if (g_test_verbose())
+		g_print("proxy %s found\n",
+					g_dbus_proxy_get_interface(proxy));
+
+	g_dbus_get_property_stats(&counter_emitted, &counter_suppressed);
+
+	g_idle_add(emit_counter_burst, context);
+}
+
+static void property_counter_changed(GDBusProxy *proxy, const char *name,
+					DBusMessageIter *iter, void *user_data)
+{
+	struct context *context = user_data;
+	unsigned int emitted, suppressed;
+	dbus_uint32_t value;
+	gint64 now = g_get_monotonic_time();
+
+	if (g_test_verbose())
+		g_print("property %s changed\n", name);
+
+	g_assert(g_strcmp0(name, "Counter") == 0);
+	g_assert(dbus_message_iter_get_arg_type(iter) == DBUS_TYPE_UINT32);
+
+	/* Each burst is coalesced into a signal with the latest value */
+	dbus_message_iter_get_basic(iter, &value);
+	g_assert_cmpuint(value, ==, counter_value);
+
+	if (++counter_changes == 1) {
+		counter_changed_time = now;
+		emit_counter_burst(context);
+		return;
+	}
+
+	/* The second burst is held back for the minimum interval */
+	g_assert_cmpint(now - counter_changed_time, >=, 150000);
+
+	g_dbus_get_property_stats(&emitted, &suppressed);
+	g_assert_cmpuint(emitted - counter_emitted, ==, 2);
+	g_assert_cmpuint(suppressed - counter_suppressed, ==, 18);
+
+	g_dbus_client_unref(context->dbus_client);
+}
+
+static void client_property_interval(void)
+{
+	struct context *context = create_context();
+	static const GDBusPropertyTable counter_properties[] = {
+		{ "Counter", "u", get_counter },
+		{ },
+	};
+
+	if (context == NULL)
+		return;
+
+	g_dbus_set_property_interval(SERVICE_NAME, "Counter", 200);
+
+	g_dbus_register_interface(context->dbus_conn,
+				SERVICE_PATH, SERVICE_NAME,
+				methods, signals, counter_properties,
+				context, NULL);
+
+	context->dbus_client = g_dbus_client_new(context->dbus_conn,
+						SERVICE_NAME, SERVICE_PATH);
+
+	g_dbus_client_set_disconnect_watch(context->dbus_client,
+						disconnect_handler, context);
+	g_dbus_client_set_proxy_handlers(context->dbus_client,
+						proxy_counter, NULL,
+						property_counter_changed,
+						context);
+
+	g_main_loop_run(context->main_loop);
+
+	g_dbus_unregister_interface(context->dbus_conn,
+					SERVICE_PATH, SERVICE_NAME);
+
+	destroy_context(context);
+}
+
+struct managed_object {
+	dbus_uint32_t index;
+	dbus_uint32_t value;
+};
+
+struct managed_objects {
+	struct context *context;
+	struct managed_object *objects;
+	unsigned int count;
+	int calls;
+	gint64 start;
+};
+
+static gboolean get_object_index(const GDBusPropertyTable *property,
+					DBusMessageIter *iter, void *data)
+{
+	struct managed_object *object = data;
+
+	dbus_message_iter_append_basic(iter, DBUS_TYPE_UINT32, &object->index);
+
+	return TRUE;
+}
+
+static gboolean get_object_value(const GDBusPropertyTable *property,
+					DBusMessageIter *iter, void *data)
+{
+	struct managed_object *object = data;
+
+	dbus_message_iter_append_basic(iter, DBUS_TYPE_UINT32, &object->value);
+
+	return TRUE;
+}
+
+static gboolean get_object_name(const GDBusPropertyTable *property,
+					DBusMessageIter *iter, void *data)
+{
+	const char *name = "Synthetic object";
+
+	dbus_message_iter_append_basic(iter, DBUS_TYPE_STRING, &name);
+
+	return TRUE;
+}
+
+static const GDBusPropertyTable object_properties[] = {
+	{ "Index", "u", get_object_index },
+	{ "Value", "u", get_object_value },
+	{ "Name", "s", get_object_name },
+	{ },
+};
+
+static void object_path(char *path, size_t len, dbus_uint32_t idx)
+{
+	snprintf(path, len, "%s/obj%u", SERVICE_PATH, idx);
+}
+
+static void check_object_properties(struct managed_objects *data,
+						DBusMessageIter *props)
+{
+	DBusMessageIter entry, value;
+	dbus_uint32_t idx = G_MAXUINT32, val = 0;
+	const char *name;
+
+	while (dbus_message_iter_get_arg_type(props) == DBUS_TYPE_DICT_ENTRY) {
+		dbus_message_iter_recurse(props, &entry);
+		dbus_message_iter_get_basic(&entry, &name);
+		dbus_message_iter_next(&entry);
+		dbus_message_iter_recurse(&entry, &value);
+
+		if (g_strcmp0(name, "Index") == 0)
+			dbus_message_iter_get_basic(&value, &idx);
+		else if (g_strcmp0(name, "Value") == 0)
+			dbus_message_iter_get_basic(&value, &val);
+
+		dbus_message_iter_next(props);
+	}
+
+	g_assert_cmpuint(idx, <, data->count);
+	g_assert_cmpuint(val, ==, data->objects[idx].value);
+}
+
+static unsigned int check_managed_objects(struct managed_objects *data,
+							DBusMessage *reply)
+{
+	DBusMessageIter iter, array, object, ifaces, iface, props;
+	unsigned int count = 0;
+	const char *name;
+
+	g_assert(dbus_message_get_type(reply) ==
+					DBUS_MESSAGE_TYPE_METHOD_RETURN);
+	g_assert(dbus_message_iter_init(reply, &iter));
+	g_assert(dbus_message_iter_get_arg_type(&iter) == DBUS_TYPE_ARRAY);
+
+	dbus_message_iter_recurse(&iter, &array);
+
+	while (dbus_message_iter_get_arg_type(&array) ==
+						DBUS_TYPE_DICT_ENTRY) {
+		dbus_message_iter_recurse(&array, &object);
+		dbus_message_iter_next(&object);
+		dbus_message_iter_recurse(&object, &ifaces);
+
+		while (dbus_message_iter_get_arg_type(&ifaces) ==
+						DBUS_TYPE_DICT_ENTRY) {
+			dbus_message_iter_recurse(&ifaces, &iface);
+			dbus_message_iter_get_basic(&iface, &name);
+			dbus_message_iter_next(&iface);
+
+			if (g_strcmp0(name, SERVICE_NAME) == 0) {
+				dbus_message_iter_recurse(&iface, &props);
+				check_object_properties(data, &props);
+				count++;
+			}
+
+			dbus_message_iter_next(&ifaces);
+		}
+
+		dbus_message_iter_next(&array);
+	}
+
+	return count;
+}
+
+static void get_managed_objects_reply(DBusPendingCall *call, void *user_data);
+
+static gboolean get_managed_objects(gpointer user_data)
+{
+	struct managed_objects *data = user_data;
+	DBusMessage *msg;
+	DBusPendingCall *call;
+
+	msg = dbus_message_new_method_call(SERVICE_NAME, "/",
+					"org.freedesktop.DBus.ObjectManager",
+					"GetManagedObjects");
+	g_assert(msg != NULL);
+
+	data->start = g_get_monotonic_time();
+
+	g_assert(g_dbus_send_message_with_reply(data->context->dbus_conn, msg,
+								&call, -1));
+	dbus_pending_call_set_notify(call, get_managed_objects_reply, data,
+									NULL);
+	dbus_pending_call_unref(call);
+	dbus_message_unref(msg);
+
+	return FALSE;
+}
+
+static void get_managed_objects_reply(DBusPendingCall *call, void *user_data)
+{
+	static const char *names[] = { "uncached", "cached", "incremental" };
+	struct managed_objects *data = user_data;
+	DBusMessage *reply = dbus_pending_call_steal_reply(call);
+	double elapsed = (g_get_monotonic_time() - data->start) / 1000000.0;
+	struct managed_object *object;
+	char path[64];
+
+	g_assert_cmpuint(check_managed_objects(data, reply), ==, data->count);
+	dbus_message_unref(reply);
+
+	if (g_test_perf())
+		g_test_minimized_result(elapsed, "GetManagedObjects (%s): "
+					"%u objects in %.3f s",
+					names[data->calls], data->count,
+					elapsed);
+
+	switch (++data->calls) {
+	case 1:
+		/* Nothing changed, the previous reply is reused */
+		get_managed_objects(data);
+		break;
+	case 2:
+		/* Only the changed interface goes through its getters */
+		object = &data->objects[data->count / 2];
+		object->value++;
+		object_path(path, sizeof(path), object->index);
+		g_dbus_emit_property_changed(data->context->dbus_conn, path,
+						SERVICE_NAME, "Value");
+		get_managed_objects(data);
+		break;
+	default:
+		g_main_loop_quit(data->context->main_loop);
+		break;
+	}
+}
+
+static void client_get_managed_objects(void)
+{
+	struct context *context = create_context();
+	struct managed_objects data;
+	char path[64];
+	unsigned int i;
+
+	if (context == NULL)
+		return;
+
+	memset(&data, 0, sizeof(data));
+	data.context = context;
+	data.count = g_test_perf() ? 5000 : 100;
+	data.objects = g_new0(struct managed_object, data.count);
+
+	for (i = 0; i < data.count; i++) {
+		data.objects[i].index = i;
+		data.objects[i].value = i * 2;
+
+		object_path(path, sizeof(path), i);
+		g_dbus_register_interface(context->dbus_conn, path,
+					SERVICE_NAME, methods, signals,
+					object_properties, &data.objects[i],
+					NULL);
+	}
+
+	/* Queued after the idle that publishes the new interfaces */
+	g_idle_add(get_managed_objects, &data);
+
+	g_main_loop_run(context->main_loop);
+
+	for (i = 0; i < data.count; i++) {
+		object_path(path, sizeof(path), i);
+		g_dbus_unregister_interface(context->dbus_conn, path,
+							SERVICE_NAME);
+	}
+
+	g_free(data.objects);
+
+	destroy_context(context);
+}
+
+struct property_rate {
+	struct context *context;
+	unsigned int count;
+	unsigned int calls;
+	gint64 start;
+};
+
+static gboolean get_rate_value(const GDBusPropertyTable *property,
+					DBusMessageIter *iter, void *data)
+{
+	dbus_uint32_t value = 0x1234;
+
+	dbus_message_iter_append_basic(iter, DBUS_TYPE_UINT32, &value);
+
+	return TRUE;
+}
+
+static const GDBusPropertyTable rate_properties[] = {
+	{ "Address", "u", get_rate_value },
+	{ "Name", "u", get_rate_value },
+	{ "Alias", "u", get_rate_value },
+	{ "Class", "u", get_rate_value },
+	{ "Appearance", "u", get_rate_value },
+	{ "Icon", "u", get_rate_value },
+	{ "Paired", "u", get_rate_value },
+	{ "Trusted", "u", get_rate_value },
+	{ "Blocked", "u", get_rate_value },
+	{ "LegacyPairing", "u", get_rate_value },
+	{ "Connected", "u", get_rate_value },
+	{ "UUIDs", "u", get_rate_value },
+	{ "Modalias", "u", get_rate_value },
+	{ "Adapter", "u", get_rate_value },
+	{ "TxPower", "u", get_rate_value },
+	{ "RSSI", "u", get_rate_value },
+	{ },
+};
+
+static const char *rate_interfaces[] = {
+	SERVICE_NAME ".Extra1",
+	SERVICE_NAME ".Extra2",
+	SERVICE_NAME ".Extra3",
+	SERVICE_NAME,
+	NULL
+};
+
+static void get_property_rate_reply(DBusPendingCall *call, void *user_data);
+
+static gboolean get_property_rate(gpointer user_data)
+{
+	struct property_rate *data = user_data;
+	const char *interface = SERVICE_NAME, *name = "RSSI";
+	DBusMessage *msg;
+	DBusPendingCall *call;
+
+	msg = dbus_message_new_method_call(SERVICE_NAME, SERVICE_PATH,
+					DBUS_INTERFACE_PROPERTIES, "Get");
+	g_assert(msg != NULL);
+
+	dbus_message_append_args(msg, DBUS_TYPE_STRING, &interface,
+					DBUS_TYPE_STRING, &name,
+					DBUS_TYPE_INVALID);
+
+	g_assert(g_dbus_send_message_with_reply(data->context->dbus_conn, msg,
+								&call, -1));
+	dbus_pending_call_set_notify(call, get_property_rate_reply, data,
+									NULL);
+	dbus_pending_call_unref(call);
+	dbus_message_unref(msg);
+
+	return FALSE;
+}
+
+static void get_property_rate_reply(DBusPendingCall *call, void *user_data)
+{
+	struct property_rate *data = user_data;
+	DBusMessage *reply = dbus_pending_call_steal_reply(call);
+	DBusMessageIter iter, value;
+	dbus_uint32_t val;
+	double elapsed;
+
+	g_assert(dbus_message_get_type(reply) ==
+					DBUS_MESSAGE_TYPE_METHOD_RETURN);
+	g_assert(dbus_message_iter_init(reply, &iter));
+	g_assert(dbus_message_iter_get_arg_type(&iter) == DBUS_TYPE_VARIANT);
+
+	dbus_message_iter_recurse(&iter, &value);
+	dbus_message_iter_get_basic(&value, &val);
+	g_assert_cmpuint(val, ==, 0x1234);
+
+	dbus_message_unref(reply);
+
+	if (++data->calls < data->count) {
+		get_property_rate(data);
+		return;
+	}
+
+	elapsed = (g_get_monotonic_time() - data->start) / 1000000.0;
+
+	if (g_test_perf())
+		g_test_minimized_result(elapsed, "Properties.Get: %u calls in "
+					"%.3f s, %.1f us per call", data->count,
+					elapsed, elapsed * 1000000 / data->count);
+
+	g_main_loop_quit(data->context->main_loop);
+}
+
+static void client_get_property_rate(void)
+{
+	struct context *context = create_context();
+	struct property_rate data;
+	int i;
+
+	if (context == NULL)
+		return;
+
+	memset(&data, 0, sizeof(data));
+	data.context = context;
+	data.count = g_test_perf() ? 20000 : 100;
+
+	for (i = 0; rate_interfaces[i]; i++)
+		g_dbus_register_interface(context->dbus_conn, SERVICE_PATH,
+					rate_interfaces[i], methods, signals,
+					rate_properties, NULL, NULL);
+
+	data.start = g_get_monotonic_time();
+	g_idle_add(get_property_rate, &data);
+
+	g_main_loop_run(context->main_loop);
+
+	for (i = 0; rate_interfaces[i]; i++)
+		g_dbus_unregister_interface(context->dbus_conn, SERVICE_PATH,
+							rate_interfaces[i]);
+
+	destroy_context(context);
+}
+
 int main(int argc, char *argv[])
 {
 	g_test_init(&argc, &argv, NULL);
@@ -996,5 +1471,14 @@ int main(int argc, char *argv[])
 	g_test_add_func("/gdbus/client_force_disconnect",
 						client_force_disconnect);
 
+	g_test_add_func("/gdbus/client_property_interval",
+						client_property_interval);
+
+	g_test_add_func("/gdbus/client_get_managed_objects",
+						client_get_managed_objects);
+
+	g_test_add_func("/gdbus/client_get_property_rate",
+						client_get_property_rate);
+
 	return g_test_run();
 }
@@ -28,6 +28,7 @@
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <sys/stat.h>
+#include <sys/wait.h>
 #include <errno.h>
 #include <unistd.h>
 #include <string.h>
@@ -2187,6 +2188,268 @@ static void test_conn_put_req_seq_srm(void)
 	g_assert_no_error(d.err);
 }
 
+#define PERF_MTU	65535
+#define PERF_SIZE	(256 * 1024 * 1024)
+#define PERF_SLOW_SIZE	(16 * 1024 * 1024)
+#define PERF_SLOW_DELAY	4000
+
+struct perf_data {
+	GMainLoop *mainloop;
+	GError *err;
+	gsize size;
+	gsize sent;
+	gsize received;
+	guint packets;
+	guint complete;
+	guint endpoints;
+	gulong source_delay;
+	gulong link_delay;
+};
+
+static guint8 perf_buf[PERF_MTU];
+
+static GObex *create_perf_endpoint(int fd)
+{
+	GIOChannel *io;
+	GObex *obex;
+
+	io = g_io_channel_unix_new(fd);
+	g_assert(io != NULL);
+
+	g_io_channel_set_close_on_unref(io, TRUE);
+
+	obex = g_obex_new(io, G_OBEX_TRANSPORT_PACKET, PERF_MTU, PERF_MTU);
+	g_assert(obex != NULL);
+
+	g_io_channel_unref(io);
+
+	return obex;
+}
+
+static void perf_complete(GObex *obex, GError *err, gpointer user_data)
+{
+	struct perf_data *d = user_data;
+
+	if (err != NULL && d->err == NULL)
+		d->err = g_error_copy(err);
+
+	if (++d->complete == d->endpoints || err != NULL)
+		g_main_loop_quit(d->mainloop);
+}
+
+static gssize provide_perf(void *buf, gsize len, gpointer user_data)
+{
+	struct perf_data *d = user_data;
+
+	len = MIN(len, d->size - d->sent);
+	if (len == 0)
+		return 0;
+
+	/* Blocking source read, as filesystem_read does from the main loop */
+	if (d->source_delay > 0)
+		g_usleep(d->source_delay);
+
+	memcpy(buf, perf_buf, len);
+	d->sent += len;
+	d->packets++;
+
+	return len;
+}
+
+static gboolean rcv_perf(const void *buf, gsize len, gpointer user_data)
+{
+	struct perf_data *d = user_data;
+
+	/* Air time of the packet, the sender keeps queueing meanwhile */
+	if (d->link_delay > 0)
+		g_usleep(d->link_delay);
+
+	d->received += len;
+
+	return TRUE;
+}
+
+static void handle_conn_perf(GObex *obex, GObexPacket *req,
+							gpointer user_data)
+{
+	struct perf_data *d = user_data;
+
+	g_obex_send_rsp(obex, G_OBEX_RSP_SUCCESS, &d->err,
+							G_OBEX_HDR_INVALID);
+}
+
+static void handle_put_perf(GObex *obex, GObexPacket *req,
+							gpointer user_data)
+{
+	struct perf_data *d = user_data;
+
+	g_obex_put_rsp(obex, req, rcv_perf, perf_complete, d, &d->err,
+							G_OBEX_HDR_INVALID);
+}
+
+static void conn_complete_perf(GObex *obex, GError *err, GObexPacket *rsp,
+							gpointer user_data)
+{
+	struct perf_data *d = user_data;
+
+	if (err != NULL) {
+		d->err = g_error_copy(err);
+		g_main_loop_quit(d->mainloop);
+		return;
+	}
+
+	g_test_timer_start();
+
+	g_obex_put_req(obex, provide_perf, perf_complete, d, &d->err,
+					G_OBEX_HDR_NAME, "perf.bin",
+					G_OBEX_HDR_INVALID);
+}
+
+static void perf_disconnected(GObex *obex, GError *err, gpointer user_data)
+{
+	struct perf_data *d = user_data;
+
+	g_main_loop_quit(d->mainloop);
+}
+
+static void run_perf_server(struct perf_data *d, int fd)
+{
+	GObex *server;
+
+	server = create_perf_endpoint(fd);
+
+	/*
+	 * Completion fires before the final response is written, so keep
+	 * serving until the client hangs up.
+	 */
+	g_obex_set_disconnect_function(server, perf_disconnected, d);
+	d->endpoints = 0;
+
+	g_obex_add_request_function(server, G_OBEX_OP_CONNECT,
+						handle_conn_perf, d);
+	g_obex_add_request_function(server, G_OBEX_OP_PUT,
+						handle_put_perf, d);
+
+	d->mainloop = g_main_loop_new(NULL, FALSE);
+
+	g_main_loop_run(d->mainloop);
+
+	g_main_loop_unref(d->mainloop);
+	g_obex_unref(server);
+
+	_exit(d->err == NULL && d->received == d->size ? 0 : 1);
+}
+
+/*
+ * Sends d->size bytes with PUT and returns the elapsed time. With a link
+ * delay the receiver runs in a child process, so that its air time
+ * overlaps the sender's source reads the way a real radio does.
+ */
+static double perf_put(struct perf_data *d)
+{
+	GObex *client, *server = NULL;
+	double elapsed;
+	pid_t pid = 0;
+	int sv[2], status;
+
+	if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_NONBLOCK, 0, sv) < 0)
+		g_error("socketpair: %s", strerror(errno));
+
+	if (d->link_delay > 0) {
+		pid = fork();
+		g_assert(pid >= 0);
+
+		if (pid == 0) {
+			close(sv[0]);
+			run_perf_server(d, sv[1]);
+		}
+
+		close(sv[1]);
+		d->endpoints = 1;
+	} else {
+		server = create_perf_endpoint(sv[1]);
+
+		g_obex_add_request_function(server, G_OBEX_OP_CONNECT,
+							handle_conn_perf, d);
+		g_obex_add_request_function(server, G_OBEX_OP_PUT,
+							handle_put_perf, d);
+		d->endpoints = 2;
+	}
+
+	client = create_perf_endpoint(sv[0]);
+
+	d->mainloop = g_main_loop_new(NULL, FALSE);
+
+	g_obex_connect(client, conn_complete_perf, d, &d->err,
+							G_OBEX_HDR_INVALID);
+	g_assert_no_error(d->err);
+
+	g_main_loop_run(d->mainloop);
+
+	elapsed = g_test_timer_elapsed();
+
+	g_assert_no_error(d->err);
+	g_assert_cmpuint(d->sent, ==, d->size);
+
+	g_main_loop_unref(d->mainloop);
+	g_obex_unref(client);
+
+	if (pid > 0) {
+		g_assert(waitpid(pid, &status, 0) == pid);
+		g_assert(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+	} else {
+		g_assert_cmpuint(d->received, ==, d->size);
+		g_obex_unref(server);
+	}
+
+	return elapsed;
+}
+
+static void test_perf_put(void)
+{
+	struct perf_data d = { .size = PERF_SIZE };
+	double elapsed;
+
+	if (!g_test_perf())
+		return;
+
+	elapsed = perf_put(&d);
+
+	g_test_maximized_result(PERF_SIZE / elapsed / (1024 * 1024),
+				"PUT: %d MiB over SRM in %.3f s (%.1f MiB/s)",
+				PERF_SIZE / (1024 * 1024), elapsed,
+				PERF_SIZE / elapsed / (1024 * 1024));
+}
+
+static void test_perf_put_slow(void)
+{
+	struct perf_data d = { .size = PERF_SLOW_SIZE };
+	double source, link, both;
+
+	if (!g_test_perf())
+		return;
+
+	d.source_delay = PERF_SLOW_DELAY;
+	source = perf_put(&d);
+
+	memset(&d, 0, sizeof(d));
+	d.size = PERF_SLOW_SIZE;
+	d.link_delay = PERF_SLOW_DELAY;
+	link = perf_put(&d);
+
+	memset(&d, 0, sizeof(d));
+	d.size = PERF_SLOW_SIZE;
+	d.source_delay = PERF_SLOW_DELAY;
+	d.link_delay = PERF_SLOW_DELAY;
+	both = perf_put(&d);
+
+	g_test_minimized_result(both, "PUT: %u packets, %d us source and "
+				"%d us link per packet: source %.3f s, "
+				"link %.3f s, both %.3f s",
+				d.packets, PERF_SLOW_DELAY, PERF_SLOW_DELAY,
+				source, link, both);
+}
+
 int main(int argc, char *argv[])
 {
 	g_test_init(&argc, &argv, NULL);
@@ -2256,5 +2519,8 @@ int main(int argc, char *argv[])
 	g_test_add_func("/gobex/test_conn_put_req_seq_srm",
 						test_conn_put_req_seq_srm);
 
+	g_test_add_func("/gobex/perf/put", test_perf_put);
+	g_test_add_func("/gobex/perf/put_slow", test_perf_put_slow);
+
 	return g_test_run();
 }
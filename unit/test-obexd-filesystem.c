@@ -0,0 +1,436 @@
+/*
+ *
+ *  BlueZ - Bluetooth protocol stack for Linux
+ *
+ *  Copyright (C) 2013  Intel Corporation. All rights reserved.
+ *
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include <glib.h>
+
+#include "obexd.h"
+#include "plugin.h"
+#include "log.h"
+#include "mimetype.h"
+
+#define SMALL_SIZE (64 * 1024)
+#define LARGE_SIZE (5 * 1024 * 1024 + 123)
+
+/* The filesystem plugin runs against a stubbed obexd core */
+extern struct obex_plugin_desc __obex_builtin_filesystem;
+
+static struct obex_mime_type_driver *file_driver;
+static char *tmpdir;
+
+struct copy_result {
+	gboolean done;
+	int err;
+};
+
+void error(const char *format, ...)
+{
+	va_list ap;
+
+	if (!g_test_verbose())
+		return;
+
+	va_start(ap, format);
+	vprintf(format, ap);
+	putchar('\n');
+	va_end(ap);
+}
+
+void obex_debug(const char *format, ...)
+{
+}
+
+int obex_mime_type_driver_register(struct obex_mime_type_driver *driver)
+{
+	if (driver->target == NULL && driver->mimetype == NULL)
+		file_driver = driver;
+
+	return 0;
+}
+
+void obex_mime_type_driver_unregister(struct obex_mime_type_driver *driver)
+{
+	if (driver == file_driver)
+		file_driver = NULL;
+}
+
+void obex_object_set_io_flags(void *object, int flags, int err)
+{
+}
+
+const char *obex_option_root_folder(void)
+{
+	return "/";
+}
+
+gboolean obex_option_symlinks(void)
+{
+	return TRUE;
+}
+
+static char *test_path(const char *dir, const char *name)
+{
+	return g_build_filename(dir ? dir : tmpdir, name, NULL);
+}
+
+static void create_file(const char *path, size_t size)
+{
+	uint8_t buf[4096];
+	size_t offset, len, i;
+	int fd;
+
+	fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	g_assert(fd >= 0);
+
+	for (offset = 0; offset < size; offset += len) {
+		len = MIN(sizeof(buf), size - offset);
+
+		for (i = 0; i < len; i++)
+			buf[i] = (offset + i) % 251;
+
+		g_assert(write(fd, buf, len) == (ssize_t) len);
+	}
+
+	close(fd);
+}
+
+static void check_file(const char *path, size_t size)
+{
+	uint8_t buf[4096];
+	size_t offset = 0, i;
+	ssize_t len;
+	int fd;
+
+	fd = open(path, O_RDONLY);
+	g_assert(fd >= 0);
+
+	while ((len = read(fd, buf, sizeof(buf))) > 0) {
+		for (i = 0; i < (size_t) len; i++)
+			g_assert_cmpuint(buf[i], ==, (offset + i) % 251);
+
+		offset += len;
+	}
+
+	close(fd);
+
+	g_assert_cmpuint(offset, ==, size);
+}
+
+static off_t file_size(const char *path)
+{
+	struct stat st;
+
+	if (stat(path, &st) < 0)
+		return -1;
+
+	return st.st_size;
+}
+
+static void copy_complete(int err, void *user_data)
+{
+	struct copy_result *result = user_data;
+
+	g_assert(!result->done);
+
+	result->done = TRUE;
+	result->err = err;
+}
+
+/* Filesystems with reflinks clone the file instead of copying it */
+static gboolean copy_cloned(int err, const char *dst, size_t size)
+{
+	if (err != 0)
+		return FALSE;
+
+	check_file(dst, size);
+	g_test_message("%s was cloned", dst);
+
+	return TRUE;
+}
+
+static int wait_copy(struct copy_result *result)
+{
+	while (!result->done)
+		g_main_context_iteration(NULL, TRUE);
+
+	return result->err;
+}
+
+static void test_copy_small(void)
+{
+	struct copy_result result = { FALSE, 0 };
+	char *src = test_path(NULL, "small");
+	char *dst = test_path(NULL, "small-copy");
+	int err;
+
+	create_file(src, SMALL_SIZE);
+
+	/* Files that fit in one chunk are done when the action returns */
+	err = file_driver->copy(src, dst, copy_complete, &result);
+	g_assert_cmpint(err, ==, 0);
+	g_assert(!result.done);
+
+	check_file(dst, SMALL_SIZE);
+	check_file(src, SMALL_SIZE);
+
+	unlink(src);
+	unlink(dst);
+	g_free(src);
+	g_free(dst);
+}
+
+static void test_copy_large(void)
+{
+	struct copy_result result = { FALSE, 0 };
+	char *src = test_path(NULL, "large");
+	char *dst = test_path(NULL, "large-copy");
+	int err;
+
+	create_file(src, LARGE_SIZE);
+
+	err = file_driver->copy(src, dst, copy_complete, &result);
+	if (copy_cloned(err, dst, LARGE_SIZE))
+		goto done;
+
+	g_assert_cmpint(err, ==, -EINPROGRESS);
+	g_assert(!result.done);
+	g_assert_cmpint(file_size(dst), <, LARGE_SIZE);
+
+	/* The action is only answered once the whole file is there */
+	g_assert_cmpint(wait_copy(&result), ==, 0);
+
+	check_file(dst, LARGE_SIZE);
+	check_file(src, LARGE_SIZE);
+
+done:
+	unlink(src);
+	unlink(dst);
+	g_free(src);
+	g_free(dst);
+}
+
+static void test_move_large(void)
+{
+	struct copy_result result = { FALSE, 0 };
+	char *src = test_path(NULL, "move");
+	char *dst = test_path("/dev/shm", "obexd-move");
+	struct stat st1, st2;
+	int err;
+
+	if (stat("/dev/shm", &st2) < 0 || stat(tmpdir, &st1) < 0 ||
+						st1.st_dev == st2.st_dev) {
+		g_test_message("/dev/shm is not a separate filesystem");
+		g_free(src);
+		g_free(dst);
+		return;
+	}
+
+	create_file(src, LARGE_SIZE);
+
+	/* rename() fails with EXDEV and the file is copied over */
+	err = file_driver->move(src, dst, copy_complete, &result);
+	g_assert_cmpint(err, ==, -EINPROGRESS);
+	g_assert_cmpint(file_size(src), ==, LARGE_SIZE);
+
+	g_assert_cmpint(wait_copy(&result), ==, 0);
+
+	check_file(dst, LARGE_SIZE);
+	g_assert_cmpint(file_size(src), ==, -1);
+
+	unlink(dst);
+	g_free(src);
+	g_free(dst);
+}
+
+static void test_copy_cancel(void)
+{
+	struct copy_result result = { FALSE, 0 };
+	char *src = test_path(NULL, "cancel");
+	char *dst = test_path(NULL, "cancel-copy");
+	int err;
+
+	create_file(src, LARGE_SIZE);
+
+	err = file_driver->copy(src, dst, copy_complete, &result);
+	if (copy_cloned(err, dst, LARGE_SIZE)) {
+		unlink(dst);
+		goto done;
+	}
+
+	g_assert_cmpint(err, ==, -EINPROGRESS);
+
+	/* Removing the destination stops the copy */
+	g_assert_cmpint(file_driver->remove(dst), ==, 0);
+	g_assert(result.done);
+	g_assert_cmpint(result.err, ==, -ECANCELED);
+
+	g_assert_cmpint(file_size(dst), ==, -1);
+	check_file(src, LARGE_SIZE);
+
+done:
+	unlink(src);
+	g_free(src);
+	g_free(dst);
+}
+
+static void test_copy_truncated(void)
+{
+	struct copy_result result = { FALSE, 0 };
+	char *src = test_path(NULL, "truncated");
+	char *dst = test_path(NULL, "truncated-copy");
+	int err;
+
+	create_file(src, LARGE_SIZE);
+
+	err = file_driver->copy(src, dst, copy_complete, &result);
+	if (copy_cloned(err, dst, LARGE_SIZE)) {
+		unlink(dst);
+		goto done;
+	}
+
+	g_assert_cmpint(err, ==, -EINPROGRESS);
+
+	/* A source shrinking under the copy fails it */
+	g_assert(truncate(src, 2 * 1024 * 1024) == 0);
+
+	g_assert_cmpint(wait_copy(&result), ==, -EIO);
+	g_assert_cmpint(file_size(dst), ==, -1);
+
+done:
+	unlink(src);
+	g_free(src);
+	g_free(dst);
+}
+
+static void test_copy_perf(void)
+{
+	const int small_count = 1000, large_count = 4;
+	const size_t small_size = 16 * 1024, large_size = 128 * 1024 * 1024;
+	char *src, *dst, name[32];
+	double elapsed;
+	int i, err;
+
+	if (!g_test_perf())
+		return;
+
+	src = test_path(NULL, "perf-small");
+	create_file(src, small_size);
+
+	g_test_timer_start();
+
+	for (i = 0; i < small_count; i++) {
+		snprintf(name, sizeof(name), "perf-small-%d", i);
+		dst = test_path(NULL, name);
+
+		err = file_driver->copy(src, dst, NULL, NULL);
+		g_assert_cmpint(err, ==, 0);
+
+		g_free(dst);
+	}
+
+	elapsed = g_test_timer_elapsed();
+	g_test_minimized_result(elapsed, "Copy: %d files of %zu KiB in "
+				"%.3f s", small_count, small_size / 1024,
+				elapsed);
+
+	for (i = 0; i < small_count; i++) {
+		snprintf(name, sizeof(name), "perf-small-%d", i);
+		dst = test_path(NULL, name);
+		unlink(dst);
+		g_free(dst);
+	}
+
+	unlink(src);
+	g_free(src);
+
+	src = test_path(NULL, "perf-large");
+	create_file(src, large_size);
+
+	g_test_timer_start();
+
+	for (i = 0; i < large_count; i++) {
+		struct copy_result result = { FALSE, 0 };
+
+		snprintf(name, sizeof(name), "perf-large-%d", i);
+		dst = test_path(NULL, name);
+
+		err = file_driver->copy(src, dst, copy_complete, &result);
+		if (err == -EINPROGRESS)
+			err = wait_copy(&result);
+
+		g_assert_cmpint(err, ==, 0);
+
+		unlink(dst);
+		g_free(dst);
+	}
+
+	elapsed = g_test_timer_elapsed();
+	g_test_minimized_result(elapsed, "Copy: %d files of %zu MiB in "
+				"%.3f s", large_count, large_size >> 20,
+				elapsed);
+
+	unlink(src);
+	g_free(src);
+}
+
+int main(int argc, char *argv[])
+{
+	int err;
+
+	g_test_init(&argc, &argv, NULL);
+
+	tmpdir = g_build_filename(g_get_tmp_dir(), "test-obexd-XXXXXX", NULL);
+	g_assert(mkdtemp(tmpdir) != NULL);
+
+	g_assert(__obex_builtin_filesystem.init() == 0);
+	g_assert(file_driver != NULL);
+
+	g_test_add_func("/obexd/filesystem/copy/small", test_copy_small);
+	g_test_add_func("/obexd/filesystem/copy/large", test_copy_large);
+	g_test_add_func("/obexd/filesystem/copy/cancel", test_copy_cancel);
+	g_test_add_func("/obexd/filesystem/copy/truncated",
+						test_copy_truncated);
+	g_test_add_func("/obexd/filesystem/move/large", test_move_large);
+	g_test_add_func("/obexd/filesystem/perf/copy", test_copy_perf);
+
+	err = g_test_run();
+
+	__obex_builtin_filesystem.exit();
+
+	rmdir(tmpdir);
+	g_free(tmpdir);
+
+	return err;
+}
@@ -153,12 +153,14 @@ static gboolean server_handler(GIOChannel *channel, GIOCondition cond,
 
 	if (cond & (G_IO_NVAL | G_IO_ERR | G_IO_HUP)) {
 		sdp_svcdb_collect_all(fd);
+		sdp_cstate_cleanup(fd);
 		return FALSE;
 	}
 
 	len = recv(fd, &hdr, sizeof(sdp_pdu_hdr_t), MSG_PEEK);
 	if (len != sizeof(sdp_pdu_hdr_t)) {
 		sdp_svcdb_collect_all(fd);
+		sdp_cstate_cleanup(fd);
 		return FALSE;
 	}
 
@@ -171,6 +173,7 @@ static gboolean server_handler(GIOChannel *channel, GIOCondition cond,
 	len = recv(fd, buf, size, 0);
 	if (len <= 0) {
 		sdp_svcdb_collect_all(fd);
+		sdp_cstate_cleanup(fd);
 		free(buf);
 		return FALSE;
 	}
@@ -793,6 +796,339 @@ static void test_sdp_de_attr(gconstpointer data)
 	sdp_data_free(d);
 }
 
+/* A sequence cut short after its header must not stall the parser */
+static void test_sdp_de_truncated_seq(void)
+{
+	const uint8_t pdu[] = { 0x35, 0x08, 0x09, 0x00, 0x04, 0x35, 0x05,
+								0x35 };
+	sdp_record_t *rec;
+	sdp_data_t *d;
+	int size = 0;
+
+	rec = sdp_extract_pdu(pdu, sizeof(pdu), &size);
+	g_assert(rec != NULL);
+
+	d = sdp_data_get(rec, SDP_ATTR_PROTO_DESC_LIST);
+	g_assert(d != NULL);
+	g_assert(d->val.dataseq == NULL);
+
+	sdp_record_free(rec);
+}
+
+/* Browse the public group with all attributes, optionally continuing */
+static ssize_t cstate_request(int sk, int peer, const uint8_t *cont,
+						uint8_t *rsp, size_t len)
+{
+	const uint8_t req[] = { 0x06, 0x00, 0x01, 0x00, 0x0f, 0x35, 0x03,
+				0x19, 0x10, 0x02, 0xff, 0xff, 0x35, 0x05,
+				0x0a, 0x00, 0x00, 0xff, 0xff };
+	size_t cont_len = cont ? cont[0] + 1 : 1;
+	uint8_t *buf;
+
+	buf = malloc(sizeof(req) + cont_len);
+	g_assert(buf != NULL);
+
+	memcpy(buf, req, sizeof(req));
+
+	if (cont)
+		memcpy(buf + sizeof(req), cont, cont_len);
+	else
+		buf[sizeof(req)] = 0x00;
+
+	buf[4] += cont_len - 1;
+
+	/* The request buffer is released by the server */
+	handle_internal_request(sk, 48, buf, sizeof(req) + cont_len);
+
+	return read(peer, rsp, len);
+}
+
+/* Continuation state trailing a Service Search Attribute Response */
+static void cstate_extract(const uint8_t *rsp, ssize_t len, uint8_t *cont)
+{
+	g_assert(len > 9);
+	g_assert_cmpuint(rsp[0], ==, 0x07);
+	g_assert_cmpuint(rsp[len - 9], ==, 8);
+
+	memcpy(cont, &rsp[len - 9], 9);
+}
+
+static void test_sdp_cstate_bounded(void)
+{
+	uint8_t rsp[64], first[9], last[9];
+	ssize_t len;
+	int err, sv[2], i;
+
+	err = socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, sv);
+	g_assert(err == 0);
+
+	set_fixed_db_timestamp(0x496f0654);
+
+	register_public_browse_group();
+	register_server_service();
+
+	register_serial_port();
+	register_object_push();
+	register_hid_keyboard();
+	register_file_transfer();
+
+	len = cstate_request(sv[0], sv[1], NULL, rsp, sizeof(rsp));
+	cstate_extract(rsp, len, first);
+
+	/* Clients that never finish their browse must not grow the cache */
+	for (i = 0; i < 5000; i++) {
+		len = cstate_request(sv[0], sv[1], NULL, rsp, sizeof(rsp));
+		cstate_extract(rsp, len, last);
+	}
+
+	/* The oldest state has been evicted, SDP_INVALID_CSTATE */
+	len = cstate_request(sv[0], sv[1], first, rsp, sizeof(rsp));
+	g_assert_cmpint(len, ==, 7);
+	g_assert_cmpuint(rsp[0], ==, 0x01);
+	g_assert_cmpuint(rsp[6], ==, 0x05);
+
+	len = cstate_request(sv[0], sv[1], last, rsp, sizeof(rsp));
+	g_assert(len > 0);
+	g_assert_cmpuint(rsp[0], ==, 0x07);
+
+	/* Nothing is left behind once the connection goes away */
+	len = cstate_request(sv[0], sv[1], NULL, rsp, sizeof(rsp));
+	cstate_extract(rsp, len, last);
+
+	sdp_cstate_cleanup(sv[0]);
+
+	len = cstate_request(sv[0], sv[1], last, rsp, sizeof(rsp));
+	g_assert_cmpint(len, ==, 7);
+	g_assert_cmpuint(rsp[0], ==, 0x01);
+
+	sdp_svcdb_collect_all(sv[0]);
+	sdp_svcdb_reset();
+
+	close(sv[0]);
+	close(sv[1]);
+}
+
+/* Send a Service Search Attribute Request over a new connection */
+static sdp_list_t *ssa_request(const uint8_t *req, size_t req_len)
+{
+	uint8_t rsp[1024], *buf, dtd;
+	sdp_list_t *recs = NULL;
+	int err, sv[2], scanned, seqlen = 0, bytesleft;
+	const uint8_t *ptr;
+	ssize_t len;
+
+	err = socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, sv);
+	g_assert(err == 0);
+
+	buf = malloc(req_len);
+	g_assert(buf != NULL);
+
+	memcpy(buf, req, req_len);
+
+	/* The request buffer is released by the server */
+	handle_internal_request(sv[0], 672, buf, req_len);
+
+	len = read(sv[1], rsp, sizeof(rsp));
+	g_assert(len > 7);
+	g_assert_cmpuint(rsp[0], ==, 0x07);
+
+	/* No continuation state, the response fits in one PDU */
+	bytesleft = bt_get_be16(&rsp[5]);
+	g_assert_cmpint(len, ==, 7 + bytesleft + 1);
+	g_assert_cmpuint(rsp[len - 1], ==, 0x00);
+
+	ptr = &rsp[7];
+	scanned = sdp_extract_seqtype(ptr, bytesleft, &dtd, &seqlen);
+	g_assert(scanned > 0);
+
+	ptr += scanned;
+	bytesleft -= scanned;
+
+	while (bytesleft > 0) {
+		sdp_record_t *rec;
+		int size = 0;
+
+		rec = sdp_extract_pdu(ptr, bytesleft, &size);
+		g_assert(rec != NULL && size > 0);
+
+		recs = sdp_list_append(recs, rec);
+		ptr += size;
+		bytesleft -= size;
+	}
+
+	close(sv[0]);
+	close(sv[1]);
+
+	return recs;
+}
+
+/* What bt_search_service_state() asks for */
+static uint32_t state_request(void)
+{
+	const uint8_t req[] = { 0x06, 0x00, 0x01, 0x00, 0x0f, 0x35, 0x03,
+				0x19, 0x10, 0x00, 0x00, 0xff, 0x35, 0x05,
+				0x0a, 0x02, 0x01, 0x02, 0x01, 0x00 };
+	sdp_list_t *recs;
+	sdp_data_t *d;
+	uint32_t state;
+
+	recs = ssa_request(req, sizeof(req));
+	g_assert(recs != NULL && recs->next == NULL);
+
+	d = sdp_data_get(recs->data, SDP_ATTR_SVCDB_STATE);
+	g_assert(d != NULL);
+	g_assert_cmpuint(d->dtd, ==, SDP_UINT32);
+
+	state = d->val.uint32;
+
+	sdp_list_free(recs, (sdp_free_func_t) sdp_record_free);
+
+	return state;
+}
+
+static void test_sdp_state_reconnect(void)
+{
+	/* The first search of a browse, L2CAP with all attributes */
+	const uint8_t browse[] = { 0x06, 0x00, 0x01, 0x00, 0x0f, 0x35, 0x03,
+					0x19, 0x01, 0x00, 0xff, 0xff, 0x35,
+					0x05, 0x0a, 0x00, 0x00, 0xff, 0xff,
+					0x00 };
+	sdp_list_t *recs, *l;
+	uint32_t state;
+
+	set_fixed_db_timestamp(0x496f0654);
+
+	register_public_browse_group();
+	register_server_service();
+	register_serial_port();
+
+	/*
+	 * The SDP server record has no protocol descriptor list, so the
+	 * browse does not return it and the state has to be fetched on its
+	 * own before it can be stored with the records.
+	 */
+	recs = ssa_request(browse, sizeof(browse));
+	g_assert(recs != NULL);
+
+	for (l = recs; l; l = l->next) {
+		sdp_record_t *rec = l->data;
+
+		g_assert_cmphex(rec->handle, !=, 0x00000000);
+	}
+
+	sdp_list_free(recs, (sdp_free_func_t) sdp_record_free);
+
+	state = state_request();
+	g_assert_cmphex(state, ==, 0x496f0654);
+
+	/* Reconnecting to an unchanged server gives the stored state back */
+	g_assert_cmphex(state_request(), ==, state);
+	g_assert_cmphex(state_request(), ==, state);
+
+	/* Any change to the records makes the client browse again */
+	set_fixed_db_timestamp(0x496f0655);
+	register_device_id(0x0002, 0x1d6b, 0x0246, 0x0500);
+
+	g_assert_cmphex(state_request(), !=, state);
+
+	sdp_svcdb_reset();
+}
+
+#define SEARCH_PERF_CLASSES	50
+
+static void register_search_record(uint16_t svclass)
+{
+	sdp_list_t *svclass_id, *apseq, *proto[2], *aproto;
+	uuid_t class_uuid, l2cap, rfcomm;
+	sdp_record_t *record = sdp_record_alloc();
+	sdp_data_t *sdp_data;
+
+	record->handle = sdp_next_handle();
+
+	sdp_record_add(BDADDR_ANY, record);
+	sdp_data = sdp_data_alloc(SDP_UINT32, &record->handle);
+	sdp_attr_add(record, SDP_ATTR_RECORD_HANDLE, sdp_data);
+
+	sdp_uuid16_create(&class_uuid, svclass);
+	svclass_id = sdp_list_append(0, &class_uuid);
+	sdp_set_service_classes(record, svclass_id);
+	sdp_list_free(svclass_id, 0);
+
+	sdp_uuid16_create(&l2cap, L2CAP_UUID);
+	proto[0] = sdp_list_append(0, &l2cap);
+	apseq = sdp_list_append(0, proto[0]);
+
+	sdp_uuid16_create(&rfcomm, RFCOMM_UUID);
+	proto[1] = sdp_list_append(0, &rfcomm);
+	apseq = sdp_list_append(apseq, proto[1]);
+
+	aproto = sdp_list_append(0, apseq);
+	sdp_set_access_protos(record, aproto);
+
+	sdp_list_free(proto[0], 0);
+	sdp_list_free(proto[1], 0);
+	sdp_list_free(apseq, 0);
+	sdp_list_free(aproto, 0);
+}
+
+static void test_sdp_search_perf(void)
+{
+	const int records = 500, count = 20000;
+	uint8_t req[] = { 0x02, 0x00, 0x01, 0x00, 0x0b, 0x35, 0x06,
+				0x19, 0x00, 0x00, 0x19, 0x01, 0x00,
+				0x00, 0xff, 0x00 };
+	uint8_t rsp[128], *buf;
+	double elapsed;
+	ssize_t len;
+	int err, sv[2], i;
+
+	if (!g_test_perf())
+		return;
+
+	err = socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, sv);
+	g_assert(err == 0);
+
+	register_public_browse_group();
+	register_server_service();
+
+	for (i = 0; i < records; i++)
+		register_search_record(0x1100 + i % SEARCH_PERF_CLASSES);
+
+	g_test_timer_start();
+
+	for (i = 0; i < count; i++) {
+		uint16_t svclass = 0x1100 + i % SEARCH_PERF_CLASSES;
+
+		req[8] = svclass >> 8;
+		req[9] = svclass & 0xff;
+
+		buf = malloc(sizeof(req));
+		g_assert(buf != NULL);
+
+		memcpy(buf, req, sizeof(req));
+
+		/* The request buffer is released by the server */
+		handle_internal_request(sv[0], 672, buf, sizeof(req));
+
+		len = read(sv[1], rsp, sizeof(rsp));
+		g_assert(len > 9);
+		g_assert_cmpuint(rsp[0], ==, 0x03);
+		g_assert_cmpuint(bt_get_be16(&rsp[7]), ==,
+					records / SEARCH_PERF_CLASSES);
+	}
+
+	elapsed = g_test_timer_elapsed();
+	g_test_minimized_result(elapsed, "Service Search: %d requests over "
+				"%d records in %.3f s", count, records,
+				elapsed);
+
+	sdp_svcdb_collect_all(sv[0]);
+	sdp_svcdb_reset();
+
+	close(sv[0]);
+	close(sv[1]);
+}
+
 int main(int argc, char *argv[])
 {
 	g_test_init(&argc, &argv, NULL);
@@ -2823,6 +3159,12 @@ int main(int argc, char *argv[])
 				build_u128(0x80, 0x00, 0x00, 0x00, 0x00, 0x00,
 						0x00, 0x00, 0x00, 0x00, 0x00,
 						0x00, 0x00, 0x00, 0x00, 0x00)));
+	g_test_add_func("/sdp/DE/ATTR/truncated-seq",
+					test_sdp_de_truncated_seq);
+
+	g_test_add_func("/sdp/cstate/bounded", test_sdp_cstate_bounded);
+	g_test_add_func("/sdp/state/reconnect", test_sdp_state_reconnect);
+	g_test_add_func("/sdp/search/perf", test_sdp_search_perf);
 
 	return g_test_run();
 }